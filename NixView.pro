@@ -45,6 +45,12 @@ SOURCES += main.cpp\
     plotter/imageplotter.cpp \
     plotter/plotwidget.cpp \
     plotter/qcustomplot.cpp \
+    plotter/sampledgraph.cpp \
+    plotter/m4reduction.cpp \
+    plotter/tiledgraph.cpp \
+    plotter/tilelayer.cpp \
+    plotter/replotscheduler.cpp \
+    plotter/segmentgraph.cpp \
     views/ColumnView.cpp \
     views/datatable.cpp \
     views/MainViewWidget.cpp \
@@ -64,7 +70,25 @@ SOURCES += main.cpp\
     db/projectindex.cpp \
     plotter/eventplotter.cpp \
     utils/tagcontainer.cpp \
-    utils/loadthread.cpp
+    utils/loadthread.cpp \
+    utils/lodpyramid.cpp \
+    utils/lodcache.cpp \
+    utils/loadscheduler.cpp \
+    utils/dataconvert.cpp \
+    utils/segmentcache.cpp \
+    utils/storagelayout.cpp \
+    utils/h5lookup.cpp \
+    utils/tickindex.cpp \
+    utils/valuestats.cpp \
+    utils/imageloader.cpp \
+    utils/imagepyramid.cpp \
+    utils/framering.cpp \
+    utils/eventcounts.cpp \
+    utils/blockcache.cpp \
+    utils/taggedslices.cpp \
+    utils/welford.cpp \
+    utils/perievent.cpp \
+    plotter/perieventplotter.cpp
 
 
 HEADERS  += MainWindow.hpp \
@@ -94,6 +118,12 @@ HEADERS  += MainWindow.hpp \
     plotter/plotter.h \
     plotter/plotwidget.h \
     plotter/qcustomplot.h \
+    plotter/sampledgraph.h \
+    plotter/m4reduction.h \
+    plotter/tiledgraph.h \
+    plotter/tilelayer.h \
+    plotter/replotscheduler.h \
+    plotter/segmentgraph.h \
     views/ColumnView.hpp \
     views/datatable.h \
     views/MainViewWidget.hpp \
@@ -113,7 +143,26 @@ HEADERS  += MainWindow.hpp \
     db/projectindex.hpp \
     plotter/eventplotter.h \
     utils/tagcontainer.h \
-    utils/loadthread.h
+    utils/loadthread.h \
+    utils/lodpyramid.h \
+    utils/lodcache.h \
+    utils/loadscheduler.h \
+    utils/loadbuffer.h \
+    utils/dataconvert.h \
+    utils/segmentcache.h \
+    utils/storagelayout.h \
+    utils/h5lookup.h \
+    utils/tickindex.h \
+    utils/valuestats.h \
+    utils/imageloader.h \
+    utils/imagepyramid.h \
+    utils/framering.h \
+    utils/eventcounts.h \
+    utils/blockcache.h \
+    utils/taggedslices.h \
+    utils/welford.h \
+    utils/perievent.h \
+    plotter/perieventplotter.h
 
 
 FORMS    += MainWindow.ui \
@@ -142,7 +191,8 @@ FORMS    += MainWindow.ui \
     dialogs/filepropertiesdialog.ui \
     searchform.ui \
     views/projectnavigator.ui \
-    plotter/eventplotter.ui
+    plotter/eventplotter.ui \
+    plotter/perieventplotter.ui
 
 #standard windows folder?
 #win32:CONFIG(release, debug|release): LIBS += /usr/local/lib/release/ -lnix
@@ -153,6 +203,9 @@ unix: LIBS += -L/usr/local/lib/ -lnix \
                 -lboost_filesystem\
                 -lboost_system
 
+unix: CONFIG += link_pkgconfig
+unix: PKGCONFIG += hdf5
+
 INCLUDEPATH += /usr/local/include
 DEPENDPATH += /usr/local/include
 
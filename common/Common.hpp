@@ -75,5 +75,22 @@ Q_DECLARE_METATYPE(nix::Dimension)
 #define RECENT_PROJECTS_LIST "recent_projects_list"
 #define RECENT_PROJECTS_COUNT "recent_projects_count"
 
+#define LOD_CACHE_GROUP "lod_cache"
+#define LOD_CACHE_SIZE "lod_cache_size"
+
+#define LOADER_GROUP "loader"
+#define LOADER_WORKER_COUNT "worker_count"
+#define LOADER_SEGMENT_CACHE_SIZE "segment_cache_size"
+#define LOADER_BLOCK_CACHE_SIZE "block_cache_size"
+#define LOADER_TAGGED_CACHE_SIZE "tagged_cache_size"
+
+#define PLOT_GROUP "plot"
+#define PLOT_COLUMN_REDUCTION "column_reduction"
+#define PLOT_FRAME_RATE "frame_rate"
+#define PLOT_STACK_CHANNELS "stack_channels"
+#define PLOT_STACK_TRACES "stack_traces"
+#define PLOT_STACK_PREFETCH "stack_prefetch"
+#define PLOT_EVENT_DENSITY "event_density"
+
 #define MAIN_TREE_VIEW "tree_view"
 #define METADATA_TREE_VIEW "metadata_tree"
@@ -1,4 +1,6 @@
 #include "nixarraytablemodel.h"
+#include "utils/blockcache.h"
+#include "utils/tickindex.h"
 
 NixArrayTableModel::NixArrayTableModel(QObject *parent)
     : QAbstractTableModel(parent), h_labels(), v_labels() {
@@ -61,7 +63,7 @@ QVariant NixArrayTableModel::get_dimension_label(int section, int role, Qt::Orie
         return QString::fromStdString(label);
     } else if (dim.dimensionType() == nix::DimensionType::Range) {
         if (role == Qt::DisplayRole)
-            return dim.asRangeDimension()[section];
+            return TickIndex::of(array, dim.index())->tick(section);
         nix::RangeDimension rd = dim.asRangeDimension();
         std::string label = (rd.label() ? *rd.label() : "" ) + (rd.unit() ? " [" + *rd.unit() +"]" : "");
         return QString::fromStdString(label);
@@ -96,7 +98,8 @@ QVariant NixArrayTableModel::data(const QModelIndex &index, int role) const {
             if (shape.size() > 2) {
                 offset[2] = page;
             }
-            array.getData(nix::DataType::Double, &d, count, offset);
+            // served from the resident block, a cell does not cost an HDF5 read.
+            BlockCache::read(array, &d, count, offset);
             return QVariant(d);
         }
     } else if (role == Qt::ToolTipRole) {
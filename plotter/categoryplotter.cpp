@@ -1,12 +1,26 @@
 #include "categoryplotter.h"
 #include "ui_categoryplotter.h"
+#include "replotscheduler.h"
+#include "utils/dataconvert.h"
+#include "utils/valuestats.h"
+#include <algorithm>
+#include <cmath>
+
+// a bar is at least this many pixels wide, narrower categories are grouped.
+static const int CATEGORY_MIN_PIXELS = 6;
+// the distance between two tick labels in pixels.
+static const int CATEGORY_LABEL_PIXELS = 16;
 
 CategoryPlotter::CategoryPlotter(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::CategoryPlotter),
-    cmap()
+    cmap(), shownGroup(0), shownFirst(0), shownLast(-1)
 {
     ui->setupUi(this);
+    QSharedPointer<QCPAxisTickerText> textTicker(new QCPAxisTickerText);
+    textTicker->setSubTickCount(0);
+    ui->plot->xAxis->setTicker(textTicker);
+    connect(ui->plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(xRangeChanged(QCPRange)));
 }
 
 CategoryPlotter::~CategoryPlotter()
@@ -57,50 +71,163 @@ void CategoryPlotter::draw_2d(const nix::DataArray &array) {
     QVector<QString> xlabels, ylabels;
     get_data_array_axis(array, xaxis, xlabels, best_dim);
     get_data_array_axis(array, yaxis, ylabels, 3-best_dim);
-    double ymin = 0.0;
-    double ymax = 0.0;
-    QCPBarsGroup *group = new QCPBarsGroup(ui->plot);
-    for (int i = 0; i < yaxis.size(); i++) {
-        QVector<double> data = get_data_line(array, i, best_dim);
-        QCPBars *bars = new QCPBars(ui->plot->xAxis, ui->plot->yAxis);
-        bars->setData(xaxis, data);
-        QColor c = cmap.next();
-        bars->setPen(c);
-        c.setAlpha(50);
-        bars->setBrush(c);
-        bars->setWidth(0.15);
-        bars->setBarsGroup(group);
-        bars->setName(ylabels[i]);
-        double mi = *std::min_element(std::begin(data), std::end(data));
-        double ma = *std::max_element(std::begin(data), std::end(data));
-        if (mi < ymin)
-            ymin = mi;
-        if (ma > ymax)
-            ymax= ma;
-    }
 
+    QVector<QVector<double>> series;
+    read_series(array, best_dim, series);
+    int count = static_cast<int>(array.dataExtent()[best_dim-1]);
+    categories.clear();
+    categories.reserve(count);
+    for (int i = 0; i < count; i++) {
+        if (i < xlabels.size()) {
+            categories.append(xlabels[i]);
+        } else {
+            categories.append(i < xaxis.size() ? QString::number(xaxis[i]) : QString::number(i));
+        }
+    }
 
-    QSharedPointer<QCPAxisTickerText> textTicker(new QCPAxisTickerText);
-    textTicker->setSubTickCount(0);
-    textTicker->addTicks(xaxis,xlabels);
-    ui->plot->xAxis->setTicker(textTicker);
+    ValueStats stats;
+    QCPBarsGroup *group = new QCPBarsGroup(ui->plot);
+    double width = std::min(0.15, 0.8 / std::max(1, series.size()));
+    for (int i = 0; i < series.size(); i++) {
+        stats.merge(nixview::util::value_stats(series[i].constData(), series[i].size()));
+        add_series(series[i], i < ylabels.size() ? ylabels[i] : QString::number(i), width, group);
+    }
+    double ymin = stats.hasValues() ? std::min(0.0, stats.min) : 0.0;
+    double ymax = stats.hasValues() ? std::max(0.0, stats.max) : 0.0;
 
     ui->plot->xAxis->grid()->setVisible(true);
     ui->plot->legend->setVisible(true);
 
-    ui->plot->xAxis->setRange(-0.5, xaxis.size());
     ui->plot->yAxis->setRange(1.5 * ymin, 1.5 * ymax);
     ui->plot->xAxis->setTickLength(0, 4);
     ui->plot->xAxis->setTickLabelRotation(60);
+    ui->plot->xAxis->setRange(-0.5, count - 0.5);
+    update_view();
 
     set_label(array.name());
-    nix::Dimension dim = array.getDimension(3-best_dim);
-    std::string unit = "";
     if (array.label())
         set_ylabel(*array.label() + (array.unit() ? (" [" + *array.unit() + "]") : ""));
 }
 
 
+void CategoryPlotter::read_series(const nix::DataArray &array, int categoryDim, QVector<QVector<double>> &series) const {
+    nix::NDSize shape = array.dataExtent();
+    size_t rows = shape[0];
+    size_t cols = shape[1];
+    std::vector<double> block(rows * cols);
+    BlockCache::read(array, block.data(), shape, nix::NDSize(2, 0));
+
+    if (categoryDim == 2) {
+        // a series per row, they are contiguous.
+        series.resize(static_cast<int>(rows));
+        for (size_t r = 0; r < rows; r++) {
+            series[r].resize(static_cast<int>(cols));
+            std::copy(block.begin() + r * cols, block.begin() + (r + 1) * cols, series[r].begin());
+        }
+        return;
+    }
+    series.resize(static_cast<int>(cols));
+    std::vector<size_t> columns(cols);
+    std::vector<double*> dst(cols);
+    for (size_t c = 0; c < cols; c++) {
+        columns[c] = c;
+        series[c].resize(static_cast<int>(rows));
+        dst[c] = series[c].data();
+    }
+    nixview::util::deinterleave(block.data(), rows, cols, columns, dst.data());
+}
+
+
+void CategoryPlotter::add_series(const QVector<double> &data, const QString &name, double width, QCPBarsGroup *group) {
+    QCPBars *series = new QCPBars(ui->plot->xAxis, ui->plot->yAxis);
+    QColor c = cmap.next();
+    series->setPen(c);
+    c.setAlpha(50);
+    series->setBrush(c);
+    series->setWidth(width);
+    if (group) {
+        series->setBarsGroup(group);
+    }
+    series->setName(name);
+    bars.append(series);
+    barWidths.append(width);
+    values.append(data);
+    // the bars hold nothing of the new series yet.
+    shownGroup = 0;
+}
+
+
+void CategoryPlotter::xRangeChanged(const QCPRange &range) {
+    Q_UNUSED(range);
+    update_view();
+}
+
+
+void CategoryPlotter::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    update_view();
+    ReplotScheduler::instance().request(ui->plot);
+}
+
+
+void CategoryPlotter::update_view() {
+    int count = categories.size();
+    if (count == 0 || bars.isEmpty()) {
+        return;
+    }
+    QCPRange range = ui->plot->xAxis->range();
+    int width = std::max(1, ui->plot->axisRect()->width());
+    int first = std::max(0, static_cast<int>(std::floor(range.lower + 0.5)));
+    int last = std::min(count - 1, static_cast<int>(std::ceil(range.upper - 0.5)));
+    if (first > last) {
+        return;
+    }
+    int visible = last - first + 1;
+    int group = 1;
+    while (group < count && static_cast<double>(visible) * CATEGORY_MIN_PIXELS / group > width) {
+        group *= 2;
+    }
+
+    // the bars reach half a view beyond both edges, so scrolling rebuilds them only now and then.
+    bool rebuild = group != shownGroup || (first < shownFirst) || (last > shownLast);
+    if (rebuild) {
+        int margin = visible / 2;
+        shownFirst = std::max(0, first - margin) / group * group;
+        shownLast = std::min(count - 1, last + margin);
+        shownGroup = group;
+        for (int s = 0; s < bars.size(); s++) {
+            const QVector<double> &data = values[s];
+            int end = std::min(shownLast + 1, data.size());
+            QVector<double> keys, means;
+            keys.reserve((end - shownFirst) / group + 1);
+            means.reserve(keys.capacity());
+            for (int c = shownFirst; c < end; c += group) {
+                int n = std::min(group, end - c);
+                double mean = n == 1 ? data[c] : nixview::util::value_stats(data.constData() + c, n).mean();
+                if (!std::isnan(mean)) {
+                    keys.append(c + (n - 1) / 2.0);
+                    means.append(mean);
+                }
+            }
+            bars[s]->setData(keys, means, true);
+            bars[s]->setWidth(barWidths[s] * group);
+        }
+    }
+
+    QSharedPointer<QCPAxisTickerText> ticker = qSharedPointerDynamicCast<QCPAxisTickerText>(ui->plot->xAxis->ticker());
+    if (ticker) {
+        // labels on multiples of the stride, so they do not jump while scrolling.
+        double groupPixels = width * group / std::max(range.size(), 1e-9);
+        int stride = group * std::max(1, static_cast<int>(std::ceil(CATEGORY_LABEL_PIXELS / groupPixels)));
+        ticker->clear();
+        for (int c = first / stride * stride; c <= last; c += stride) {
+            int end = std::min(c + group, count) - 1;
+            ticker->addTick(c + (end - c) / 2.0, end == c ? categories[c] : categories[c] + " - " + categories[end]);
+        }
+    }
+}
+
+
 bool CategoryPlotter::check_dimensions(const nix::DataArray &array) const {
     if (array.dimensionCount() == 0) {
         return false;
@@ -142,7 +269,7 @@ void CategoryPlotter::set_label(const std::string &label) {
 
 void CategoryPlotter::set_xlabel(const QString &label){
     ui->plot->xAxis->setLabel(label);
-    ui->plot->replot();
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 void CategoryPlotter::set_xlabel(const std::string &label) {
@@ -151,7 +278,7 @@ void CategoryPlotter::set_xlabel(const std::string &label) {
 
 void CategoryPlotter::set_ylabel(const QString &label){
     ui->plot->yAxis->setLabel(label);
-    ui->plot->replot();
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 void CategoryPlotter::set_ylabel(const std::string &label) {
@@ -159,20 +286,13 @@ void CategoryPlotter::set_ylabel(const std::string &label) {
 }
 
 void CategoryPlotter::add_bar_plot(QVector<QString> categories, QVector<double> y_data, const QString &name){
-    QCPBars *bars = new QCPBars(ui->plot->xAxis, ui->plot->yAxis);
-
+    this->categories = categories;
+    add_series(y_data, name, 0.75, nullptr);
+    QCPBars *bars = this->bars.last();
     QPen pen;
     pen.setColor(QColor(150, 222, 0));
     bars->setPen(pen);
     bars->setBrush(QColor(150, 222, 0, 70));
-    QVector<double> ticks;
-    for (int i = 0; i < categories.size(); ++i)
-        ticks.push_back(i);
-
-    QSharedPointer<QCPAxisTickerText> textTicker(new QCPAxisTickerText);
-    textTicker->setSubTickCount(0);
-    textTicker->addTicks(ticks,categories);
-    ui->plot->xAxis->setTicker(textTicker);
 
     ui->plot->xAxis->grid()->setVisible(true);
     ui->plot->legend->setVisible(true);
@@ -180,12 +300,11 @@ void CategoryPlotter::add_bar_plot(QVector<QString> categories, QVector<double>
     ui->plot->xAxis->setTickLabelRotation(60);
     ui->plot->xAxis->setTickLength(0, 4);
     ui->plot->xAxis->grid()->setVisible(true);
-    ui->plot->xAxis->setRange(-0.5, categories.size() - 0.5);
 
     ui->plot->yAxis->setPadding(5);
     ui->plot->yAxis->grid()->setSubGridVisible(true);
-    double y_max = *std::max_element(std::begin(y_data), std::end(y_data));
-    ui->plot->yAxis->setRange(0, 1.05 * y_max);
+    ValueStats stats = nixview::util::value_stats(y_data.constData(), y_data.size());
+    ui->plot->yAxis->setRange(0, 1.05 * (stats.hasValues() ? stats.max : 0.0));
 
     QPen gridPen;
     gridPen.setStyle(Qt::SolidLine);
@@ -194,9 +313,8 @@ void CategoryPlotter::add_bar_plot(QVector<QString> categories, QVector<double>
     gridPen.setStyle(Qt::DotLine);
     ui->plot->yAxis->grid()->setSubGridPen(gridPen);
 
-    // Add data:
-    bars->setData(ticks, y_data);
-    bars->setName(name);
+    ui->plot->xAxis->setRange(-0.5, categories.size() - 0.5);
+    update_view();
 }
 
 
@@ -44,12 +44,44 @@ public:
 
     PlotterType plotter_type() const override;
 
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+private slots:
+    void xRangeChanged(const QCPRange &range);
+
 private:
     Ui::CategoryPlotter *ui;
     ColorMap cmap;
 
+    // the categories are drawn at their index, values[s][c] is the value of series s for category c.
+    QVector<QString> categories;
+    QVector<QVector<double>> values;
+    // owned by the plot, one per series, with the width of a bar showing a single category.
+    QVector<QCPBars*> bars;
+    QVector<double> barWidths;
+    // the categories per bar and the categories the bars currently hold.
+    int shownGroup;
+    int shownFirst;
+    int shownLast;
+
     QCustomPlot* get_plot() override;
 
+    void add_series(const QVector<double> &data, const QString &name, double width, QCPBarsGroup *group);
+
+    /**
+     * @brief read_series: reads the 2D array in a single block and splits it into one series per index of the other
+     * dimension than categoryDim.
+     */
+    void read_series(const nix::DataArray &array, int categoryDim, QVector<QVector<double>> &series) const;
+
+    /**
+     * @brief update_view: puts the categories around the visible ones into the bars. Where the categories are narrower than
+     * a few pixels, a bar shows the mean of a group of them, the groups are powers of two so they stay put while scrolling.
+     * Only the labels of the visible bars are given to the ticker, thinned out to fit.
+     */
+    void update_view();
+
 };
 
 #endif // CATEGORYPLOTTER_H
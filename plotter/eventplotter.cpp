@@ -1,8 +1,15 @@
 #include "eventplotter.h"
 #include "ui_eventplotter.h"
+#include "replotscheduler.h"
+#include "segmentgraph.h"
+#include "../utils/tickindex.h"
+#include "common/Common.hpp"
+#include <QSettings>
+#include <algorithm>
+#include <limits>
 
 EventPlotter::EventPlotter(QWidget *parent, int numOfPoints) :
-  QWidget(parent), ui(new Ui::EventPlotter), thread() {
+  QWidget(parent), ui(new Ui::EventPlotter), thread(), density(0), densityMode(false), densityPixel(0) {
     ui->setupUi(this);
     // connect slot that ties some axis selections together (especially opposite axes):
     //connect(ui->plot, SIGNAL(selectionChangedByUser()), this, SLOT(selection_changed()));
@@ -17,6 +24,8 @@ EventPlotter::EventPlotter(QWidget *parent, int numOfPoints) :
     //connect(ui->plot, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(context_menu_request(QPoint)));
     ui->plot->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom | QCP::iSelectPlottables | QCP::iSelectAxes);
 
+    tiles = new TileLayer(ui->plot->xAxis, ui->plot->yAxis);
+
     ui->plot->axisRect()->setRangeZoom(ui->plot->xAxis->orientation());
     ui->plot->axisRect()->setRangeDrag(ui->plot->xAxis->orientation());
 
@@ -25,6 +34,12 @@ EventPlotter::EventPlotter(QWidget *parent, int numOfPoints) :
     ui->plot->yAxis->setRange(-0.05,1.05);
     this->numOfPoints = numOfPoints;
     thread.setChuncksize(static_cast<unsigned int>(numOfPoints));
+
+    QSettings settings;
+    settings.beginGroup(PLOT_GROUP);
+    densityThreshold = settings.value(PLOT_EVENT_DENSITY, 2.0).toDouble();
+    settings.endGroup();
+    connect(&counts, SIGNAL(ready()), this, SLOT(countsReady()));
 }
 
 
@@ -33,6 +48,20 @@ EventPlotter::~EventPlotter() {
 }
 
 
+void EventPlotter::showEvent(QShowEvent *event) {
+    thread.setPriority(LoadPriority::Visible);
+    counts.setPriority(LoadPriority::Visible);
+    QWidget::showEvent(event);
+}
+
+
+void EventPlotter::hideEvent(QHideEvent *event) {
+    thread.setPriority(LoadPriority::Background);
+    counts.setPriority(LoadPriority::Background);
+    QWidget::hideEvent(event);
+}
+
+
 PlotterType EventPlotter::plotter_type() const {
     return PlotterType::Event;
 }
@@ -51,7 +80,7 @@ void EventPlotter::set_xlabel(const std::string &label) {
 
 void EventPlotter::set_xlabel(const QString &label){
     ui->plot->xAxis->setLabel(label);
-    ui->plot->replot();
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 
@@ -62,7 +91,7 @@ void EventPlotter::set_ylabel(const std::string &label) {
 
 void EventPlotter::set_ylabel(const QString &label){
     ui->plot->yAxis->setLabel(label);
-    ui->plot->replot();
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 
@@ -81,6 +110,17 @@ QCustomPlot* EventPlotter::get_plot() {
 }
 
 
+TiledGraph* EventPlotter::add_graph() {
+    // registers itself with the plot like QCustomPlot::addGraph().
+    TiledGraph *graph = new TiledGraph(ui->plot->xAxis, ui->plot->yAxis);
+    graph->setTileLayer(tiles);
+    if(ui->plot->autoAddPlottableToLegend()) {
+        graph->addToLegend();
+    }
+    return graph;
+}
+
+
 void EventPlotter::draw(const nix::DataArray &array) {
     if(! testArray(array)) {
         return;
@@ -88,7 +128,7 @@ void EventPlotter::draw(const nix::DataArray &array) {
 
     this->array = array;
 
-    ui->plot->addGraph();
+    add_graph();
     QPen pen;
     pen.setColor(cmap.next());
     ui->plot->graph()->setPen(pen);
@@ -104,15 +144,27 @@ void EventPlotter::draw(const nix::DataArray &array) {
     }
         extent[0] = length;
 
-    nix::Dimension d = array.getDimension(1);
-
     connect(ui->plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(xRangeChanged(QCPRange)));
-    this->totalRange.expand(QCPRange(d.asRangeDimension().axis(1,0)[0], d.asRangeDimension().axis(1,array.dataExtent()[0]-1)[0]));
-    ui->plot->xAxis->setRange(QCPRange(d.asRangeDimension().axis(1,0)[0],d.asRangeDimension().axis(1,length-1)[0]));
+    TickIndexPtr ticks = TickIndex::of(array, 1);
+    this->totalRange.expand(QCPRange(ticks->first(), ticks->last()));
+    ui->plot->xAxis->setRange(QCPRange(ticks->first(), ticks->tick(length-1)));
 
-    connect(&thread, SIGNAL(dataReady(const QVector<double> &, const QVector<double> &, int)), this, SLOT(drawThreadData(const QVector<double> &, const QVector<double> &, int)));
+    connect(&thread, SIGNAL(dataReady(const LoadBufferPtr &, int, int, const ChunkStats &)),
+            this, SLOT(drawThreadData(const LoadBufferPtr &, int, int, const ChunkStats &)));
     thread.setVariables1D(array, start, extent, array.getDimension(1), 0 );
 
+    // where the events are denser than densityThreshold per pixel their rate is drawn instead, from the count pyramid.
+    density = ui->plot->addGraph(ui->plot->xAxis, ui->plot->yAxis2);
+    density->removeFromLegend();
+    density->setLineStyle(QCPGraph::lsStepLeft);
+    density->setPen(pen);
+    QColor fill = pen.color();
+    fill.setAlpha(80);
+    density->setBrush(fill);
+    density->setVisible(false);
+    ui->plot->yAxis2->setLabel("rate");
+    counts.build(array);
+
     connect(ui->plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(xRangeChanged(QCPRange)));
 }
 
@@ -157,7 +209,7 @@ void EventPlotter::draw(const QVector<double> &positions, const QString &ylabel,
 
 
 void EventPlotter::plot(const QVector<double> &positions) {
-    ui->plot->addGraph();
+    add_graph();
     QPen pen;
     pen.setColor(cmap.next());
     ui->plot->graph()->setPen(pen);
@@ -168,7 +220,7 @@ void EventPlotter::plot(const QVector<double> &positions) {
 
     ui->plot->graph()->addData(positions, yValues, true);
     ui->plot->xAxis->setRange(positions[0], positions.last());
-    ui->plot->replot();
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 void EventPlotter::draw(const QVector<double> &positions, const QVector<double> &extents, const QString &ylabel, const QVector<QString> &xlabels) {
@@ -186,48 +238,127 @@ void EventPlotter::draw(const QVector<double> &positions, const QVector<double>
 }
 
 void EventPlotter::plot(const QVector<double> &positions, const QVector<double> &extends) {
-    ui->plot->addGraph();
+    // registers itself with the plot like QCustomPlot::addGraph().
+    SegmentGraph *segments = new SegmentGraph(ui->plot->xAxis, ui->plot->yAxis);
+    if(ui->plot->autoAddPlottableToLegend()) {
+        segments->addToLegend();
+    }
     QPen pen;
     pen.setColor(cmap.next());
-    ui->plot->graph()->setPen(pen);
+    segments->setPen(pen);
+    QColor fill = pen.color();
+    fill.setAlpha(80);
+    segments->setBrush(fill);
+    segments->setData(positions, extends);
+
+    bool found;
+    QCPRange keys = segments->getKeyRange(found);
+    if(found) {
+        ui->plot->xAxis->setRange(keys);
+    }
+    ReplotScheduler::instance().request(ui->plot);
+}
 
-    QVector<double> xValues = QVector<double>(4*positions.size());
-    QVector<double> yValues = QVector<double>(4*positions.size());
 
-    for(int i = 0; i < positions.size(); i++) {
-        xValues[4*i]   = positions[i]-(1.0/80000);
-        xValues[4*i+1] = positions[i];
-        xValues[4*i+2] = positions[i] + extends[i];
-        xValues[4*i+3] = positions[i] + extends[i]+(1.0/80000);
+void EventPlotter::drawThreadData(const LoadBufferPtr &buffer, int from, int to, const ChunkStats &) {
+    if(to <= from) {
+        return;
+    }
+    // the loaded values are the event positions, event arrays are 1D.
+    const double *positions = buffer->values[0].data();
+    int graphIndex = buffer->indices[0];
 
-        yValues[4*i]   = 0;
-        yValues[4*i+1] = 1;
-        yValues[4*i+2] = 1;
-        yValues[4*i+3] = 0;
+    QVector<QCPGraphData> points(to - from);
+    for(int i=from; i<to; i++) {
+        points[i-from] = QCPGraphData(positions[i], 1);
     }
 
-    ui->plot->graph()->addData(xValues, yValues, true);
-    ui->plot->xAxis->setRange(xValues[0], xValues.last());
-    ui->plot->replot();
+    QSharedPointer<QCPGraphDataContainer> data = ui->plot->graph(graphIndex)->data();
+    data->remove(positions[from], positions[to-1]);
+    data->add(points, true);
+    tiles->invalidate(positions[from], positions[to-1]);
+    if(to == static_cast<int>(buffer->size())) {
+        data->removeBefore(positions[0]);
+        data->removeAfter(positions[to-1]);
+        tiles->invalidate(-std::numeric_limits<double>::infinity(), positions[0]);
+        tiles->invalidate(positions[to-1], std::numeric_limits<double>::infinity());
+    }
+    // the events may cover the view now.
+    update_density();
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 
-void EventPlotter::drawThreadData(const QVector<double> &positions, const QVector<double> &axis, int graphIndex) {
+void EventPlotter::countsReady() {
+    densityRange = QCPRange();
+    densityPixel = 0;
+    update_density();
+}
 
-    QVector<double> yValues(positions.size());
-    yValues.fill(1);
 
-    ui->plot->graph(graphIndex)->setData(positions, yValues, true);
-    ui->plot->replot();
+bool EventPlotter::events_cover(const QCPRange &range) const {
+    QCPGraph *graph = ui->plot->graph(0);
+    if(!graph || graph->dataCount() == 0) {
+        return false;
+    }
+    double lower = std::max(range.lower, totalRange.lower);
+    double upper = std::min(range.upper, totalRange.upper);
+    return graph->dataMainKey(0) <= lower && graph->dataMainKey(graph->dataCount() - 1) >= upper;
+}
+
+
+bool EventPlotter::update_density() {
+    if(!density || !counts.isReady()) {
+        return false;
+    }
+    QCPRange range = ui->plot->xAxis->range();
+    int pixels = std::max(1, ui->plot->axisRect()->width());
+    double pixel = range.size() / pixels;
+
+    // the rate covers a view width on either side, so scrolling finds it there. It is recomputed when the view
+    // leaves it or the zoom changes the level of the bins.
+    if(!(densityRange.lower <= range.lower && densityRange.upper >= range.upper) ||
+            pixel < densityPixel / 2 || pixel > densityPixel * 2) {
+        QVector<double> keys, rates;
+        densityRange = QCPRange(range.lower - range.size(), range.upper + range.size());
+        densityPixel = pixel;
+        counts.histogram(densityRange.lower, densityRange.upper, pixel, keys, rates);
+        density->setData(keys, rates, true);
+    }
+
+    QVector<double> keys, rates;
+    double events = counts.histogram(range.lower, range.upper, pixel, keys, rates);
+    bool dense = events / pixels > densityThreshold;
+    // zooming in, the rate stays until the events of the view are loaded.
+    bool mode = dense || (events > 0 && !events_cover(range));
+    if(mode) {
+        double top = rates.isEmpty() ? 1 : *std::max_element(rates.constBegin(), rates.constEnd());
+        ui->plot->yAxis2->setRange(0, top > 0 ? top * 1.05 : 1);
+    }
+    if(mode != densityMode) {
+        densityMode = mode;
+        density->setVisible(mode);
+        ui->plot->graph(0)->setVisible(!mode);
+        ui->plot->yAxis2->setVisible(mode);
+        ui->plot->yAxis->setTickLabels(!mode);
+    }
+    ReplotScheduler::instance().request(ui->plot);
+    return dense;
 }
 
 void EventPlotter::xRangeChanged(QCPRange newRange) {
     //assumption has exactly one graph.
     emit xAxisChanged(newRange, totalRange); // signal for scrollbar and zoom.
 
-    QCPGraph *graph = ui->plot->graph();
+    if(update_density()) {
+        // the events are not needed while their rate is shown.
+        return;
+    }
+
+    // the events are the first graph, the density the second. Segments are no graph.
+    QCPGraph *graph = ui->plot->graph(0);
 
-    if(graph->dataCount() == 0) {
+    if(!graph || graph->dataCount() == 0) {
         return;
     }
 
@@ -241,7 +372,7 @@ void EventPlotter::xRangeChanged(QCPRange newRange) {
 void EventPlotter::changeXAxisPosition(double newCenter) {
     if(ui->plot->xAxis->range().center() != newCenter) {
         ui->plot->xAxis->setRange(newCenter, ui->plot->xAxis->range().size(), Qt::AlignCenter);
-        ui->plot->replot();
+        ReplotScheduler::instance().request(ui->plot);
     }
 }
 
@@ -250,12 +381,17 @@ void EventPlotter::changeXAxisSize(double ratio) {
 
     if(xNewSize != ui->plot->xAxis->range().size()) {
         ui->plot->xAxis->setRange(ui->plot->xAxis->range().center(), xNewSize, Qt::AlignCenter);
-        ui->plot->replot();
+        ReplotScheduler::instance().request(ui->plot);
     }
 }
 
 void EventPlotter::resetView() {
-    QCPDataContainer<QCPGraphData> data = *ui->plot->graph()->data().data();
+    if(!ui->plot->graph(0)) {
+        // only segments, they are held in memory completely.
+        ui->plot->xAxis->rescale();
+        return;
+    }
+    QCPDataContainer<QCPGraphData> data = *ui->plot->graph(0)->data().data();
 
     // reset x Range
     if(numOfPoints != 0 && numOfPoints < data.size()) {
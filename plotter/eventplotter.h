@@ -4,8 +4,10 @@
 #include <QWidget>
 #include "plotter.h"
 #include "../utils/loadthread.h"
+#include "../utils/eventcounts.h"
 #include <nix.hpp>
 #include "colormap.hpp"
+#include "tiledgraph.h"
 
 namespace Ui {
     class EventPlotter;
@@ -42,6 +44,10 @@ public:
 
     QCustomPlot* get_plot() override;
 
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
 private:
     Ui::EventPlotter *ui;
     ColorMap cmap;
@@ -49,9 +55,33 @@ private:
     LoadThread thread;
     QCPRange totalRange;
     int numOfPoints;
+    // owned by the plot.
+    TileLayer *tiles;
+
+    // density mode: above densityThreshold events per pixel the event rate is drawn instead of the events.
+    EventCounts counts;
+    // owned by the plot, drawn against yAxis2.
+    QCPGraph *density;
+    double densityThreshold;
+    bool densityMode;
+    // the range the density graph covers and the pixel width it was computed for.
+    QCPRange densityRange;
+    double densityPixel;
+
+    /**
+     * @brief update_density: chooses between the events and the rate for the current view and updates the rate.
+     * @return whether the events of the view are too dense to be drawn.
+     */
+    bool update_density();
+    bool events_cover(const QCPRange &range) const;
 
     bool testArray(const nix::DataArray &array);
 
+    /**
+     * @brief add_graph: adds a TiledGraph that is drawn by the TileLayer of the plot.
+     */
+    TiledGraph* add_graph();
+
     void plot(const QVector<double> &positions);
     void plot(const QVector<double> &positions, const QVector<double> &extends);
 
@@ -60,8 +90,9 @@ signals:
 
 
 public slots:
-    void drawThreadData(const QVector<double> &data, const QVector<double> &axis, int graphIndex);
+    void drawThreadData(const LoadBufferPtr &buffer, int from, int to, const ChunkStats &stats);
     void xRangeChanged(QCPRange newRange); // send new info to thread to load if needed.
+    void countsReady();
 
     void changeXAxisPosition(double newCenter); // react to signals from plotwidget.
     void changeXAxisSize(double ratio);
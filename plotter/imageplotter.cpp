@@ -1,18 +1,186 @@
 #include "imageplotter.h"
 #include "ui_imageplotter.h"
+#include "replotscheduler.h"
 #include <QMenu>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// the minimal time between two replots while tiles arrive, and the multiple of the last replot's duration.
+static const int PROGRESS_REPLOT_MS = 250;
+static const int PROGRESS_REPLOT_FACTOR = 4;
+// the minimal time between two map updates while the view changes.
+static const int VIEW_UPDATE_MS = 50;
+// the map reaches this fraction of the visible width and height beyond each side of the view.
+static const double VIEW_MARGIN = 0.25;
+
+
+static int ceil_div(int a, int b) {
+    return a >= 0 ? (a + b - 1) / b : -(-a / b);
+}
+
+
+/**
+ * @brief ImageMapData: The cells of the colour map, written block by block as the ImageLoader delivers them.
+ * The map covers a region of the image at one pyramid level: cell (i, j) stands for the step x step cells of the
+ * image beginning at row + i * step, col + j * step. Cells that were not written yet are transparent.
+ */
+class ImageMapData : public QCPColorMapData
+{
+public:
+    ImageMapData(int keySize, int valueSize, const QCPRange &keyRange, const QCPRange &valueRange,
+                 int row, int col, int step) :
+        QCPColorMapData(keySize, valueSize, keyRange, valueRange), mRow(row), mCol(col), mStep(step) {
+        fillAlpha(0);
+        // the bounds grow with the written blocks.
+        mDataBounds = QCPRange(std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN());
+    }
+
+    int step() const {
+        return mStep;
+    }
+
+    /**
+     * @brief write: writes the part of a block inside the map. A value of a coarser block covers several cells,
+     * a finer block is sampled at the first image cell of each map cell.
+     */
+    void write(const ImageBlock &block) {
+        writeGrid(block.row, block.col, block.rows, block.cols, block.step, block.values.data(), 0);
+        if(block.stats.hasValues()) {
+            mDataBounds.expand(QCPRange(block.stats.min, block.stats.max));
+        }
+    }
+
+    /**
+     * @brief copy: takes over the written cells of a previous map, sampled like a block.
+     */
+    void copy(const ImageMapData &other) {
+        if(other.mIsEmpty) {
+            return;
+        }
+        writeGrid(other.mRow, other.mCol, other.mValueSize, other.mKeySize, other.mStep, other.mData, other.mAlpha);
+        mDataBounds.expand(other.mDataBounds);
+    }
+
+    /**
+     * @brief writeFrame: copies a frame of a stack from the ring into the cells.
+     */
+    bool writeFrame(FrameRing &ring, int frame, ValueStats &stats) {
+        if(mIsEmpty || !ring.copy(frame, mData, stats)) {
+            return false;
+        }
+        mDataModified = true;
+        return true;
+    }
+
+    /**
+     * @brief finish: called when every cell was written, drops the transparency.
+     */
+    void finish() {
+        clearAlpha();
+        mDataModified = true;
+    }
+
+private:
+    int mRow;
+    int mCol;
+    int mStep;
+
+    void writeGrid(int row, int col, int rows, int cols, int step, const double *values, const unsigned char *alpha) {
+        if(mIsEmpty) {
+            return;
+        }
+        // the cells of the map that begin inside the grid, each takes the grid value it begins in.
+        int first = std::max(0, ceil_div(row - mRow, mStep));
+        int last = std::min(mValueSize, ceil_div(row + rows * step - mRow, mStep));
+        int firstCol = std::max(0, ceil_div(col - mCol, mStep));
+        int lastCol = std::min(mKeySize, ceil_div(col + cols * step - mCol, mStep));
+        if(first >= last || firstCol >= lastCol) {
+            return;
+        }
+        int width = lastCol - firstCol;
+        std::vector<int> source(width);
+        for(int j=0; j<width; j++) {
+            source[j] = (mCol + (firstCol + j) * mStep - col) / step;
+        }
+        bool contiguous = step == mStep && !alpha;
+
+        for(int i=first; i<last; i++) {
+            int r = (mRow + i * mStep - row) / step;
+            const double *src = values + static_cast<size_t>(r) * cols;
+            size_t offset = static_cast<size_t>(i) * mKeySize + firstCol;
+            if(contiguous) {
+                // rows of the image are rows of cells, copied at once.
+                std::memcpy(mData + offset, src + source[0], width * sizeof(double));
+                if(mAlpha) {
+                    std::memset(mAlpha + offset, 255, width);
+                }
+                continue;
+            }
+            for(int j=0; j<width; j++) {
+                if(alpha && !alpha[static_cast<size_t>(r) * cols + source[j]]) {
+                    continue;
+                }
+                mData[offset + j] = src[source[j]];
+                if(mAlpha) {
+                    mAlpha[offset + j] = 255;
+                }
+            }
+        }
+        mDataModified = true;
+    }
+};
 
 
 ImagePlotter::ImagePlotter(QWidget *parent) :
-        QWidget(parent), ui(new Ui::ImagePlotter), cmap() {
+        QWidget(parent), ui(new Ui::ImagePlotter), cmap(), colorMap(0), mapData(0),
+        rows(0), cols(0), levels(1), x0(0), dx(1), y0(0), dy(1), mapLevel(-1), request(-1),
+        stackMode(false), frame(0), shownFrame(-1), stalls(0) {
     ui->setupUi(this);
 
+    progressTimer.setSingleShot(true);
+    connect(&progressTimer, SIGNAL(timeout()), this, SLOT(replotProgress()));
+    viewTimer.setSingleShot(true);
+    connect(&viewTimer, SIGNAL(timeout()), this, SLOT(updateView()));
+    connect(&loader, SIGNAL(blockReady(const ImageBlockPtr &)), this, SLOT(drawBlock(const ImageBlockPtr &)));
+    connect(&loader, SIGNAL(progress(int, double)), this, SLOT(loadProgress(int, double)));
+
+    ui->stackBar->setHidden(true);
+    playTimer.setTimerType(Qt::PreciseTimer);
+    connect(&playTimer, SIGNAL(timeout()), this, SLOT(playTick()));
+    connect(&frames, SIGNAL(frameReady(int)), this, SLOT(frameLoaded(int)));
+    connect(ui->playButton, SIGNAL(toggled(bool)), this, SLOT(playToggled(bool)));
+    connect(ui->reverseButton, SIGNAL(toggled(bool)), this, SLOT(reverseToggled(bool)));
+    connect(ui->fpsSpin, SIGNAL(valueChanged(int)), this, SLOT(fpsChanged(int)));
+    connect(ui->frameSlider, SIGNAL(valueChanged(int)), this, SLOT(frameChanged(int)));
 }
 
 ImagePlotter::~ImagePlotter() {
     delete ui;
 }
 
+
+void ImagePlotter::showEvent(QShowEvent *event) {
+    loader.setPriority(LoadPriority::Visible);
+    frames.setPriority(LoadPriority::Visible);
+    QWidget::showEvent(event);
+}
+
+
+void ImagePlotter::hideEvent(QHideEvent *event) {
+    loader.setPriority(LoadPriority::Background);
+    frames.setPriority(LoadPriority::Background);
+    ui->playButton->setChecked(false);
+    QWidget::hideEvent(event);
+}
+
+
+void ImagePlotter::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    viewChanged();
+}
+
 QCustomPlot *ImagePlotter::get_plot() {
     return ui->plot;
 }
@@ -59,13 +227,15 @@ static DimInfo get_dim_info(const nix::DataArray &array, nix::ndsize_t dim_index
 }
 
 void ImagePlotter::draw(const nix::DataArray &array) {
-    if (array.dimensionCount() != 2) {
-        std::cerr << "ImagePlotter::draw can only draw 2D!" << std::endl;
+    if (array.dimensionCount() != 2 && array.dimensionCount() != 3) {
+        std::cerr << "ImagePlotter::draw can only draw 2D and 3D!" << std::endl;
         return;
     }
 
-    DimInfo yi = get_dim_info(array, 1); // rows == y
-    DimInfo xi = get_dim_info(array, 2); // cols == x
+    // a 3D array is a stack of frames along its first dimension.
+    stackMode = array.dimensionCount() == 3;
+    DimInfo yi = get_dim_info(array, stackMode ? 2 : 1); // rows == y
+    DimInfo xi = get_dim_info(array, stackMode ? 3 : 2); // cols == x
 
     if (!(yi.valid && xi.valid)) {
         std::cerr << "ImagePlotter::invalid dimensions found in array!" << std::endl;
@@ -79,29 +249,23 @@ void ImagePlotter::draw(const nix::DataArray &array) {
     plot->xAxis->setLabel(xi.label + " " + xi.unit);
     plot->yAxis->setLabel(yi.label + " " + yi.unit);
 
-    QCPColorMap *colorMap = new QCPColorMap(plot->xAxis, plot->yAxis);
-
-    int nx = xi.ticks.size();
-    int ny = yi.ticks.size();
-
-    colorMap->data()->setSize(nx, ny);
-    colorMap->data()->setRange(xi.range, yi.range);
+    colorMap = new QCPColorMap(plot->xAxis, plot->yAxis);
     colorMap->setInterpolate(false);
 
-    for (int xidx = 0; xidx < nx; xidx++) {
-        std::vector<double> data(static_cast<size_t>(nx));
-        //lets fetch a whole row (should be fast if data is
-        //  row-major, like hdf5)
-        //ny,   the number of rows in data-array
-        //xidx, the current column the fetch
-        // -> fetch all rows at column [xidx]
-        //                   count    offset
-        array.getData(data, {ny, 1}, {0, xidx});
-        for (int yidx = 0; yidx < ny; yidx++) {
-            // data[ydix], the data point of the row[yidx], col[xidx]
-            colorMap->data()->setCell(xidx, yidx, data[yidx]);
-        }
-    }
+    // the ticks are taken as evenly spaced, the map is placed by the position of its first and last cell.
+    this->array = array;
+    cols = xi.ticks.size();
+    rows = yi.ticks.size();
+    levels = stackMode ? 1 : ImagePyramid::levelCount(rows, cols);
+    x0 = xi.range.lower;
+    dx = cols > 1 ? xi.range.size() / (cols - 1) : 1;
+    y0 = yi.range.lower;
+    dy = rows > 1 ? yi.range.size() / (rows - 1) : 1;
+    mapData = 0;
+    mapLevel = -1;
+    mapRegion = QRect();
+    preview.clear();
+    values = ValueStats();
 
     QCPColorScale *colorScale = new QCPColorScale(plot);
     plot->plotLayout()->addElement(0, 1, colorScale);
@@ -111,13 +275,247 @@ void ImagePlotter::draw(const nix::DataArray &array) {
         colorScale->axis()->setLabel(array.label().get().c_str());
     }
     colorMap->setGradient(QCPColorGradient::gpSpectrum);
-    colorMap->rescaleDataRange();
 
     QCPMarginGroup *marginGroup = new QCPMarginGroup(plot);
     plot->axisRect()->setMarginGroup(QCP::msBottom|QCP::msTop, marginGroup);
     colorScale->setMarginGroup(QCP::msBottom|QCP::msTop, marginGroup);
 
-    plot->rescaleAxes();
+    plot->xAxis->setRange(x0 - dx / 2, x0 + (cols - 0.5) * dx);
+    plot->yAxis->setRange(y0 - dy / 2, y0 + (rows - 0.5) * dy);
+    if (stackMode) {
+        draw_stack(xi.range, yi.range);
+        return;
+    }
+    connect(plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(viewChanged()));
+    connect(plot->yAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(viewChanged()));
+    updateView();
+}
+
+
+void ImagePlotter::draw_stack(const QCPRange &keyRange, const QCPRange &valueRange) {
+    // a frame is small enough to be held at full resolution, the map and its image are reused for every frame.
+    mapData = new ImageMapData(cols, rows, keyRange, valueRange, 0, 0, 1);
+    mapData->finish();
+    colorMap->setData(mapData, false);
+
+    frames.setArray(array);
+    frame = 0;
+    shownFrame = -1;
+    stalls = 0;
+    ui->frameSlider->setRange(0, std::max(0, frames.frameCount() - 1));
+    ui->frameSlider->setValue(0);
+    ui->stackBar->setHidden(false);
+    show_frame(0);
+    frames.setPosition(0, direction());
+}
+
+
+int ImagePlotter::direction() const {
+    return ui->reverseButton->isChecked() ? -1 : 1;
+}
+
+
+bool ImagePlotter::show_frame(int frame) {
+    ValueStats stats;
+    if(!mapData || !mapData->writeFrame(frames, frame, stats)) {
+        return false;
+    }
+    shownFrame = frame;
+    // the colour range only grows, so it stays steady during playback.
+    if(stats.hasValues()) {
+        values.merge(stats);
+        colorMap->setDataRange(QCPRange(values.min, values.max == values.min ? values.min + 1 : values.max));
+    }
+    ui->frameLabel->setText(QString::number(frame + 1) + " / " + QString::number(frames.frameCount()));
+    ReplotScheduler::instance().request(ui->plot);
+    return true;
+}
+
+
+void ImagePlotter::playTick() {
+    int next = frame + direction();
+    if(next < 0 || next >= frames.frameCount()) {
+        ui->playButton->setChecked(false);
+        return;
+    }
+    frames.setPosition(next, direction());
+    if(!show_frame(next)) {
+        // the frame is not there yet, it is shown with the next tick.
+        stalls++;
+        return;
+    }
+    frame = next;
+    ui->frameSlider->blockSignals(true);
+    ui->frameSlider->setValue(frame);
+    ui->frameSlider->blockSignals(false);
+}
+
+
+void ImagePlotter::playToggled(bool play) {
+    if(!play) {
+        playTimer.stop();
+        ui->playButton->setText("Play");
+        if(stalls > 0) {
+            // shown until the next frame replaces the label.
+            ui->frameLabel->setText(ui->frameLabel->text() + " (waited " + QString::number(stalls) + "x for frames)");
+        }
+        return;
+    }
+    int last = direction() > 0 ? frames.frameCount() - 1 : 0;
+    if(frame == last) {
+        // playing from the end starts over.
+        frame = frames.frameCount() - 1 - last;
+        frameChanged(frame);
+    }
+    stalls = 0;
+    ui->playButton->setText("Pause");
+    frames.setPosition(frame, direction());
+    playTimer.start(1000 / ui->fpsSpin->value());
+}
+
+
+void ImagePlotter::reverseToggled(bool) {
+    frames.setPosition(frame, direction());
+}
+
+
+void ImagePlotter::fpsChanged(int fps) {
+    playTimer.setInterval(1000 / fps);
+}
+
+
+void ImagePlotter::frameChanged(int frame) {
+    this->frame = frame;
+    frames.setPosition(frame, direction());
+    ui->frameSlider->blockSignals(true);
+    ui->frameSlider->setValue(frame);
+    ui->frameSlider->blockSignals(false);
+    // shown by frameLoaded() if it is not in the ring.
+    show_frame(frame);
+}
+
+
+void ImagePlotter::frameLoaded(int frame) {
+    if(frame == this->frame && shownFrame != frame) {
+        show_frame(frame);
+    }
+}
+
+
+void ImagePlotter::viewChanged() {
+    if(colorMap && !stackMode && !viewTimer.isActive()) {
+        viewTimer.start(VIEW_UPDATE_MS);
+    }
+}
+
+
+void ImagePlotter::updateView() {
+    if(!colorMap || rows == 0 || cols == 0) {
+        return;
+    }
+    QCustomPlot *plot = get_plot();
+    QRect rect = plot->axisRect()->rect();
+    QCPRange xRange = plot->xAxis->range();
+    QCPRange yRange = plot->yAxis->range();
+
+    // the coarsest level with at least one cell per pixel.
+    double cells = std::max(xRange.size() / std::fabs(dx) / std::max(1, rect.width()),
+                            yRange.size() / std::fabs(dy) / std::max(1, rect.height()));
+    int level = 0;
+    while(level + 1 < levels && (1 << level) < cells) {
+        level++;
+    }
+
+    // the visible cells of the image as fractional indices, and the map region around them in cells of the level.
+    double left = (xRange.lower - x0) / dx + 0.5, right = (xRange.upper - x0) / dx + 0.5;
+    double bottom = (yRange.lower - y0) / dy + 0.5, top = (yRange.upper - y0) / dy + 0.5;
+    if(left > right) {
+        std::swap(left, right);
+    }
+    if(bottom > top) {
+        std::swap(bottom, top);
+    }
+    int step = 1 << level;
+    QRect bounds(0, 0, static_cast<int>(ImagePyramid::levelSize(cols, level)),
+                 static_cast<int>(ImagePyramid::levelSize(rows, level)));
+    auto region = [&](double margin) -> QRect {
+        double width = (right - left) * margin, height = (top - bottom) * margin;
+        double l = std::max(0.0, std::floor((left - width) / step));
+        double b = std::max(0.0, std::floor((bottom - height) / step));
+        double r = std::min(static_cast<double>(bounds.width()), std::ceil((right + width) / step));
+        double t = std::min(static_cast<double>(bounds.height()), std::ceil((top + height) / step));
+        return r > l && t > b ? QRect(static_cast<int>(l), static_cast<int>(b), static_cast<int>(r - l), static_cast<int>(t - b)) : QRect();
+    };
+    QRect visible = region(0);
+    if(visible.isEmpty() || (level == mapLevel && mapRegion.contains(visible))) {
+        return;
+    }
+    QRect next = region(VIEW_MARGIN);
+
+    // the key and value of a cell of the level are those of its centre.
+    QCPRange keyRange(x0 + dx * (next.x() * step + (step - 1) / 2.0),
+                      x0 + dx * ((next.x() + next.width() - 1) * step + (step - 1) / 2.0));
+    QCPRange valueRange(y0 + dy * (next.y() * step + (step - 1) / 2.0),
+                        y0 + dy * ((next.y() + next.height() - 1) * step + (step - 1) / 2.0));
+    ImageMapData *data = new ImageMapData(next.width(), next.height(), keyRange, valueRange,
+                                          next.y() * step, next.x() * step, step);
+    // the preview and the previous map cover the new one until its tiles arrive.
+    for(const ImageBlockPtr &block : preview) {
+        data->write(*block);
+    }
+    if(mapData) {
+        data->copy(*mapData);
+    }
+    // deletes the previous map.
+    colorMap->setData(data, false);
+    mapData = data;
+    mapLevel = level;
+    mapRegion = next;
+    progressTimer.stop();
+
+    request = loader.load(array, level, next);
+    ReplotScheduler::instance().request(plot);
+}
+
+
+void ImagePlotter::drawBlock(const ImageBlockPtr &block) {
+    if(!mapData) {
+        return;
+    }
+    if(block->preview) {
+        preview.insert(block->row, block);
+    } else if(block->step != mapData->step()) {
+        // a tile of a previous map that is coarser than the current one.
+        return;
+    }
+    mapData->write(*block);
+
+    // the data range follows the loaded values without scanning the map.
+    if(block->stats.hasValues()) {
+        values.merge(block->stats);
+        colorMap->setDataRange(QCPRange(values.min, values.max == values.min ? values.min + 1 : values.max));
+    }
+    if(block->preview) {
+        // the preview is shown as soon as it is there.
+        ReplotScheduler::instance().request(ui->plot);
+    } else if(!progressTimer.isActive()) {
+        int last = static_cast<int>(ReplotScheduler::instance().stats(ui->plot).lastMs);
+        progressTimer.start(std::max(PROGRESS_REPLOT_MS, PROGRESS_REPLOT_FACTOR * last));
+    }
+}
+
+
+void ImagePlotter::loadProgress(int request, double percent) {
+    if(percent >= 1 && mapData && request == this->request) {
+        progressTimer.stop();
+        mapData->finish();
+        ReplotScheduler::instance().request(ui->plot);
+    }
+}
+
+
+void ImagePlotter::replotProgress() {
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 
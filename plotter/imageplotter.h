@@ -2,14 +2,19 @@
 #define IMAGEPLOTTER_H
 
 #include <QWidget>
+#include <QTimer>
 #include "plotter/categoryplotter.h"
 #include <nix.hpp>
 #include "colormap.hpp"
+#include "utils/imageloader.h"
+#include "utils/framering.h"
 
 namespace Ui {
     class ImagePlotter;
 }
 
+class ImageMapData;
+
 class ImagePlotter : public QWidget, public Plotter {
 Q_OBJECT
 public:
@@ -29,11 +34,69 @@ public:
     explicit ImagePlotter(QWidget *parent = 0);
     ~ImagePlotter();
 
+    /**
+     * @brief draw: shows the array as a colour map. The data is loaded in the background, a coarse preview first.
+     * The map only holds the visible part of the image, at the pyramid level with about one cell per pixel,
+     * the tiles of that level are written into the map as they arrive.
+     * A 3D array is shown as a stack of frames along its first dimension, with a slider and playback.
+     */
     void draw(const nix::DataArray &array);
 
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private slots:
+    void drawBlock(const ImageBlockPtr &block);
+    void loadProgress(int request, double percent);
+    void replotProgress();
+    void viewChanged();
+    void updateView();
+    void playTick();
+    void playToggled(bool play);
+    void reverseToggled(bool);
+    void fpsChanged(int fps);
+    void frameChanged(int frame);
+    void frameLoaded(int frame);
+
 private:
     Ui::ImagePlotter *ui;
     ColorMap cmap;
+    ImageLoader loader;
+    nix::DataArray array;
+    // owned by the plot.
+    QCPColorMap *colorMap;
+    // owned by the colorMap.
+    ImageMapData *mapData;
+    ValueStats values;
+    // limits the replots while tiles arrive, each recolours the whole map.
+    QTimer progressTimer;
+    // limits the map updates while the view is dragged.
+    QTimer viewTimer;
+
+    // the size of the image and the axis position of cell 0 and of the cell spacing.
+    int rows, cols, levels;
+    double x0, dx, y0, dy;
+    // the current map: its pyramid level, the region in cells of that level and the load that fills it.
+    int mapLevel;
+    QRect mapRegion;
+    int request;
+    // written into every new map before its tiles arrive, by first row.
+    QMap<int, ImageBlockPtr> preview;
+
+    // stack mode: the frames around the current one are prefetched in the playback direction.
+    bool stackMode;
+    FrameRing frames;
+    QTimer playTimer;
+    int frame;
+    int shownFrame;
+    // the ticks that found their frame not loaded yet.
+    int stalls;
+
+    void draw_stack(const QCPRange &keyRange, const QCPRange &valueRange);
+    bool show_frame(int frame);
+    int direction() const;
 
     QCustomPlot* get_plot() override;
 };
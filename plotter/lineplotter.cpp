@@ -1,6 +1,22 @@
 #include "lineplotter.h"
 #include "ui_lineplotter.h"
+#include "sampledgraph.h"
+#include "tiledgraph.h"
+#include "replotscheduler.h"
+#include "utils/dataconvert.h"
+#include "utils/tickindex.h"
+#include "common/Common.hpp"
 #include <QMenu>
+#include <QSettings>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+// the height of a typical stacked trace in rows, the traces overlap a little beyond it.
+static const double STACK_TRACE_HEIGHT = 0.8;
+// at most this many channel labels on the y-axis of stacked traces.
+static const int STACK_MAX_LABELS = 16;
+static const int STACK_COLORS = 8;
 
 LinePlotter::LinePlotter(QWidget *parent, int numOfPoints) :
     QWidget(parent), ui(new Ui::LinePlotter), cmap(), totalXRange(0,0), totalYRange(0,0) {
@@ -17,6 +33,8 @@ LinePlotter::LinePlotter(QWidget *parent, int numOfPoints) :
     ui->plot->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(ui->plot, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(context_menu_request(QPoint)));
     ui->plot->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom | QCP::iSelectPlottables | QCP::iSelectAxes);
+    // created before the traces, so the overlays are drawn above them.
+    tiles = new TileLayer(ui->plot->xAxis, ui->plot->yAxis);
 
     connect(ui->plot->xAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(xAxisNewRange(QCPRange)));
     connect(ui->plot->yAxis, SIGNAL(rangeChanged(QCPRange)), this, SLOT(yAxisNewRange(QCPRange)));
@@ -39,6 +57,22 @@ LinePlotter::~LinePlotter()
 }
 
 
+void LinePlotter::showEvent(QShowEvent *event) {
+    for(LoadThread *loader : loaders) {
+        loader->setPriority(LoadPriority::Visible);
+    }
+    QWidget::showEvent(event);
+}
+
+
+void LinePlotter::hideEvent(QHideEvent *event) {
+    for(LoadThread *loader : loaders) {
+        loader->setPriority(LoadPriority::Background);
+    }
+    QWidget::hideEvent(event);
+}
+
+
 PlotterType LinePlotter::plotter_type() const {
     return PlotterType::Line;
 }
@@ -56,7 +90,7 @@ void LinePlotter::set_xlabel(const std::string &label) {
 
 void LinePlotter::set_xlabel(const QString &label){
     ui->plot->xAxis->setLabel(label);
-    ui->plot->replot();
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 
@@ -67,7 +101,7 @@ void LinePlotter::set_ylabel(const std::string &label) {
 
 void LinePlotter::set_ylabel(const QString &label){
     ui->plot->yAxis->setLabel(label);
-    ui->plot->replot();
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 
@@ -81,12 +115,25 @@ void LinePlotter::draw(const nix::DataArray &array) {
         return;
     }
 
+    if (stack) {
+        std::cerr << "LinePlotter::draw cannot add an array to stacked traces" << std::endl;
+        return;
+    }
+    bool stacked = stackable(array);
+
     arrays.append(array);
     loaders.append(new LoadThread());
 
     LoadThread *loader = loaders.last();
 
-    connect(loader, SIGNAL(dataReady(const QVector<double> &, const QVector<double> &, int)), this, SLOT(drawThreadData(const QVector<double> &, const QVector<double> &, int)));
+    if (stacked) {
+        connect(loader, SIGNAL(dataReady(const LoadBufferPtr &, int, int, const ChunkStats &)),
+                this, SLOT(drawStackedData(const LoadBufferPtr &, int, int, const ChunkStats &)));
+        draw_stacked(array);
+        return;
+    }
+    connect(loader, SIGNAL(dataReady(const LoadBufferPtr &, int, int, const ChunkStats &)),
+            this, SLOT(drawThreadData(const LoadBufferPtr &, int, int, const ChunkStats &)));
     //connect(loader, SIGNAL(progress(double)), this, SLOT(printProgress(double)));
 
     if (array.dataExtent().size() == 1) {
@@ -117,12 +164,11 @@ void LinePlotter::draw_1d(const nix::DataArray &array) {
         //   ?? this->add_line_plot(x_axis, y_axis, QString::fromStdString(array.name()));
 
     } else {
-        int newGraphIndex = ui->plot->graphCount();
+        int newGraphIndex = ui->plot->plottableCount();
 
         expandXRange(array, 1);
 
-        ui->plot->addGraph();
-        ui->plot->graph()->setPen(QPen(cmap.next()));
+        add_trace(array, d, QPen(cmap.next()));
         nix::NDSize start(1);
         start[0] = 0;
 
@@ -159,16 +205,16 @@ void LinePlotter::draw_2d(const nix::DataArray &array) {
     */
 
     int best_dim = guess_best_xdim(array);
-    int firstGraphIndex = ui->plot->graphCount();
+    int firstGraphIndex = ui->plot->plottableCount();
 
     expandXRange(array, best_dim);
 
+    nix::Dimension d = array.getDimension(best_dim);
     for(unsigned int i=0; i<array.dataExtent()[2-best_dim]; i++) {
         QPen pen;
         pen.setColor(cmap.next());
 
-        ui->plot->addGraph();
-        ui->plot->graph()->setPen(pen);
+        add_trace(array, d, pen);
     }
 
     nix::NDSize start(2);
@@ -187,6 +233,167 @@ void LinePlotter::draw_2d(const nix::DataArray &array) {
 }
 
 
+bool LinePlotter::stackable(const nix::DataArray &array) const {
+    if(array.dataExtent().size() != 2 || ui->plot->plottableCount() > 0) {
+        return false;
+    }
+    int xDim = guess_best_xdim(array);
+    if(array.getDimension(xDim).dimensionType() != nix::DimensionType::Sample ||
+            array.getDimension(3-xDim).dimensionType() != nix::DimensionType::Set) {
+        return false;
+    }
+    QSettings settings;
+    settings.beginGroup(PLOT_GROUP);
+    int threshold = settings.value(PLOT_STACK_CHANNELS, 16).toInt();
+    settings.endGroup();
+    return threshold > 0 && array.dataExtent()[2-xDim] > static_cast<nix::ndsize_t>(threshold);
+}
+
+
+void LinePlotter::draw_stacked(const nix::DataArray &array) {
+    int xDim = guess_best_xdim(array);
+    int setDim = 3 - xDim;
+
+    QString y_label;
+    QVector<QString> ax_labels;
+    data_array_ax_labels(array, y_label, ax_labels);
+    this->set_xlabel(ax_labels[xDim-1]);
+    this->set_ylabel(ax_labels[setDim-1]);
+    this->set_label(array.name());
+
+    QSettings settings;
+    settings.beginGroup(PLOT_GROUP);
+    int maxTraces = std::max(1, settings.value(PLOT_STACK_TRACES, 32).toInt());
+    bool reduceColumns = settings.value(PLOT_COLUMN_REDUCTION, true).toBool();
+    settings.endGroup();
+
+    // set up before it becomes the plot's stack, so setting the initial ranges loads nothing yet.
+    TraceStack *traces = new TraceStack;
+    traces->array = arrays.size() - 1;
+    traces->xDim = xDim;
+    traces->channels = static_cast<int>(array.dataExtent()[setDim-1]);
+    traces->slotCount = std::min(traces->channels, maxTraces);
+    traces->scale = 0;
+    // nothing is loaded yet.
+    traces->level = -2;
+
+    std::vector<std::string> setLabels = array.getDimension(setDim).asSetDimension().labels();
+    traces->labels.reserve(traces->channels);
+    for(int i=0; i<traces->channels; i++) {
+        traces->labels.append(static_cast<size_t>(i) < setLabels.size() ? QString::fromStdString(setLabels[i]) : QString::number(i));
+    }
+    for(int i=0; i<STACK_COLORS; i++) {
+        traces->colors.append(cmap.next());
+    }
+
+    for(int i=0; i<traces->slotCount; i++) {
+        // registers itself with the plot. The offset values are only displayed, a float resolves them far below a pixel.
+        SampledGraph *graph = new SampledGraph(ui->plot->xAxis, ui->plot->yAxis);
+        graph->setSinglePrecision(true);
+        graph->setColumnReduction(reduceColumns);
+        graph->setTileLayer(tiles);
+        graph->setVisible(false);
+        traces->freeSlots.append(graph);
+    }
+
+    QSharedPointer<QCPAxisTickerText> ticker(new QCPAxisTickerText);
+    ticker->setSubTickCount(0);
+    ui->plot->yAxis->setTicker(ticker);
+    ui->plot->yAxis->setRangeReversed(true);
+    totalYRange = QCPRange(-0.5, traces->channels - 0.5);
+
+    expandXRange(array, xDim);
+    ui->plot->yAxis->setRange(-0.5, traces->slotCount - 0.5);
+    stack.reset(traces);
+    update_stack();
+}
+
+
+void LinePlotter::update_stack() {
+    TraceStack &s = *stack;
+    const nix::DataArray &array = arrays[s.array];
+    LoadThread *loader = loaders[s.array];
+
+    // the channels whose rows [i-0.5, i+0.5] reach into the view, at most one per slot.
+    QCPRange yRange = ui->plot->yAxis->range();
+    int first = std::max(0, static_cast<int>(std::floor(yRange.lower + 0.5)));
+    int last = std::min(s.channels - 1, static_cast<int>(std::ceil(yRange.upper - 0.5)));
+    last = std::min(last, first + s.slotCount - 1);
+
+    // channels that left the band give their slot back and drop their data.
+    for(QHash<int, SampledGraph*>::iterator it = s.assigned.begin(); it != s.assigned.end();) {
+        if(it.key() < first || it.key() > last) {
+            it.value()->clearData();
+            it.value()->setVisible(false);
+            s.freeSlots.append(it.value());
+            s.complete.remove(it.key());
+            s.requested.remove(it.key());
+            it = s.assigned.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for(int c=first; c<=last; c++) {
+        if(! s.assigned.contains(c) && ! s.freeSlots.isEmpty()) {
+            SampledGraph *graph = s.freeSlots.takeLast();
+            graph->setName(s.labels[c]);
+            graph->setPen(QPen(s.colors[c % s.colors.size()]));
+            graph->setVisible(true);
+            s.assigned.insert(c, graph);
+        }
+    }
+
+    QSharedPointer<QCPAxisTickerText> ticker = qSharedPointerDynamicCast<QCPAxisTickerText>(ui->plot->yAxis->ticker());
+    if(ticker) {
+        // labels on multiples of the stride, so they do not jump while scrolling.
+        int stride = std::max(1, (last - first + STACK_MAX_LABELS) / STACK_MAX_LABELS);
+        ticker->clear();
+        for(int c=(first + stride - 1) / stride * stride; c<=last; c+=stride) {
+            ticker->addTick(c, s.labels[c]);
+        }
+    }
+    if(first > last) {
+        return;
+    }
+
+    // like LoadThread::startLoadingIfNeeded(): a new window when the level changes or the view comes close to the edge of the loaded one.
+    QCPRange xRange = ui->plot->xAxis->range();
+    loader->setPixelWidth(ui->plot->axisRect()->width());
+    int level = loader->lodLevelFor(array, xRange, s.xDim);
+    bool reload = level != s.level;
+    if(! reload) {
+        double margin = xRange.size() / 4;
+        reload = (xRange.lower - margin < s.window.lower && s.window.lower > totalXRange.lower) ||
+                (xRange.upper + margin > s.window.upper && s.window.upper < totalXRange.upper);
+    }
+    if(reload) {
+        loader->calcStartExtent(array, s.start, s.extent, xRange, s.xDim, level);
+        nix::SampledDimension sd = array.getDimension(s.xDim).asSampledDimension();
+        nix::ndsize_t begin = s.start[s.xDim-1];
+        s.window = QCPRange(sd.axis(1, begin)[0], sd.axis(1, begin + s.extent[s.xDim-1] - 1)[0]);
+        s.level = level;
+        s.complete.clear();
+        s.requested.clear();
+    }
+
+    QSet<int> wanted;
+    for(QHash<int, SampledGraph*>::const_iterator it = s.assigned.constBegin(); it != s.assigned.constEnd(); ++it) {
+        if(! s.complete.contains(it.key())) {
+            wanted.insert(it.key());
+        }
+    }
+    // the running request delivers these already.
+    if(wanted.isEmpty() || s.requested.contains(wanted)) {
+        return;
+    }
+    s.requested = wanted;
+    std::vector<int> channels(wanted.begin(), wanted.end());
+    std::sort(channels.begin(), channels.end());
+    // the channel is the index the data is delivered with.
+    loader->setVariables(array, s.start, s.extent, array.getDimension(s.xDim), channels, s.xDim, 0, s.level);
+}
+
+
 int LinePlotter::guess_best_xdim(const nix::DataArray &array) const {
 
     if(array.dataExtent().size() == 0) {
@@ -253,6 +460,53 @@ bool LinePlotter::check_dimensions(const nix::DataArray &array) const {
 }
 
 
+void LinePlotter::add_trace(const nix::DataArray &array, const nix::Dimension &xDim, const QPen &pen) {
+    if(xDim.dimensionType() == nix::DimensionType::Sample) {
+        // registers itself with the plot.
+        SampledGraph *graph = new SampledGraph(ui->plot->xAxis, ui->plot->yAxis);
+        graph->setSinglePrecision(nixview::util::exact_in_float(array));
+        QSettings settings;
+        settings.beginGroup(PLOT_GROUP);
+        graph->setColumnReduction(settings.value(PLOT_COLUMN_REDUCTION, true).toBool());
+        settings.endGroup();
+        graph->setPen(pen);
+        graph->setTileLayer(tiles);
+        if(ui->plot->autoAddPlottableToLegend()) {
+            graph->addToLegend();
+        }
+    } else {
+        TiledGraph *graph = new TiledGraph(ui->plot->xAxis, ui->plot->yAxis);
+        graph->setPen(pen);
+        graph->setTileLayer(tiles);
+        if(ui->plot->autoAddPlottableToLegend()) {
+            graph->addToLegend();
+        }
+    }
+}
+
+
+int LinePlotter::data_count(QCPAbstractPlottable *plottable) const {
+    if(SampledGraph *sampled = qobject_cast<SampledGraph*>(plottable)) {
+        return static_cast<int>(sampled->dataCount());
+    }
+    if(QCPGraph *graph = qobject_cast<QCPGraph*>(plottable)) {
+        return graph->dataCount();
+    }
+    return 0;
+}
+
+
+double LinePlotter::data_key(QCPAbstractPlottable *plottable, int index) const {
+    if(SampledGraph *sampled = qobject_cast<SampledGraph*>(plottable)) {
+        return sampled->key(index);
+    }
+    if(QCPGraph *graph = qobject_cast<QCPGraph*>(plottable)) {
+        return graph->dataMainKey(index);
+    }
+    return 0;
+}
+
+
 void LinePlotter::add_line_plot(const QVector<double> &xData, const QVector<double> &yData, const QString &name) {
     ui->plot->addGraph();
     QPen pen;
@@ -264,7 +518,7 @@ void LinePlotter::add_line_plot(const QVector<double> &xData, const QVector<doub
     setYRange(yData);
 
     ui->plot->graph()->setName(name);
-    ui->plot->replot();
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 
@@ -332,8 +586,9 @@ void LinePlotter::expandXRange(const nix::DataArray &array, int xDim) {
         totalXRange.expand(QCPRange(d.asSampledDimension().axis(1,0)[0], d.asSampledDimension().axis(1,dimMax-1)[0]));
         ui->plot->xAxis->setRange(d.asSampledDimension().axis(1,0)[0], d.asSampledDimension().axis(1,maxLoad-1)[0]);
     } else if (d.dimensionType() == nix::DimensionType::Range) {
-        totalXRange.expand(QCPRange(d.asRangeDimension().axis(1)[0],d.asRangeDimension().axis(1,dimMax-1)[0]));
-        ui->plot->xAxis->setRange(QCPRange(d.asRangeDimension().axis(1,0)[0],d.asRangeDimension().axis(1,maxLoad-1)[0]));
+        TickIndexPtr ticks = TickIndex::of(array, xDim);
+        totalXRange.expand(QCPRange(ticks->first(), ticks->last()));
+        ui->plot->xAxis->setRange(QCPRange(ticks->first(), ticks->tick(maxLoad-1)));
     } else {
         // How does this work for set dim ? TODO
         std::cerr << "Lineplotter::setXRange(array), not yet done. " << std::endl;
@@ -352,9 +607,12 @@ void LinePlotter::setXRange(QVector<double> xData) {
 }
 
 
-void LinePlotter::expandYRange(QVector<double> yData) {
-    double yMin = *std::min_element(yData.constBegin(), yData.constEnd());
-    double yMax = *std::max_element(yData.constBegin(), yData.constEnd());
+void LinePlotter::expandYRange(const ValueStats &stats) {
+    if(! stats.hasValues()) {
+        return;
+    }
+    double yMin = stats.min;
+    double yMax = stats.max;
     if (yMin == yMax)
         yMin = yMax-1;
 
@@ -363,38 +621,130 @@ void LinePlotter::expandYRange(QVector<double> yData) {
 
 
 void LinePlotter::setYRange(QVector<double> yData) {
-    double yMin = *std::min_element(yData.constBegin(), yData.constEnd());
-    double yMax = *std::max_element(yData.constBegin(), yData.constEnd());
-    if (yMin == yMax)
-        yMin = yMax-1;
-
-    totalYRange.expand(QCPRange(yMin, yMax));
+    expandYRange(nixview::util::value_stats(yData.constData(), yData.size()));
     ui->plot->yAxis->setRange(totalYRange.lower*1.05, totalYRange.upper*1.05);
 }
 
 
-void LinePlotter::drawThreadData(const QVector<double> &data, const QVector<double> &axis, int graphIndex) {
-    if(totalYRange == QCPRange(0, 0)) {
-        setYRange(data);
-    } else {
-        expandYRange(data);
+void LinePlotter::drawThreadData(const LoadBufferPtr &buffer, int from, int to, const ChunkStats &stats) {
+    if(to <= from) {
+        return;
     }
-    ui->plot->graph(graphIndex)->setData(axis, data, true);
-    ui->plot->replot();
+    QVector<QCPGraphData> points;
+
+    for(size_t c=0; c<buffer->channelCount(); c++) {
+        const double *values = buffer->values[c].data();
+
+        // the loader summarized the chunk, the values are not scanned again here.
+        bool first = totalYRange == QCPRange(0, 0);
+        expandYRange(stats.value(static_cast<int>(c)));
+        if(first && totalYRange != QCPRange(0, 0)) {
+            ui->plot->yAxis->setRange(totalYRange.lower*1.05, totalYRange.upper*1.05);
+        }
+
+        // the chunk replaces what the previous request showed in its range, the rest stays visible until it is overwritten.
+        bool last = to == static_cast<int>(buffer->size());
+        QCPAbstractPlottable *plottable = ui->plot->plottable(buffer->indices[c]);
+
+        if(SampledGraph *sampled = qobject_cast<SampledGraph*>(plottable)) {
+            if(! buffer->hasImplicitKeys()) {
+                std::cerr << "LinePlotter::drawThreadData(): sampled data delivered with explicit keys." << std::endl;
+                continue;
+            }
+            sampled->addData(buffer->key(from), buffer->interval, values + from, to - from);
+            if(last) {
+                sampled->removeOutside(buffer->key(0), buffer->key(to-1));
+            }
+        } else if(QCPGraph *graph = qobject_cast<QCPGraph*>(plottable)) {
+            points.resize(to - from);
+            for(int i=from; i<to; i++) {
+                points[i-from] = QCPGraphData(buffer->key(i), values[i]);
+            }
+            QSharedPointer<QCPGraphDataContainer> data = graph->data();
+            data->remove(buffer->key(from), buffer->key(to-1));
+            data->add(points, true);
+            // the lines to the neighbouring points changed as well.
+            tiles->invalidate(data->findBegin(buffer->key(from))->key, (data->findEnd(buffer->key(to-1)) - 1)->key);
+            if(last) {
+                data->removeBefore(buffer->key(0));
+                data->removeAfter(buffer->key(to-1));
+                tiles->invalidate(-std::numeric_limits<double>::infinity(), buffer->key(0));
+                tiles->invalidate(buffer->key(to-1), std::numeric_limits<double>::infinity());
+            }
+        }
+    }
+    // the scheduler coalesces the replots of all chunks into one per frame.
+    ReplotScheduler::instance().request(ui->plot);
+}
+
+void LinePlotter::drawStackedData(const LoadBufferPtr &buffer, int from, int to, const ChunkStats &stats) {
+    if(! stack || to <= from || ! buffer->hasImplicitKeys()) {
+        return;
+    }
+    TraceStack &s = *stack;
+
+    if(s.scale == 0) {
+        // the typical range of a channel in the first delivery sets the height of all traces.
+        std::vector<double> ranges;
+        for(const ValueStats &channel : stats) {
+            if(channel.hasValues() && channel.max > channel.min) {
+                ranges.push_back(channel.max - channel.min);
+            }
+        }
+        if(! ranges.empty()) {
+            std::nth_element(ranges.begin(), ranges.begin() + ranges.size() / 2, ranges.end());
+            s.scale = STACK_TRACE_HEIGHT / ranges[ranges.size() / 2];
+        }
+    }
+
+    bool last = to == static_cast<int>(buffer->size());
+    std::vector<double> rows(to - from);
+    for(size_t c=0; c<buffer->channelCount(); c++) {
+        int channel = buffer->indices[c];
+        // the channel may have left the band since it was requested.
+        SampledGraph *graph = s.assigned.value(channel);
+        if(! graph) {
+            continue;
+        }
+        ValueStats chunk = stats.value(static_cast<int>(c));
+        if(! s.baselines.contains(channel) && chunk.hasValues()) {
+            s.baselines.insert(channel, chunk.mean());
+        }
+        double baseline = s.baselines.value(channel, 0);
+
+        // larger values go up, which is towards the smaller rows of the reversed axis.
+        const double *values = buffer->values[c].data() + from;
+        for(int i=0; i<to-from; i++) {
+            rows[i] = channel - (values[i] - baseline) * s.scale;
+        }
+        graph->addData(buffer->key(from), buffer->interval, rows.data(), rows.size());
+        if(last) {
+            graph->removeOutside(buffer->key(0), buffer->key(to-1));
+            s.complete.insert(channel);
+        }
+    }
+    ReplotScheduler::instance().request(ui->plot);
 }
 
+
 void LinePlotter::printProgress(double progress) {
     std::cerr << "Loaded: " << progress*100 << "%" << std::endl;
 }
 
 void LinePlotter::resetView() {
-    QCPDataContainer<QCPGraphData> data = *ui->plot->graph()->data().data();
+    if(ui->plot->plottableCount() == 0) {
+        return;
+    }
+    if(stack) {
+        expandXRange(arrays[stack->array], stack->xDim);
+        ui->plot->yAxis->setRange(-0.5, stack->slotCount - 0.5);
+        return;
+    }
+    QCPAbstractPlottable *plottable = ui->plot->plottable();
 
     // reset x Range
-    if(numOfPoints != 0 && numOfPoints < data.size()) {
-        QCPGraphData firstPoint = *data.at(0);
-        QCPGraphData lastPoint = *data.at(numOfPoints);
-        QCPRange resetX = QCPRange(firstPoint.sortKey(), lastPoint.sortKey());
+    if(numOfPoints != 0 && numOfPoints < data_count(plottable)) {
+        QCPRange resetX = QCPRange(data_key(plottable, 0), data_key(plottable, numOfPoints));
         ui->plot->xAxis->setRange(resetX);
     } else {
         ui->plot->xAxis->setRange(totalXRange);
@@ -405,16 +755,21 @@ void LinePlotter::resetView() {
 
 
 void LinePlotter::testThreads(QCPRange range) {
-    if(ui->plot->graphCount() == 0) {
+    if(ui->plot->plottableCount() == 0) {
+        return;
+    }
+    if(stack) {
+        update_stack();
         return;
     }
 
     int graphIndex = 0;
     for(int i=0; i<arrays.size(); i++) {
         int xDim = guess_best_xdim(arrays[i]);
-        QCPGraph *graph = ui->plot->graph(graphIndex);
+        QCPAbstractPlottable *graph = ui->plot->plottable(graphIndex);
+        int count = data_count(graph);
 
-        if(graph->dataCount() == 0) {
+        if(count == 0) {
             // with setVariables ?
             //loaders[i]->setVariables();
 
@@ -426,10 +781,11 @@ void LinePlotter::testThreads(QCPRange range) {
             continue;
         }
 
-        double max = graph->dataMainKey(graph->dataCount()-1);
-        double min = graph->dataMainKey(0);
-        double mean = graph->dataCount() / (max-min);
+        double max = data_key(graph, count-1);
+        double min = data_key(graph, 0);
+        double mean = count / (max-min);
 
+        loaders[i]->setPixelWidth(ui->plot->axisRect()->width());
         loaders[i]->startLoadingIfNeeded(range, xDim, min, max, mean);
 
         if(arrays[i].dataExtent().size() == 1) {
@@ -446,20 +802,28 @@ void LinePlotter::xAxisNewRange(QCPRange range) {
 }
 
 void LinePlotter::yAxisNewRange(QCPRange range) {
+    if(stack && range.size() > stack->slotCount) {
+        // more rows than slots cannot be shown, the new range arrives here again.
+        ui->plot->yAxis->setRange(range.center(), stack->slotCount, Qt::AlignCenter);
+        return;
+    }
     emit yAxisChanged(range, totalYRange);
+    if(stack) {
+        update_stack();
+    }
 }
 
 void LinePlotter::changeXAxisPosition(double newCenter) {
     if(ui->plot->xAxis->range().center() != newCenter) {
         ui->plot->xAxis->setRange(newCenter, ui->plot->xAxis->range().size(), Qt::AlignCenter);
-        ui->plot->replot();
+        ReplotScheduler::instance().request(ui->plot);
     }
 }
 
 void LinePlotter::changeYAxisPosition(double newCenter) {
     if(ui->plot->yAxis->range().center() != newCenter) {
         ui->plot->yAxis->setRange(newCenter, ui->plot->yAxis->range().size(), Qt::AlignCenter);
-        ui->plot->replot();
+        ReplotScheduler::instance().request(ui->plot);
     }
 }
 
@@ -468,7 +832,7 @@ void LinePlotter::changeXAxisSize(double ratio) {
 
     if(xNewSize != ui->plot->xAxis->range().size()) {
         ui->plot->xAxis->setRange(ui->plot->xAxis->range().center(), xNewSize, Qt::AlignCenter);
-        ui->plot->replot();
+        ReplotScheduler::instance().request(ui->plot);
     }
 }
 
@@ -492,12 +856,15 @@ void LinePlotter::selection_changed() {
     }
 
     // synchronize selection of graphs with selection of corresponding legend items:
-    for (int i=0; i<ui->plot->graphCount(); ++i) {
-        QCPGraph *graph = ui->plot->graph(i);
+    for (int i=0; i<ui->plot->plottableCount(); ++i) {
+        QCPAbstractPlottable *graph = ui->plot->plottable(i);
         QCPPlottableLegendItem *item = ui->plot->legend->itemWithPlottable(graph);
-        if (item->selected() || graph->selected()) {
-            item->setSelected(true);
-            QCPDataRange wholeGraph = QCPDataRange(0, graph->dataCount());
+        // stacked traces have no legend items.
+        if ((item && item->selected()) || graph->selected()) {
+            if (item) {
+                item->setSelected(true);
+            }
+            QCPDataRange wholeGraph = QCPDataRange(0, data_count(graph));
             QCPDataSelection selection = QCPDataSelection(wholeGraph);
             graph->setSelection(selection);
         }
@@ -538,8 +905,10 @@ void LinePlotter::context_menu_request(QPoint pos) {
     legend_action->setCheckable(true);
     legend_action->setChecked(ui->plot->legend->visible());
     menu->addAction("Clear selection", this, SLOT(clear_selection()));
-    if (ui->plot->selectedGraphs().size() > 0) {
-        menu->addAction("Remove selected graph", this, SLOT(remove_selected_graph()));
+    if (ui->plot->selectedPlottables().size() > 0) {
+        if (!stack) {
+            menu->addAction("Remove selected graph", this, SLOT(remove_selected_graph()));
+        }
         QMenu *line_style_menu = menu->addMenu("Line style");
         line_style_menu->addAction("none", this, SLOT(set_pen_none()));
         line_style_menu->addAction("solid", this, SLOT(set_pen_solid()));
@@ -561,43 +930,51 @@ void LinePlotter::context_menu_request(QPoint pos) {
 
 
 void LinePlotter::remove_selected_graph() {
-    if (ui->plot->selectedGraphs().size() > 0) {
-        ui->plot->removeGraph(ui->plot->selectedGraphs().first());
-        ui->plot->replot();
+    // the slots of stacked traces are reused for other channels.
+    if (ui->plot->selectedPlottables().size() > 0 && !stack) {
+        ui->plot->removePlottable(ui->plot->selectedPlottables().first());
+        ReplotScheduler::instance().request(ui->plot);
     }
 }
 
 
 void LinePlotter::show_legend() {
     ui->plot->legend->setVisible(!ui->plot->legend->visible());
-    ui->plot->replot();
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 
 void LinePlotter::clear_selection(){
     ui->plot->deselectAll();
-    ui->plot->replot();
+    ReplotScheduler::instance().request(ui->plot);
 }
 
 
 void LinePlotter::set_marker(QString marker){
-    QCPGraph *graph = ui->plot->selectedGraphs().first();
+    QCPAbstractPlottable *plottable = ui->plot->selectedPlottables().first();
+    QCPScatterStyle style;
     if (marker == "none") {
-        graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssNone, 0));
+        style = QCPScatterStyle(QCPScatterStyle::ssNone, 0);
     } else if (marker == "circle") {
-        graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssCircle, 10));
+        style = QCPScatterStyle(QCPScatterStyle::ssCircle, 10);
     } else if (marker == "diamond") {
-        graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssDiamond, 10));
+        style = QCPScatterStyle(QCPScatterStyle::ssDiamond, 10);
     } else if (marker == "dot") {
-        graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssDot, 10));
+        style = QCPScatterStyle(QCPScatterStyle::ssDot, 10);
     } else if (marker == "cross") {
-        graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssCross, 10));
+        style = QCPScatterStyle(QCPScatterStyle::ssCross, 10);
     } else if (marker == "square") {
-        graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssSquare, 10));
+        style = QCPScatterStyle(QCPScatterStyle::ssSquare, 10);
     } else if (marker == "plus") {
-        graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssPlus, 10));
+        style = QCPScatterStyle(QCPScatterStyle::ssPlus, 10);
     } else {
-        graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssNone, 10));
+        style = QCPScatterStyle(QCPScatterStyle::ssNone, 10);
+    }
+    if (SampledGraph *sampled = qobject_cast<SampledGraph*>(plottable)) {
+        sampled->setScatterStyle(style);
+    } else if (QCPGraph *graph = qobject_cast<QCPGraph*>(plottable)) {
+        graph->setScatterStyle(style);
+        tiles->invalidate();
     }
     clear_selection();
 }
@@ -636,7 +1013,7 @@ void LinePlotter::marker_plus(){
 
 
 void LinePlotter::set_pen_style(QString style) {
-    QCPGraph *graph = ui->plot->selectedGraphs().first();
+    QCPAbstractPlottable *graph = ui->plot->selectedPlottables().first();
     QPen pen = graph->pen();
     if (style == "none"){
         pen.setStyle(Qt::PenStyle::NoPen);
@@ -3,15 +3,21 @@
 
 #include <QWidget>
 #include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QScopedPointer>
 #include "plotter.h"
 #include <nix.hpp>
 #include "colormap.hpp"
 #include "utils/loadthread.h"
+#include "tilelayer.h"
 
 namespace Ui {
     class LinePlotter;
 }
 
+class SampledGraph;
+
 class LinePlotter : public QWidget, public Plotter {
     Q_OBJECT
 
@@ -45,6 +51,10 @@ public:
 
     void save(QString filename) {}
 
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
 private:
     Ui::LinePlotter *ui;
     ColorMap cmap;
@@ -54,15 +64,72 @@ private:
     QVector<nix::DataArray> arrays;
     QVector<LoadThread*> loaders;
     QVector<int> working;
+    // owned by the plot.
+    TileLayer *tiles;
+
+    /**
+     * @brief TraceStack: the stacked display of a 2D array with a sampled and a set dimension.
+     * Channel i is drawn around y = i on a reversed y-axis (channel 0 on top), scaled to about one row.
+     * Only the channels in the visible band get one of the recycled slot graphs and are loaded,
+     * the view never shows more rows than there are slots.
+     */
+    struct TraceStack {
+        int array;
+        int xDim;
+        int channels;
+        int slotCount;
+        QVector<QString> labels;
+        QVector<QColor> colors;
+        // the slots are owned by the plot.
+        QVector<SampledGraph*> freeSlots;
+        QHash<int, SampledGraph*> assigned;
+        // channels of the current window that were delivered completely, and those of the running request.
+        QSet<int> complete;
+        QSet<int> requested;
+        // the value every channel is drawn around, its mean in the first delivered chunk.
+        QHash<int, double> baselines;
+        // rows per value unit, fixed by the first delivery.
+        double scale;
+        int level;
+        nix::NDSize start;
+        nix::NDSize extent;
+        QCPRange window;
+    };
+    // only set while the plot shows stacked traces.
+    QScopedPointer<TraceStack> stack;
 
     void draw_1d(const nix::DataArray &array);
 
     void draw_2d(const nix::DataArray &array);
 
+    /**
+     * @brief stackable: whether the array is drawn as stacked traces. True for 2D Sample x Set arrays with more channels
+     * than PLOT_GROUP/PLOT_STACK_CHANNELS (16 by default, 0 disables stacking) that are the first array of the plot.
+     */
+    bool stackable(const nix::DataArray &array) const;
+    void draw_stacked(const nix::DataArray &array);
+
+    /**
+     * @brief update_stack: assigns the slots to the channels in the visible band and loads the channels that are missing,
+     * at the LodPyramid level of the current zoom.
+     */
+    void update_stack();
+
+    /**
+     * @brief add_trace: adds the plottable for one channel, a SampledGraph for a sampled x-dimension, a TiledGraph otherwise.
+     * The loaders address it by its plottable index, the TileLayer draws it.
+     */
+    void add_trace(const nix::DataArray &array, const nix::Dimension &xDim, const QPen &pen);
+    int data_count(QCPAbstractPlottable *plottable) const;
+    double data_key(QCPAbstractPlottable *plottable, int index) const;
+
     QCustomPlot* get_plot() override;
     void expandXRange(const nix::DataArray &array, int xDim);
     void setXRange(QVector<double> xData);
-    void expandYRange(QVector<double> yData);
+    /**
+     * @brief expandYRange: expands the total y range by the summarized values, a summary of NaNs only changes nothing.
+     */
+    void expandYRange(const ValueStats &stats);
     void setYRange(QVector<double> yData);
     //void calcStartExtent(const nix::DataArray &array, nix::NDSize &start_size, nix::NDSize& extent_size, int xDim);
     //bool checkForMoreData(int arrayIndex, double currentExtreme, bool higher);
@@ -72,7 +139,8 @@ signals:
     void yAxisChanged(QCPRange yNow, QCPRange yComplete);
 
 public slots:
-    void drawThreadData(const QVector<double> &data, const QVector<double> &axis, int graphIndex);
+    void drawThreadData(const LoadBufferPtr &buffer, int from, int to, const ChunkStats &stats);
+    void drawStackedData(const LoadBufferPtr &buffer, int from, int to, const ChunkStats &stats);
     void testThreads(QCPRange range);
     void printProgress(double progress);
     //void checkGraphsPerArray(QCPRange range);
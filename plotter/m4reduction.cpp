@@ -0,0 +1,157 @@
+#include "m4reduction.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace {
+
+struct GridKeys {
+    double first;
+    double interval;
+
+    double operator()(size_t index) const {
+        return first + index * interval;
+    }
+};
+
+struct ExplicitKeys {
+    const double *keys;
+
+    double operator()(size_t index) const {
+        return keys[index];
+    }
+};
+
+// keys or values interleaved with other fields, stride doubles apart.
+struct StridedKeys {
+    const double *keys;
+    size_t stride;
+
+    double operator()(size_t index) const {
+        return keys[index * stride];
+    }
+};
+
+struct StridedValues {
+    const double *values;
+    size_t stride;
+
+    double operator[](size_t index) const {
+        return values[index * stride];
+    }
+};
+
+}
+
+
+bool M4Key::operator==(const M4Key &other) const {
+    return lower == other.lower && upper == other.upper && width == other.width && revision == other.revision;
+}
+
+
+bool M4Key::operator!=(const M4Key &other) const {
+    return !(*this == other);
+}
+
+
+M4Reduction::M4Reduction(const M4Key &key) :
+    reductionKey(key) {
+}
+
+
+const M4Key& M4Reduction::key() const {
+    return reductionKey;
+}
+
+
+const QVector<QPointF>& M4Reduction::points() const {
+    return reduced;
+}
+
+
+void M4Reduction::reduce(const double *values, size_t count, double firstKey, double interval) {
+    reduced.clear();
+    append(values, count, firstKey, interval);
+}
+
+
+void M4Reduction::reduce(const float *values, size_t count, double firstKey, double interval) {
+    reduced.clear();
+    append(values, count, firstKey, interval);
+}
+
+
+void M4Reduction::reduce(const double *keys, const double *values, size_t count) {
+    ExplicitKeys explicitKeys = {keys};
+    reduced.clear();
+    reduceValues(explicitKeys, values, count);
+}
+
+
+void M4Reduction::reduce(const double *keys, const double *values, size_t count, size_t stride) {
+    StridedKeys stridedKeys = {keys, stride};
+    StridedValues stridedValues = {values, stride};
+    reduced.clear();
+    reduceValues(stridedKeys, stridedValues, count);
+}
+
+
+void M4Reduction::append(const double *values, size_t count, double firstKey, double interval) {
+    GridKeys keys = {firstKey, interval};
+    reduceValues(keys, values, count);
+}
+
+
+void M4Reduction::append(const float *values, size_t count, double firstKey, double interval) {
+    GridKeys keys = {firstKey, interval};
+    reduceValues(keys, values, count);
+}
+
+
+template<typename Keys, typename Values>
+void M4Reduction::reduceValues(const Keys &keys, const Values &values, size_t count) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    if (count == 0 || reductionKey.width <= 0 || !(reductionKey.upper > reductionKey.lower)) {
+        return;
+    }
+    double scale = reductionKey.width / (reductionKey.upper - reductionKey.lower);
+    if (reduced.isEmpty()) {
+        reduced.reserve(static_cast<int>(std::min(count, static_cast<size_t>(4 * reductionKey.width + 8))));
+    }
+
+    size_t i = 0;
+    while (i < count) {
+        if (qIsNaN(values[i])) {
+            if (!reduced.isEmpty() && !qIsNaN(reduced.last().y())) {
+                reduced.append(QPointF(nan, nan));
+            }
+            ++i;
+            continue;
+        }
+        double column = std::floor((keys(i) - reductionKey.lower) * scale);
+        size_t first = i, last = i, minIndex = i, maxIndex = i;
+        for (++i; i < count; ++i) {
+            auto v = values[i];
+            // a NaN ends the column, the line is interrupted within it.
+            if (qIsNaN(v) || std::floor((keys(i) - reductionKey.lower) * scale) != column) {
+                break;
+            }
+            if (v < values[minIndex]) {
+                minIndex = i;
+            }
+            if (v > values[maxIndex]) {
+                maxIndex = i;
+            }
+            last = i;
+        }
+
+        // first, min, max and last in the order they occur, each sample once.
+        size_t kept[4] = {first, std::min(minIndex, maxIndex), std::max(minIndex, maxIndex), last};
+        for (int k = 0; k < 4; ++k) {
+            if (k == 0 || kept[k] > kept[k - 1]) {
+                reduced.append(QPointF(keys(kept[k]), values[kept[k]]));
+            }
+        }
+    }
+}
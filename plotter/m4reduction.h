@@ -0,0 +1,81 @@
+#ifndef M4REDUCTION_H
+#define M4REDUCTION_H
+
+#include <QSharedPointer>
+#include <QMetaType>
+#include <QVector>
+#include <QPointF>
+#include <QtGlobal>
+
+
+/**
+ * @brief M4Key: what a reduction was computed for, the visible key range, the width of the key axis in pixels
+ * and the revision of the graph data.
+ */
+struct M4Key
+{
+    double lower;
+    double upper;
+    int width;
+    quint64 revision;
+
+    bool operator==(const M4Key &other) const;
+    bool operator!=(const M4Key &other) const;
+};
+
+
+/**
+ * @brief M4Reduction: Regularly sampled values reduced to the first, minimum, maximum and last sample of each pixel column.
+ * Connected by lines these (at most) four points per column cover the same pixels as all samples of the column,
+ * so drawing the reduction looks like drawing every sample while it costs O(width) instead of O(samples).
+ */
+class M4Reduction
+{
+public:
+    M4Reduction(const M4Key &key);
+
+    const M4Key& key() const;
+
+    /**
+     * @brief points: the kept samples as (key, value) in plot coordinates. A NaN point interrupts the line.
+     */
+    const QVector<QPointF>& points() const;
+
+    /**
+     * @brief reduce: reduces count values of a grid that starts at firstKey. Column c covers the keys
+     * [lower + c * (upper - lower) / width, lower + (c + 1) * (upper - lower) / width) of the key.
+     * Samples outside of [lower, upper] are reduced as well, they fall into columns left and right of the range.
+     */
+    void reduce(const double *values, size_t count, double firstKey, double interval);
+    void reduce(const float *values, size_t count, double firstKey, double interval);
+
+    /**
+     * @brief reduce: reduces count samples with the given keys, which have to be sorted ascending.
+     */
+    void reduce(const double *keys, const double *values, size_t count);
+
+    /**
+     * @brief reduce: like above for keys and values that are stored interleaved, e.g. in an array of structs,
+     * the key and value of sample i are keys[i * stride] and values[i * stride].
+     */
+    void reduce(const double *keys, const double *values, size_t count, size_t stride);
+
+    /**
+     * @brief append: reduces count values of a grid like reduce() and appends them to the points, for grids that are stored
+     * in pieces. The values have to follow those reduced before, a column split between two pieces keeps the points of both parts.
+     */
+    void append(const double *values, size_t count, double firstKey, double interval);
+    void append(const float *values, size_t count, double firstKey, double interval);
+
+private:
+    M4Key reductionKey;
+    QVector<QPointF> reduced;
+
+    template<typename Keys, typename Values>
+    void reduceValues(const Keys &keys, const Values &values, size_t count);
+};
+
+typedef QSharedPointer<const M4Reduction> M4ReductionPtr;
+Q_DECLARE_METATYPE(M4ReductionPtr)
+
+#endif // M4REDUCTION_H
@@ -0,0 +1,153 @@
+#include "perieventplotter.h"
+#include "ui_perieventplotter.h"
+#include "plotter.h"
+#include "colormap.hpp"
+#include "replotscheduler.h"
+#include <cmath>
+
+// the window around positions without extent, in samples before and after.
+static const int DEFAULT_WINDOW_SAMPLES = 50;
+// at most this many lines of a reference with more than one dimension are averaged into the plot.
+static const int MAX_LINES = 8;
+
+PeriEventPlotter::PeriEventPlotter(QWidget *parent) :
+    QWidget(parent), ui(new Ui::PeriEventPlotter), reference(0) {
+    ui->setupUi(this);
+    connect(ui->beforeSpin, SIGNAL(editingFinished()), this, SLOT(windowChanged()));
+    connect(ui->afterSpin, SIGNAL(editingFinished()), this, SLOT(windowChanged()));
+    connect(&average, SIGNAL(updated()), this, SLOT(averageUpdated()));
+    connect(&average, SIGNAL(finished()), this, SLOT(averageFinished()));
+}
+
+
+PeriEventPlotter::~PeriEventPlotter() {
+    delete ui;
+}
+
+
+void PeriEventPlotter::setSource(const nix::MultiTag &tag, size_t reference) {
+    this->tag = tag;
+    this->reference = reference;
+    double window = 0;
+    QString unit;
+    if (reference < tag.referenceCount()) {
+        nix::DataArray array = tag.getReference(reference);
+        unit = QString::fromStdString(TaggedSlices::unit(tag, array, 0));
+        if (tag.extents() == nix::none) {
+            // the window is given in the units of the tag, the sampling interval in those of the dimension.
+            nix::Dimension dim = array.getDimension(1);
+            double interval = dim.dimensionType() == nix::DimensionType::Sample ? dim.asSampledDimension().samplingInterval() : 1.0;
+            window = DEFAULT_WINDOW_SAMPLES * interval / TaggedSlices::unitScale(tag, array, 0);
+        }
+    }
+    QString suffix = unit.isEmpty() ? QString(":") : QString(" [%1]:").arg(unit);
+    ui->beforeLabel->setText("before" + suffix);
+    ui->afterLabel->setText("after" + suffix);
+    ui->beforeSpin->blockSignals(true);
+    ui->afterSpin->blockSignals(true);
+    ui->beforeSpin->setValue(window);
+    ui->afterSpin->setValue(window);
+    ui->beforeSpin->blockSignals(false);
+    ui->afterSpin->blockSignals(false);
+    start();
+}
+
+
+void PeriEventPlotter::cancel() {
+    average.cancel();
+}
+
+
+void PeriEventPlotter::windowChanged() {
+    if (!tag.isNone()) {
+        start();
+    }
+}
+
+
+void PeriEventPlotter::start() {
+    QCustomPlot *plot = ui->plot;
+    plot->clearGraphs();
+    means.clear();
+    uppers.clear();
+    lowers.clear();
+
+    double before = ui->beforeSpin->value();
+    double after = ui->afterSpin->value();
+    bool extents = before == 0 && after == 0;
+    if (!average.setSource(tag, reference, extents ? NAN : before, extents ? NAN : after) || average.windowCount() == 0) {
+        ui->statusLabel->setText("no windows");
+        ReplotScheduler::instance().request(plot);
+        return;
+    }
+    keys = average.keys();
+
+    ColorMap cmap;
+    for (int l = 0; l < std::min(average.lineCount(), MAX_LINES); l++) {
+        QColor color = cmap.next();
+        QColor band = color;
+        band.setAlpha(50);
+        QCPGraph *upper = plot->addGraph();
+        QCPGraph *lower = plot->addGraph();
+        upper->setPen(Qt::NoPen);
+        lower->setPen(Qt::NoPen);
+        lower->setBrush(band);
+        lower->setChannelFillGraph(upper);
+        QCPGraph *mean = plot->addGraph();
+        mean->setPen(QPen(color));
+        means.append(mean);
+        uppers.append(upper);
+        lowers.append(lower);
+    }
+    QString ylabel;
+    QVector<QString> labels;
+    Plotter::data_array_ax_labels(average.array(), ylabel, labels);
+    plot->yAxis->setLabel(ylabel);
+    // the keys are relative to the positions, in the units of the tag for a sampled first dimension.
+    nix::Dimension dim = average.array().getDimension(1);
+    if (dim.dimensionType() == nix::DimensionType::Sample) {
+        boost::optional<std::string> label = dim.asSampledDimension().label();
+        std::string unit = TaggedSlices::unit(tag, average.array(), 0);
+        QString xlabel = label ? QString::fromStdString(*label) : QString();
+        if (!unit.empty()) {
+            xlabel += " [" + QString::fromStdString(unit) + "]";
+        }
+        plot->xAxis->setLabel(xlabel);
+    } else {
+        plot->xAxis->setLabel("sample");
+    }
+    ui->statusLabel->setText(QString("0 / %1").arg(average.windowCount()));
+    average.start();
+}
+
+
+void PeriEventPlotter::averageUpdated() {
+    draw();
+}
+
+
+void PeriEventPlotter::averageFinished() {
+    draw();
+}
+
+
+void PeriEventPlotter::draw() {
+    QVector<double> mean, sd;
+    int done = average.result(mean, sd);
+    int length = average.windowLength();
+    QVector<double> m(length), upper(length), lower(length);
+    for (int l = 0; l < means.size(); l++) {
+        for (int j = 0; j < length; j++) {
+            double s = std::isnan(sd[l * length + j]) ? 0 : sd[l * length + j];
+            m[j] = mean[l * length + j];
+            upper[j] = m[j] + s;
+            lower[j] = m[j] - s;
+        }
+        means[l]->setData(keys, m, true);
+        uppers[l]->setData(keys, upper, true);
+        lowers[l]->setData(keys, lower, true);
+    }
+    ui->statusLabel->setText(QString("%1 / %2").arg(done).arg(average.windowCount()));
+    ui->plot->rescaleAxes();
+    ReplotScheduler::instance().request(ui->plot);
+}
@@ -0,0 +1,50 @@
+#ifndef PERIEVENTPLOTTER_H
+#define PERIEVENTPLOTTER_H
+
+#include <QWidget>
+#include <nix.hpp>
+#include "qcustomplot.h"
+#include "utils/perievent.h"
+
+namespace Ui {
+class PeriEventPlotter;
+}
+
+class PeriEventPlotter : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PeriEventPlotter(QWidget *parent = 0);
+    ~PeriEventPlotter();
+
+    /**
+     * @brief setSource: plots the mean +- SD of the reference around the positions of the tag, updated while the windows
+     * are averaged. The windows are the extents of the positions, or a window of a few samples around positions without extent
+     * until the user sets one.
+     */
+    void setSource(const nix::MultiTag &tag, size_t reference);
+
+    void cancel();
+
+private slots:
+    void windowChanged();
+    void averageUpdated();
+    void averageFinished();
+
+private:
+    Ui::PeriEventPlotter *ui;
+    PeriEventAverage average;
+    nix::MultiTag tag;
+    size_t reference;
+    QVector<double> keys;
+    // per line the mean and the bounds of the SD band, owned by the plot.
+    QVector<QCPGraph*> means;
+    QVector<QCPGraph*> uppers;
+    QVector<QCPGraph*> lowers;
+
+    void start();
+    void draw();
+};
+
+#endif // PERIEVENTPLOTTER_H
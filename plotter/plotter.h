@@ -4,6 +4,7 @@
 #include <QVariant>
 #include <QSignalMapper>
 #include "plotter/qcustomplot.h"
+#include "utils/blockcache.h"
 #include <QWidget>
 #include <nix.hpp>
 
@@ -127,7 +128,7 @@ public:
         count[dim -1] = shape[dim - 1];
         nix::NDSize offset(shape.size(), 0);
         offset[other_dim - 1] = index;
-        array.getData(nix::DataType::Double, data.data(), count, offset);
+        BlockCache::read(array, data.data(), count, offset);
         return QVector<double>::fromStdVector(data);
     }
 
@@ -142,7 +143,7 @@ public:
             xdata = QVector<double>::fromStdVector(ax);
 
             std::vector<double> data(ax.size());
-            array.getData(nix::DataType::Double, data.data(), {ax.size()}, {0});
+            BlockCache::read(array, data.data(), {ax.size()}, {0});
             ydata = QVector<double>::fromStdVector(data);
         } else if (d.dimensionType() == nix::DimensionType::Range) {
             nix::RangeDimension dim = d.asRangeDimension();
@@ -150,14 +151,15 @@ public:
             xdata = QVector<double>::fromStdVector(ax);
 
             std::vector<double> data(ax.size());
-            array.getData(nix::DataType::Double, data.data(), {ax.size()}, {0});
+            BlockCache::read(array, data.data(), {ax.size()}, {0});
             ydata = QVector<double>::fromStdVector(data);
             if (dim.alias()) {
                 ydata.fill(1.0);
             }
         } else if (d.dimensionType() == nix::DimensionType::Set) {
-            std::vector<double> data;
-            array.getData(data);
+            nix::NDSize shape = array.dataExtent();
+            std::vector<double> data(shape.nelms());
+            BlockCache::read(array, data.data(), shape, nix::NDSize(shape.size(), 0));
             ydata = QVector<double>::fromStdVector(data);
 
             nix::SetDimension dim = d.asSetDimension();
@@ -259,8 +261,17 @@ public:
                 }
             }
             break;
+        case 3:
+            // a stack of images along the first dimension.
+            if ((array.getDimension(2).dimensionType() == nix::DimensionType::Sample ||
+                 array.getDimension(2).dimensionType() == nix::DimensionType::Range) &&
+                (array.getDimension(3).dimensionType() == nix::DimensionType::Sample ||
+                 array.getDimension(3).dimensionType() == nix::DimensionType::Range)) {
+                return PlotterType::Image;
+            }
+            break;
         default:
-            std::cerr << "Sorry, cannot plot data with more than 2d!" << std::endl;
+            std::cerr << "Sorry, cannot plot data with more than 3d!" << std::endl;
             break;
         }
 
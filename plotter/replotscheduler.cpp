@@ -0,0 +1,102 @@
+#include "replotscheduler.h"
+#include "qcustomplot.h"
+#include "common/Common.hpp"
+#include <QCoreApplication>
+#include <QSettings>
+#include <QList>
+#include <iostream>
+
+
+ReplotScheduler& ReplotScheduler::instance() {
+    // a child of the application, it goes away together with the event loop it runs on.
+    static ReplotScheduler *scheduler = new ReplotScheduler(QCoreApplication::instance());
+    return *scheduler;
+}
+
+
+ReplotScheduler::ReplotScheduler(QObject *parent) :
+    QObject(parent) {
+    QSettings settings;
+    settings.beginGroup(PLOT_GROUP);
+    int rate = settings.value(PLOT_FRAME_RATE, 60).toInt();
+    settings.endGroup();
+    if(rate < 1) {
+        std::cerr << "ReplotScheduler: frame rate has to be at least 1." << std::endl;
+        rate = 60;
+    }
+    interval = qMax(1, 1000 / rate);
+
+    timer.setSingleShot(true);
+    connect(&timer, SIGNAL(timeout()), this, SLOT(frame()));
+    sinceFrame.start();
+}
+
+
+void ReplotScheduler::request(QCustomPlot *plot) {
+    if(!plot) {
+        return;
+    }
+    Entry &entry = plots[plot];
+    if(entry.plot != plot) {
+        // a new plot, or one at the address of a deleted one.
+        FrameStats empty = {0, 0, 0, 0, 0};
+        entry.plot = plot;
+        entry.stats = empty;
+    }
+    entry.dirty = true;
+    if(!timer.isActive()) {
+        qint64 wait = interval - sinceFrame.elapsed();
+        timer.start(wait > 0 ? static_cast<int>(wait) : 0);
+    }
+}
+
+
+int ReplotScheduler::frameInterval() const {
+    return interval;
+}
+
+
+FrameStats ReplotScheduler::stats(const QCustomPlot *plot) const {
+    QHash<const QCustomPlot*, Entry>::const_iterator it = plots.constFind(plot);
+    if(it == plots.constEnd() || !it->plot) {
+        FrameStats empty = {0, 0, 0, 0, 0};
+        return empty;
+    }
+    return it->stats;
+}
+
+
+void ReplotScheduler::frame() {
+    sinceFrame.restart();
+
+    // replotting may request the next frame, so the dirty plots are collected first.
+    QList<QCustomPlot*> dirty;
+    for(QHash<const QCustomPlot*, Entry>::iterator it = plots.begin(); it != plots.end();) {
+        if(!it->plot) {
+            it = plots.erase(it);
+            continue;
+        }
+        if(it->dirty) {
+            it->dirty = false;
+            dirty.append(it->plot.data());
+        }
+        ++it;
+    }
+
+    for(QCustomPlot *plot : dirty) {
+        QElapsedTimer render;
+        render.start();
+        plot->replot();
+        double ms = render.nsecsElapsed() / 1e6;
+
+        FrameStats &stats = plots[plot].stats;
+        stats.frames++;
+        stats.lastMs = ms;
+        stats.averageMs += (ms - stats.averageMs) / stats.frames;
+        stats.maxMs = qMax(stats.maxMs, ms);
+        if(ms > interval) {
+            stats.overBudget++;
+        }
+        emit frameRendered(plot, ms);
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef REPLOTSCHEDULER_H
+#define REPLOTSCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class QCustomPlot;
+
+
+/**
+ * @brief FrameStats: the render times of the frames of one plot in milliseconds.
+ */
+struct FrameStats
+{
+    int frames;
+    double lastMs;
+    double averageMs;
+    double maxMs;
+    // frames that took longer than the frame interval.
+    int overBudget;
+};
+
+
+/**
+ * @brief ReplotScheduler: Coalesces the replots of all plotters. A request only marks the plot dirty,
+ * the dirty plots are replotted together at most once per frame. The frame rate is read from the settings
+ * (PLOT_GROUP/PLOT_FRAME_RATE, 60 by default) when the scheduler is first used.
+ * The render time of every frame is recorded, see stats() and frameRendered().
+ * Lives on the gui thread.
+ */
+class ReplotScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static ReplotScheduler& instance();
+
+    /**
+     * @brief request: marks the plot dirty, it is replotted with the next frame.
+     */
+    void request(QCustomPlot *plot);
+
+    /**
+     * @brief frameInterval: the minimal time between two frames (the render budget) in milliseconds.
+     */
+    int frameInterval() const;
+
+    FrameStats stats(const QCustomPlot *plot) const;
+
+signals:
+    /**
+     * @brief frameRendered: emitted after a plot was replotted.
+     * @param milliseconds: the time the replot took.
+     */
+    void frameRendered(QCustomPlot *plot, double milliseconds);
+
+private slots:
+    void frame();
+
+private:
+    explicit ReplotScheduler(QObject *parent);
+
+    struct Entry {
+        QPointer<QCustomPlot> plot;
+        bool dirty;
+        FrameStats stats;
+    };
+
+    QHash<const QCustomPlot*, Entry> plots;
+    QTimer timer;
+    QElapsedTimer sinceFrame;
+    int interval;
+};
+
+#endif // REPLOTSCHEDULER_H
@@ -0,0 +1,716 @@
+#include "sampledgraph.h"
+#include "replotscheduler.h"
+#include "../utils/loadscheduler.h"
+#include <cmath>
+#include <limits>
+
+// keys of two runs on the same grid may differ by rounding, not by a fraction of a sample.
+static const double GRID_TOLERANCE = 1e-3;
+
+const size_t SampledGraph::CHUNK_SAMPLES;
+
+
+SampledGraph::Samples SampledGraph::Samples::section(size_t begin, size_t end) const {
+    Samples part;
+    part.single = single;
+    if (begin >= end) {
+        return part;
+    }
+    int first = static_cast<int>((head + begin) / CHUNK_SAMPLES);
+    int last = static_cast<int>((head + end - 1) / CHUNK_SAMPLES);
+    part.chunks = chunks.mid(first, last - first + 1);
+    part.head = (head + begin) % CHUNK_SAMPLES;
+    part.size = end - begin;
+    return part;
+}
+
+
+void SampledGraph::Samples::reduce(M4Reduction &reduction, size_t begin, size_t end, double firstKey, double interval) const {
+    size_t index = begin;
+    while (index < end) {
+        size_t slot = head + index;
+        const Chunk *chunk = chunks.at(static_cast<int>(slot / CHUNK_SAMPLES)).constData();
+        size_t offset = slot % CHUNK_SAMPLES;
+        size_t count = std::min(CHUNK_SAMPLES - offset, end - index);
+        double key = firstKey + (index - begin) * interval;
+        if (single) {
+            reduction.append(chunk->floats.data() + offset, count, key, interval);
+        } else {
+            reduction.append(chunk->doubles.data() + offset, count, key, interval);
+        }
+        index += count;
+    }
+}
+
+
+/**
+ * @brief ReductionJob: reduces the samples shared at submission on a worker and hands the result to the graph.
+ */
+class SampledGraph::ReductionJob : public LoadJob
+{
+public:
+    ReductionJob(SampledGraph *graph, const M4Key &view, const Samples &samples, double firstKey, double interval) :
+        LoadJob(graph, LoadPriority::Visible), graph(graph), view(view), samples(samples),
+        firstKey(firstKey), interval(interval) {
+    }
+
+    bool step() override {
+        if (isCancelled()) {
+            return false;
+        }
+        // the job only reads its samples, the graph copies the chunks it changes meanwhile.
+        M4Reduction *reduction = new M4Reduction(view);
+        samples.reduce(*reduction, 0, samples.size, firstKey, interval);
+        // the graph waits for its running job when it is destroyed, so it is still alive here.
+        QMetaObject::invokeMethod(graph, "reductionReady", Qt::QueuedConnection, Q_ARG(M4ReductionPtr, M4ReductionPtr(reduction)));
+        return false;
+    }
+
+private:
+    SampledGraph *graph;
+    M4Key view;
+    const Samples samples;
+    double firstKey;
+    double interval;
+};
+
+
+/**
+ * @brief TileSnapshot: the samples and the style of the graph at the time a tile was requested.
+ */
+class SampledGraph::TileSnapshot : public TileContent
+{
+public:
+    // the samples around the tile only, sample 0 is at firstKey.
+    Samples samples;
+    double firstKey;
+    double interval;
+    QPen pen;
+    QCPScatterStyle scatter;
+    bool antialiased;
+    bool antialiasedScatters;
+
+    void render(QCPPainter *painter, const TileGeometry &geometry) const override {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        QVector<QPointF> lines;
+        size_t count = samples.size;
+        bool reduced = count >= 2 * static_cast<size_t>(geometry.width) + 2;
+        if (reduced) {
+            M4Key key = {geometry.keyLower, geometry.keyUpper(), geometry.width, 0};
+            M4Reduction reduction(key);
+            samples.reduce(reduction, 0, count, firstKey, interval);
+            lines.reserve(reduction.points().size());
+            for (const QPointF &point : reduction.points()) {
+                lines.append(qIsNaN(point.y()) ? QPointF(nan, nan) : QPointF(geometry.keyToPixel(point.x()), geometry.valueToPixel(point.y())));
+            }
+        } else {
+            lines.reserve(static_cast<int>(count));
+            for (size_t i = 0; i < count; ++i) {
+                double v = samples.value(i);
+                double key = firstKey + i * interval;
+                lines.append(qIsNaN(v) ? QPointF(nan, nan) : QPointF(geometry.keyToPixel(key), geometry.valueToPixel(v)));
+            }
+        }
+
+        painter->setPen(pen);
+        painter->setBrush(Qt::NoBrush);
+        painter->setAntialiasing(antialiased);
+        drawPolyline(painter, lines);
+        if (!scatter.isNone() && !reduced) {
+            painter->setAntialiasing(antialiasedScatters);
+            scatter.applyTo(painter, pen);
+            for (const QPointF &point : lines) {
+                if (!qIsNaN(point.x()) && !qIsNaN(point.y())) {
+                    scatter.drawShape(painter, point);
+                }
+            }
+        }
+    }
+};
+
+
+SampledGraph::SampledGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+    QCPAbstractPlottable(keyAxis, valueAxis), origin(0), spacing(1),
+    reduceColumns(true), revision(0), hasPending(false), validFrom(0) {
+    qRegisterMetaType<M4ReductionPtr>("M4ReductionPtr");
+}
+
+
+SampledGraph::~SampledGraph() {
+    LoadScheduler::instance().cancel(this, true);
+}
+
+
+void SampledGraph::setSinglePrecision(bool enabled) {
+    if (enabled == samples.single) {
+        return;
+    }
+    for (int c = 0; c < samples.chunks.size(); ++c) {
+        Chunk *chunk = samples.chunks[c].data();
+        if (enabled) {
+            chunk->floats.assign(chunk->doubles.begin(), chunk->doubles.end());
+            std::vector<double>().swap(chunk->doubles);
+        } else {
+            chunk->doubles.assign(chunk->floats.begin(), chunk->floats.end());
+            std::vector<float>().swap(chunk->floats);
+        }
+    }
+    samples.single = enabled;
+    changed();
+}
+
+
+bool SampledGraph::singlePrecision() const {
+    return samples.single;
+}
+
+
+void SampledGraph::setColumnReduction(bool enabled) {
+    reduceColumns = enabled;
+}
+
+
+bool SampledGraph::columnReduction() const {
+    return reduceColumns;
+}
+
+
+void SampledGraph::setTileLayer(TileLayer *layer) {
+    tiles = layer;
+    if (layer) {
+        layer->addSource(this);
+    }
+}
+
+
+void SampledGraph::setScatterStyle(const QCPScatterStyle &style) {
+    scatter = style;
+    if (tiles) {
+        tiles->invalidate();
+    }
+}
+
+
+QCPScatterStyle SampledGraph::scatterStyle() const {
+    return scatter;
+}
+
+
+void SampledGraph::addData(double firstKey, double interval, const double *values, size_t count) {
+    if (count == 0 || !(interval > 0)) {
+        return;
+    }
+    size_t size = dataCount();
+    double position = 0;
+
+    bool sameGrid = size > 0 && std::abs(interval - spacing) <= spacing * 1e-9;
+    if (sameGrid) {
+        double shift = (firstKey - origin) / spacing;
+        position = std::floor(shift + 0.5);
+        // a gap between the stored samples and the new ones cannot be represented.
+        sameGrid = std::abs(shift - position) < GRID_TOLERANCE &&
+                position <= static_cast<double>(size) && position + count >= 0;
+    }
+    if (!sameGrid) {
+        clearData();
+        origin = firstKey;
+        spacing = interval;
+        position = 0;
+    }
+
+    if (position < 0) {
+        prepend(static_cast<size_t>(-position));
+        origin = firstKey;
+        position = 0;
+    }
+    size_t first = static_cast<size_t>(position);
+    if (first + count > dataCount()) {
+        resize(first + count);
+    }
+    write(first, values, count);
+    changed();
+    // the lines to the neighbouring samples change as well.
+    invalidateTiles(firstKey - interval, firstKey + count * interval);
+}
+
+
+void SampledGraph::removeOutside(double lower, double upper) {
+    size_t begin, end;
+    if (!indexRange(lower, upper, 0, begin, end)) {
+        clearData();
+        return;
+    }
+    size_t size = dataCount();
+    if (begin > 0) {
+        invalidateTiles(origin, key(begin));
+    }
+    if (end < size) {
+        invalidateTiles(key(end - 1), key(size - 1));
+    }
+    resize(end);
+    // whole chunks in front are dropped, the rest of the first one stays unused.
+    samples.head += begin;
+    samples.size -= begin;
+    int unused = static_cast<int>(samples.head / CHUNK_SAMPLES);
+    samples.chunks.remove(0, unused);
+    samples.head -= unused * CHUNK_SAMPLES;
+    origin += begin * spacing;
+    changed();
+}
+
+
+void SampledGraph::clearData() {
+    // a running reduction keeps its own references to the chunks, there is nothing to copy.
+    bool single = samples.single;
+    samples = Samples();
+    samples.single = single;
+    changed();
+    latest.clear();
+    validFrom = revision;
+    if (tiles) {
+        tiles->invalidate();
+    }
+}
+
+
+size_t SampledGraph::dataCount() const {
+    return samples.size;
+}
+
+
+double SampledGraph::firstKey() const {
+    return origin;
+}
+
+
+double SampledGraph::interval() const {
+    return spacing;
+}
+
+
+bool SampledGraph::indexRange(double lower, double upper, size_t margin, size_t &begin, size_t &end) const {
+    double size = static_cast<double>(dataCount());
+    double first = std::ceil((lower - origin) / spacing - GRID_TOLERANCE) - margin;
+    double last = std::floor((upper - origin) / spacing + GRID_TOLERANCE) + margin;
+    first = std::max(first, 0.0);
+    last = std::min(last, size - 1);
+    if (!(first <= last)) {
+        begin = end = 0;
+        return false;
+    }
+    begin = static_cast<size_t>(first);
+    end = static_cast<size_t>(last) + 1;
+    return true;
+}
+
+
+void SampledGraph::resize(size_t size) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    size_t end = samples.head + size;
+    int count = static_cast<int>((end + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES);
+    samples.chunks.resize(count);
+    // the chunks in front are full, the last one ends with the samples so growing it later fills in NaN.
+    for (int c = 0; c < count; ++c) {
+        size_t length = c + 1 < count ? CHUNK_SAMPLES : end - c * CHUNK_SAMPLES;
+        const Chunk *chunk = samples.chunks.at(c).constData();
+        if (!chunk) {
+            samples.chunks[c] = new Chunk;
+        } else if ((samples.single ? chunk->floats.size() : chunk->doubles.size()) == length) {
+            continue;
+        }
+        Chunk *writable = samples.chunks[c].data();
+        if (samples.single) {
+            writable->floats.resize(length, static_cast<float>(nan));
+        } else {
+            writable->doubles.resize(length, nan);
+        }
+    }
+    samples.size = size;
+}
+
+
+void SampledGraph::prepend(size_t count) {
+    if (count > samples.head) {
+        // new chunks in front, the slots left of head are refilled below.
+        int added = static_cast<int>((count - samples.head + CHUNK_SAMPLES - 1) / CHUNK_SAMPLES);
+        samples.chunks.insert(0, added, QSharedDataPointer<Chunk>());
+        samples.head += added * CHUNK_SAMPLES;
+        for (int c = 0; c < added; ++c) {
+            samples.chunks[c] = new Chunk;
+            if (samples.single) {
+                samples.chunks[c]->floats.resize(CHUNK_SAMPLES);
+            } else {
+                samples.chunks[c]->doubles.resize(CHUNK_SAMPLES);
+            }
+        }
+    }
+    samples.head -= count;
+    samples.size += count;
+    write(0, nullptr, count);
+}
+
+
+void SampledGraph::write(size_t index, const double *values, size_t count) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    size_t done = 0;
+    while (done < count) {
+        size_t slot = samples.head + index + done;
+        // data() copies the chunk if a job or tile still shares it.
+        Chunk *chunk = samples.chunks[static_cast<int>(slot / CHUNK_SAMPLES)].data();
+        size_t offset = slot % CHUNK_SAMPLES;
+        size_t n = std::min(CHUNK_SAMPLES - offset, count - done);
+        if (samples.single) {
+            if (values) {
+                std::copy(values + done, values + done + n, chunk->floats.begin() + offset);
+            } else {
+                std::fill(chunk->floats.begin() + offset, chunk->floats.begin() + offset + n, static_cast<float>(nan));
+            }
+        } else {
+            if (values) {
+                std::copy(values + done, values + done + n, chunk->doubles.begin() + offset);
+            } else {
+                std::fill(chunk->doubles.begin() + offset, chunk->doubles.begin() + offset + n, nan);
+            }
+        }
+        done += n;
+    }
+}
+
+
+void SampledGraph::changed() {
+    ++revision;
+    reductions.clear();
+}
+
+
+void SampledGraph::invalidateTiles(double lower, double upper) {
+    if (tiles) {
+        tiles->invalidate(lower, upper);
+    }
+}
+
+
+M4ReductionPtr SampledGraph::cachedReduction(const M4Key &view) {
+    for (int i = 0; i < reductions.size(); ++i) {
+        if (reductions.at(i)->key() == view) {
+            M4ReductionPtr reduction = reductions.at(i);
+            reductions.removeAt(i);
+            reductions.prepend(reduction);
+            return reduction;
+        }
+    }
+    return M4ReductionPtr();
+}
+
+
+void SampledGraph::requestReduction(const M4Key &view, size_t begin, size_t end) {
+    if (hasPending && pending == view) {
+        return;
+    }
+    LoadScheduler &scheduler = LoadScheduler::instance();
+    // the reduction of a view that was left is not needed any more.
+    scheduler.cancel(this);
+    pending = view;
+    hasPending = true;
+    scheduler.submit(QSharedPointer<LoadJob>(new ReductionJob(this, view, samples.section(begin, end), key(begin), spacing)));
+}
+
+
+void SampledGraph::reductionReady(const M4ReductionPtr &reduction) {
+    const M4Key &view = reduction->key();
+    if (view.revision < validFrom) {
+        return;
+    }
+    if (hasPending && pending == view) {
+        hasPending = false;
+    }
+    latest = reduction;
+    if (view.revision != revision) {
+        // the samples changed meanwhile, the reduction of the new ones is requested with the next replot.
+        return;
+    }
+    reductions.prepend(reduction);
+    while (reductions.size() > REDUCTION_CACHE_SIZE) {
+        reductions.removeLast();
+    }
+    if (mParentPlot) {
+        ReplotScheduler::instance().request(mParentPlot);
+    }
+}
+
+
+QPointF SampledGraph::toPixels(double keyPixel, double valuePixel) const {
+    if (mKeyAxis.data()->orientation() == Qt::Horizontal) {
+        return QPointF(keyPixel, valuePixel);
+    }
+    return QPointF(valuePixel, keyPixel);
+}
+
+
+double SampledGraph::keyPixel(const QPointF &pixels) const {
+    return mKeyAxis.data()->orientation() == Qt::Horizontal ? pixels.x() : pixels.y();
+}
+
+
+double SampledGraph::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const {
+    if ((onlySelectable && mSelectable == QCP::stNone) || dataCount() == 0) {
+        return -1;
+    }
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    if (!keyAxis || !valueAxis || !keyAxis->axisRect()->rect().contains(pos.toPoint())) {
+        return -1;
+    }
+
+    // only the samples within the selection tolerance around pos on the key axis can be close enough.
+    double tolerance = mParentPlot->selectionTolerance();
+    QCPRange keys(keyAxis->pixelToCoord(keyPixel(pos) - tolerance), keyAxis->pixelToCoord(keyPixel(pos) + tolerance));
+    keys.normalize();
+    size_t begin, end;
+    if (!indexRange(keys.lower, keys.upper, 1, begin, end)) {
+        return -1;
+    }
+
+    double minDistSqr = std::numeric_limits<double>::max();
+    size_t closest = begin;
+    QCPVector2D p(pos);
+    QPointF previous = coordsToPixels(key(begin), value(begin));
+    for (size_t i = begin; i < end; ++i) {
+        QPointF current = coordsToPixels(key(i), value(i));
+        if (qIsNaN(current.x()) || qIsNaN(current.y())) {
+            previous = current;
+            continue;
+        }
+        double distSqr = i > begin && !qIsNaN(previous.x()) && !qIsNaN(previous.y()) ?
+                    p.distanceSquaredToLine(previous, current) : (p - QCPVector2D(current)).lengthSquared();
+        if (distSqr < minDistSqr) {
+            minDistSqr = distSqr;
+            closest = i;
+        }
+        previous = current;
+    }
+    if (minDistSqr == std::numeric_limits<double>::max()) {
+        return -1;
+    }
+    if (details) {
+        details->setValue(QCPDataSelection(QCPDataRange(static_cast<int>(closest), static_cast<int>(closest) + 1)));
+    }
+    return std::sqrt(minDistSqr);
+}
+
+
+QCPRange SampledGraph::getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain) const {
+    size_t size = dataCount();
+    foundRange = false;
+    if (size == 0) {
+        return QCPRange();
+    }
+    double first = 0;
+    double last = static_cast<double>(size - 1);
+    // the index where the keys change their sign.
+    double zero = -origin / spacing;
+    if (inSignDomain == QCP::sdPositive) {
+        first = std::max(first, std::floor(zero) + 1);
+    } else if (inSignDomain == QCP::sdNegative) {
+        last = std::min(last, std::ceil(zero) - 1);
+    }
+    if (first > last) {
+        return QCPRange();
+    }
+    foundRange = true;
+    return QCPRange(key(static_cast<size_t>(first)), key(static_cast<size_t>(last)));
+}
+
+
+QCPRange SampledGraph::getValueRange(bool &foundRange, QCP::SignDomain inSignDomain, const QCPRange &inKeyRange) const {
+    size_t begin = 0;
+    size_t end = dataCount();
+    foundRange = false;
+    if (inKeyRange != QCPRange() && !indexRange(inKeyRange.lower, inKeyRange.upper, 0, begin, end)) {
+        return QCPRange();
+    }
+
+    double lower = std::numeric_limits<double>::infinity();
+    double upper = -std::numeric_limits<double>::infinity();
+    for (size_t i = begin; i < end; ++i) {
+        double v = value(i);
+        if ((inSignDomain == QCP::sdPositive && !(v > 0)) || (inSignDomain == QCP::sdNegative && !(v < 0))) {
+            continue;
+        }
+        // NaN compares false and is skipped
+        if (v < lower) {
+            lower = v;
+        }
+        if (v > upper) {
+            upper = v;
+        }
+    }
+    foundRange = lower <= upper;
+    return foundRange ? QCPRange(lower, upper) : QCPRange();
+}
+
+
+bool SampledGraph::tileable() const {
+    return true;
+}
+
+
+TileContentPtr SampledGraph::tileContent(const TileGeometry &geometry) const {
+    TileSnapshot *snapshot = new TileSnapshot;
+    bool isSelected = selected() && mSelectionDecorator;
+    snapshot->pen = isSelected ? mSelectionDecorator->pen() : mPen;
+    snapshot->scatter = isSelected ? mSelectionDecorator->getFinalScatterStyle(scatter) : scatter;
+    snapshot->antialiased = TileContent::antialiased(mParentPlot, mAntialiased, QCP::aePlottables);
+    snapshot->antialiasedScatters = TileContent::antialiased(mParentPlot, mAntialiasedScatters, QCP::aeScatters);
+
+    // scatters next to the tile reach into it.
+    size_t margin = 1;
+    if (!snapshot->scatter.isNone()) {
+        margin += static_cast<size_t>(std::ceil(snapshot->scatter.size() * geometry.keyPerPixel / spacing));
+    }
+    size_t begin, end;
+    if (!indexRange(geometry.keyLower, geometry.keyUpper(), margin, begin, end)) {
+        begin = end = 0;
+    }
+    // only the chunks around the tile are shared with it.
+    snapshot->samples = samples.section(begin, end);
+    snapshot->firstKey = key(begin);
+    snapshot->interval = spacing;
+    return TileContentPtr(snapshot);
+}
+
+
+bool SampledGraph::getLines(QVector<QPointF> &lines, size_t begin, size_t end) const {
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    double pixelSpan = std::abs(keyAxis->coordToPixel(key(end - 1)) - keyAxis->coordToPixel(key(begin)));
+    lines.clear();
+
+    if (end - begin < 2 * pixelSpan + 2) {
+        lines.reserve(static_cast<int>(end - begin));
+        for (size_t i = begin; i < end; ++i) {
+            double v = value(i);
+            lines.append(qIsNaN(v) ? QPointF(nan, nan) : coordsToPixels(key(i), v));
+        }
+        return false;
+    }
+
+    lines.reserve(static_cast<int>(2 * pixelSpan + 4));
+    size_t i = begin;
+    while (i < end) {
+        double column = std::floor(keyAxis->coordToPixel(key(i)));
+        double minValue = std::numeric_limits<double>::infinity();
+        double maxValue = -std::numeric_limits<double>::infinity();
+        size_t minIndex = i, maxIndex = i;
+        for (; i < end && std::floor(keyAxis->coordToPixel(key(i))) == column; ++i) {
+            double v = value(i);
+            if (v < minValue) {
+                minValue = v;
+                minIndex = i;
+            }
+            if (v > maxValue) {
+                maxValue = v;
+                maxIndex = i;
+            }
+        }
+        if (!(minValue <= maxValue)) {
+            lines.append(QPointF(nan, nan));
+            continue;
+        }
+        double first = minIndex <= maxIndex ? minValue : maxValue;
+        double second = minIndex <= maxIndex ? maxValue : minValue;
+        lines.append(toPixels(column + 0.25, valueAxis->coordToPixel(first)));
+        lines.append(toPixels(column + 0.75, valueAxis->coordToPixel(second)));
+    }
+    return true;
+}
+
+
+void SampledGraph::getReducedLines(QVector<QPointF> &lines, const M4Reduction &reduction) const {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const QVector<QPointF> &points = reduction.points();
+    lines.clear();
+    lines.reserve(points.size());
+    for (const QPointF &point : points) {
+        lines.append(qIsNaN(point.y()) ? QPointF(nan, nan) : coordsToPixels(point.x(), point.y()));
+    }
+}
+
+
+void SampledGraph::draw(QCPPainter *painter) {
+    QCPAxis *keyAxis = mKeyAxis.data();
+    if (!keyAxis || !mValueAxis) {
+        qDebug() << Q_FUNC_INFO << "invalid key or value axis";
+        return;
+    }
+    if (tiles && tiles->draws(painter)) {
+        if (mSelectionDecorator) {
+            mSelectionDecorator->drawDecoration(painter, selection());
+        }
+        return;
+    }
+    size_t begin, end;
+    QCPRange range = keyAxis->range();
+    if (range.size() <= 0 || !indexRange(range.lower, range.upper, 1, begin, end)) {
+        return;
+    }
+
+    QVector<QPointF> lines;
+    bool reduced = true;
+    int width = keyAxis->orientation() == Qt::Horizontal ? keyAxis->axisRect()->width() : keyAxis->axisRect()->height();
+    if (reduceColumns && keyAxis->scaleType() == QCPAxis::stLinear && width > 0 && end - begin >= 2 * static_cast<size_t>(width) + 2) {
+        M4Key view = {range.lower, range.upper, width, revision};
+        M4ReductionPtr reduction = cachedReduction(view);
+        if (!reduction) {
+            // the last reduction is in plot coordinates and stays in place until the one for this view arrives,
+            // before the first one there is nothing to show.
+            requestReduction(view, begin, end);
+            reduction = latest;
+        }
+        if (reduction) {
+            getReducedLines(lines, *reduction);
+        }
+    } else {
+        reduced = getLines(lines, begin, end);
+    }
+    bool isSelected = selected() && mSelectionDecorator;
+
+    if (isSelected) {
+        mSelectionDecorator->applyPen(painter);
+    } else {
+        painter->setPen(mPen);
+    }
+    painter->setBrush(Qt::NoBrush);
+    applyDefaultAntialiasingHint(painter);
+    TileContent::drawPolyline(painter, lines);
+
+    // single samples are not distinguishable where the line was reduced.
+    QCPScatterStyle style = isSelected ? mSelectionDecorator->getFinalScatterStyle(scatter) : scatter;
+    if (!style.isNone() && !reduced) {
+        applyScattersAntialiasingHint(painter);
+        style.applyTo(painter, mPen);
+        for (const QPointF &point : lines) {
+            if (!qIsNaN(point.x()) && !qIsNaN(point.y())) {
+                style.drawShape(painter, point);
+            }
+        }
+    }
+
+    if (mSelectionDecorator) {
+        mSelectionDecorator->drawDecoration(painter, selection());
+    }
+}
+
+
+void SampledGraph::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const {
+    applyDefaultAntialiasingHint(painter);
+    painter->setPen(mPen);
+    painter->drawLine(QLineF(rect.left(), rect.top()+rect.height()/2.0, rect.right()+5, rect.top()+rect.height()/2.0));
+    if (!scatter.isNone()) {
+        applyScattersAntialiasingHint(painter);
+        scatter.applyTo(painter, mPen);
+        scatter.drawShape(painter, QRectF(rect).center());
+    }
+}
@@ -0,0 +1,190 @@
+#ifndef SAMPLEDGRAPH_H
+#define SAMPLEDGRAPH_H
+
+#include <vector>
+#include <QSharedData>
+#include <QSharedDataPointer>
+#include <QVector>
+#include "qcustomplot.h"
+#include "m4reduction.h"
+#include "tilelayer.h"
+
+
+/**
+ * @brief SampledGraph: A line graph of regularly sampled data. Only the values are stored, the key of sample i is
+ * firstKey() + i * interval(), so a sample takes 8 bytes (4 in single precision) instead of the 16 of a QCPGraphData,
+ * and the visible samples are found by arithmetic instead of a binary search.
+ * The stored samples are always one contiguous run on one grid, data on a different grid replaces them.
+ * They are kept in chunks of CHUNK_SAMPLES that the reduction jobs and tiles share, a change only copies the chunks it
+ * writes to that are still in use by one of them.
+ * Dense data is drawn as its M4Reduction, which is computed on the workers of the LoadScheduler and cached per key range and width.
+ * With a TileLayer the graph is rendered into its tiles instead.
+ */
+class SampledGraph : public QCPAbstractPlottable, public TileSource
+{
+    Q_OBJECT
+
+public:
+    SampledGraph(QCPAxis *keyAxis, QCPAxis *valueAxis);
+    ~SampledGraph();
+
+    /**
+     * @brief setSinglePrecision: stores the values as float. Only lossless for data that fits into a float,
+     * see nixview::util::exact_in_float().
+     */
+    void setSinglePrecision(bool enabled);
+    bool singlePrecision() const;
+
+    /**
+     * @brief setColumnReduction: whether more than two samples per pixel column are drawn as their M4Reduction (the default).
+     * Without it the columns are reduced to min/max while drawing.
+     */
+    void setColumnReduction(bool enabled);
+    bool columnReduction() const;
+
+    /**
+     * @brief setTileLayer: adds the graph to the layer, which draws it from then on.
+     */
+    void setTileLayer(TileLayer *layer);
+
+    void setScatterStyle(const QCPScatterStyle &style);
+    QCPScatterStyle scatterStyle() const;
+
+    /**
+     * @brief addData: writes count values starting at firstKey into the graph. Samples already stored at these keys are replaced.
+     * If the values are on a different grid or leave a gap to the stored samples, they replace all data of the graph.
+     */
+    void addData(double firstKey, double interval, const double *values, size_t count);
+
+    /**
+     * @brief removeOutside: removes all samples with keys outside of [lower, upper].
+     */
+    void removeOutside(double lower, double upper);
+    void clearData();
+
+    size_t dataCount() const;
+    double firstKey() const;
+    double interval() const;
+
+    double key(size_t index) const {
+        return origin + index * spacing;
+    }
+
+    double value(size_t index) const {
+        return samples.value(index);
+    }
+
+    double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details=0) const override;
+    QCPRange getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth) const override;
+    QCPRange getValueRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth, const QCPRange &inKeyRange=QCPRange()) const override;
+
+    bool tileable() const override;
+    TileContentPtr tileContent(const TileGeometry &geometry) const override;
+
+protected:
+    void draw(QCPPainter *painter) override;
+    void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const override;
+
+private slots:
+    void reductionReady(const M4ReductionPtr &reduction);
+
+private:
+    class ReductionJob;
+    class TileSnapshot;
+
+    static const size_t CHUNK_SAMPLES = 1 << 15;
+
+    /**
+     * @brief Chunk: CHUNK_SAMPLES values, only the last chunk of the samples is shorter.
+     */
+    struct Chunk : public QSharedData {
+        std::vector<double> doubles;
+        std::vector<float> floats;
+    };
+
+    /**
+     * @brief Samples: the values in chunks, shared with the running jobs and tiles. Writing to a chunk copies it only if
+     * one of them still reads it. Sample i is at slot head + i of the chunks.
+     */
+    struct Samples {
+        QVector<QSharedDataPointer<Chunk>> chunks;
+        size_t head;
+        size_t size;
+        bool single;
+
+        Samples() : head(0), size(0), single(false) {
+        }
+
+        double value(size_t index) const {
+            size_t slot = head + index;
+            const Chunk *chunk = chunks.at(static_cast<int>(slot / CHUNK_SAMPLES)).constData();
+            return single ? chunk->floats[slot % CHUNK_SAMPLES] : chunk->doubles[slot % CHUNK_SAMPLES];
+        }
+
+        /**
+         * @brief section: the samples [begin, end) sharing the chunks they lie in.
+         */
+        Samples section(size_t begin, size_t end) const;
+
+        /**
+         * @brief reduce: reduces the samples [begin, end) chunk by chunk, sample begin at firstKey.
+         */
+        void reduce(M4Reduction &reduction, size_t begin, size_t end, double firstKey, double interval) const;
+    };
+
+    static const int REDUCTION_CACHE_SIZE = 8;
+
+    double origin;
+    double spacing;
+    Samples samples;
+    QCPScatterStyle scatter;
+    QPointer<TileLayer> tiles;
+
+    bool reduceColumns;
+    // increased with every change of the samples.
+    quint64 revision;
+    // the reductions of the current revision, the most recently used first.
+    QList<M4ReductionPtr> reductions;
+    // the last finished reduction, drawn until the one for the current view arrives.
+    M4ReductionPtr latest;
+    M4Key pending;
+    bool hasPending;
+    // reductions of older revisions belong to replaced data.
+    quint64 validFrom;
+
+    void changed();
+    void invalidateTiles(double lower, double upper);
+    M4ReductionPtr cachedReduction(const M4Key &key);
+
+    /**
+     * @brief requestReduction: submits the reduction of the samples [begin, end) for key, unless it is already pending.
+     */
+    void requestReduction(const M4Key &key, size_t begin, size_t end);
+
+    /**
+     * @brief indexRange: the samples with keys in [lower, upper], widened by margin samples to each side.
+     * @return false if there are none.
+     */
+    bool indexRange(double lower, double upper, size_t margin, size_t &begin, size_t &end) const;
+    void resize(size_t size);
+    void prepend(size_t count);
+
+    /**
+     * @brief write: writes count values to the samples beginning at index, NaN if values is null.
+     */
+    void write(size_t index, const double *values, size_t count);
+
+    QPointF toPixels(double keyPixel, double valuePixel) const;
+    double keyPixel(const QPointF &pixels) const;
+
+    /**
+     * @brief getLines: the pixel positions of the samples [begin, end). With more than two samples per pixel
+     * only the minimum and maximum of each pixel column are kept, in the order they occur.
+     * NaN values become a NaN point that interrupts the line.
+     * @return whether the samples were reduced.
+     */
+    bool getLines(QVector<QPointF> &lines, size_t begin, size_t end) const;
+    void getReducedLines(QVector<QPointF> &lines, const M4Reduction &reduction) const;
+};
+
+#endif // SAMPLEDGRAPH_H
@@ -0,0 +1,183 @@
+#include "segmentgraph.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+
+SegmentGraph::SegmentGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+    QCPAbstractPlottable(keyAxis, valueAxis) {
+    setSelectable(QCP::stWhole);
+}
+
+
+void SegmentGraph::setData(const QVector<double> &positions, const QVector<double> &extents) {
+    std::vector<std::pair<double, double>> segments;
+    segments.reserve(positions.size());
+    for (int i = 0; i < positions.size(); ++i) {
+        double start = positions[i];
+        double end = i < extents.size() ? start + extents[i] : start;
+        if (qIsNaN(start) || qIsNaN(end)) {
+            continue;
+        }
+        segments.push_back(std::make_pair(std::min(start, end), std::max(start, end)));
+    }
+    std::sort(segments.begin(), segments.end());
+
+    starts.resize(segments.size());
+    ends.resize(segments.size());
+    maxEnds.resize(segments.size());
+    double maxEnd = -std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < segments.size(); ++i) {
+        starts[i] = segments[i].first;
+        ends[i] = segments[i].second;
+        maxEnd = std::max(maxEnd, ends[i]);
+        maxEnds[i] = maxEnd;
+    }
+}
+
+
+void SegmentGraph::clearData() {
+    starts.clear();
+    ends.clear();
+    maxEnds.clear();
+}
+
+
+size_t SegmentGraph::dataCount() const {
+    return starts.size();
+}
+
+
+bool SegmentGraph::overlapping(double lower, double upper, size_t &begin, size_t &end) const {
+    // maxEnds never decreases, the first segment whose running maximum reaches lower is the first candidate.
+    begin = std::lower_bound(maxEnds.begin(), maxEnds.end(), lower) - maxEnds.begin();
+    end = std::upper_bound(starts.begin(), starts.end(), upper) - starts.begin();
+    return begin < end;
+}
+
+
+QRectF SegmentGraph::box(double start, double end) const {
+    return QRectF(coordsToPixels(start, 1), coordsToPixels(end, 0)).normalized();
+}
+
+
+void SegmentGraph::getBoxes(QVector<QRectF> &boxes, size_t begin, size_t end, double lower, double gap) const {
+    size_t i = begin;
+    while (i < end) {
+        if (ends[i] < lower) {
+            ++i;
+            continue;
+        }
+        double runStart = starts[i];
+        double runEnd = std::max(ends[i], starts[i] + gap);
+        size_t j = i + 1;
+        // all segments that start before the box ends join it. The segments before them end inside the box,
+        // so the running maximum of the ends is the end of the grown box.
+        for (;;) {
+            size_t next = std::upper_bound(starts.begin() + j, starts.begin() + end, runEnd + gap) - starts.begin();
+            if (next == j) {
+                break;
+            }
+            runEnd = std::max(runEnd, std::max(maxEnds[next - 1], starts[next - 1] + gap));
+            j = next;
+        }
+        boxes.append(box(runStart, runEnd));
+        i = j;
+    }
+}
+
+
+double SegmentGraph::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const {
+    if ((onlySelectable && mSelectable == QCP::stNone) || starts.empty()) {
+        return -1;
+    }
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    if (!keyAxis || !valueAxis || !keyAxis->axisRect()->rect().contains(pos.toPoint())) {
+        return -1;
+    }
+    double key, value;
+    pixelsToCoords(pos, key, value);
+    if (value < 0 || value > 1) {
+        return -1;
+    }
+
+    double tolerance = mParentPlot->selectionTolerance();
+    double pixel = keyAxis->orientation() == Qt::Horizontal ? pos.x() : pos.y();
+    QCPRange keys(keyAxis->pixelToCoord(pixel - tolerance), keyAxis->pixelToCoord(pixel + tolerance));
+    keys.normalize();
+    size_t begin, end;
+    if (!overlapping(keys.lower, keys.upper, begin, end)) {
+        return -1;
+    }
+    for (size_t i = begin; i < end; ++i) {
+        if (ends[i] >= keys.lower) {
+            if (details) {
+                details->setValue(QCPDataSelection(QCPDataRange(static_cast<int>(i), static_cast<int>(i) + 1)));
+            }
+            // inside a box, like QCPBars.
+            return tolerance * 0.99;
+        }
+    }
+    return -1;
+}
+
+
+QCPRange SegmentGraph::getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain) const {
+    foundRange = false;
+    if (starts.empty()) {
+        return QCPRange();
+    }
+    double lower = starts.front();
+    double upper = maxEnds.back();
+    // the boxes are not split at zero, a box reaching into the domain counts as a whole.
+    foundRange = !(inSignDomain == QCP::sdPositive && upper <= 0) && !(inSignDomain == QCP::sdNegative && lower >= 0);
+    return foundRange ? QCPRange(lower, upper) : QCPRange();
+}
+
+
+QCPRange SegmentGraph::getValueRange(bool &foundRange, QCP::SignDomain inSignDomain, const QCPRange &inKeyRange) const {
+    size_t begin = 0, end = 0;
+    foundRange = inSignDomain != QCP::sdNegative &&
+            (inKeyRange == QCPRange() ? !starts.empty() : overlapping(inKeyRange.lower, inKeyRange.upper, begin, end));
+    return foundRange ? QCPRange(0, 1) : QCPRange();
+}
+
+
+void SegmentGraph::draw(QCPPainter *painter) {
+    QCPAxis *keyAxis = mKeyAxis.data();
+    if (!keyAxis || !mValueAxis) {
+        qDebug() << Q_FUNC_INFO << "invalid key or value axis";
+        return;
+    }
+    size_t begin, end;
+    QCPRange range = keyAxis->range();
+    if (range.size() <= 0 || !overlapping(range.lower, range.upper, begin, end)) {
+        return;
+    }
+    int width = keyAxis->orientation() == Qt::Horizontal ? keyAxis->axisRect()->width() : keyAxis->axisRect()->height();
+    QVector<QRectF> boxes;
+    getBoxes(boxes, begin, end, range.lower, range.size() / std::max(1, width));
+
+    if (selected() && mSelectionDecorator) {
+        mSelectionDecorator->applyPen(painter);
+        mSelectionDecorator->applyBrush(painter);
+    } else {
+        painter->setPen(mPen);
+        painter->setBrush(mBrush);
+    }
+    applyDefaultAntialiasingHint(painter);
+    painter->drawRects(boxes);
+
+    if (mSelectionDecorator) {
+        mSelectionDecorator->drawDecoration(painter, selection());
+    }
+}
+
+
+void SegmentGraph::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const {
+    applyDefaultAntialiasingHint(painter);
+    painter->setPen(mPen);
+    painter->setBrush(mBrush);
+    painter->drawRect(rect.adjusted(0, rect.height() * 0.25, 0, -rect.height() * 0.25));
+}
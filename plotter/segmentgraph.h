@@ -0,0 +1,58 @@
+#ifndef SEGMENTGRAPH_H
+#define SEGMENTGRAPH_H
+
+#include <vector>
+#include "qcustomplot.h"
+
+
+/**
+ * @brief SegmentGraph: Segments given by position and extent, drawn as boxes over the values [0, 1].
+ * A segment takes the 16 bytes of its start and end plus 8 of the index: the segments are sorted by their start and
+ * store the running maximum of the ends, so the segments overlapping a key range are found by two binary searches.
+ * Segments less than a pixel apart are merged into one box while drawing, a box is at least a pixel wide.
+ */
+class SegmentGraph : public QCPAbstractPlottable
+{
+    Q_OBJECT
+
+public:
+    SegmentGraph(QCPAxis *keyAxis, QCPAxis *valueAxis);
+
+    /**
+     * @brief setData: replaces the segments. A segment without extent (extents shorter than positions) is a single point.
+     */
+    void setData(const QVector<double> &positions, const QVector<double> &extents);
+    void clearData();
+
+    size_t dataCount() const;
+
+    /**
+     * @brief overlapping: the range [begin, end) of the sorted segments that contains all segments overlapping [lower, upper].
+     * Segments in it may end before lower if a longer one before them reaches into the range.
+     * @return false if no segment overlaps.
+     */
+    bool overlapping(double lower, double upper, size_t &begin, size_t &end) const;
+
+    double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details=0) const override;
+    QCPRange getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth) const override;
+    QCPRange getValueRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth, const QCPRange &inKeyRange=QCPRange()) const override;
+
+protected:
+    void draw(QCPPainter *painter) override;
+    void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const override;
+
+private:
+    std::vector<double> starts;
+    std::vector<double> ends;
+    // maxEnds[i]: the largest end of the segments [0, i].
+    std::vector<double> maxEnds;
+
+    QRectF box(double start, double end) const;
+
+    /**
+     * @brief getBoxes: the boxes of the segments [begin, end) in pixels, merging segments that are less than gap apart.
+     */
+    void getBoxes(QVector<QRectF> &boxes, size_t begin, size_t end, double lower, double gap) const;
+};
+
+#endif // SEGMENTGRAPH_H
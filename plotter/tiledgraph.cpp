@@ -0,0 +1,127 @@
+#include "tiledgraph.h"
+#include "m4reduction.h"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+
+/**
+ * @brief TileSnapshot: the points of the graph around a tile and its style at the time the tile was requested.
+ * Dense lines are already reduced to the M4Reduction of the tile.
+ */
+class TiledGraph::TileSnapshot : public TileContent
+{
+public:
+    std::vector<double> keys;
+    std::vector<double> values;
+    bool reduced;
+    QCPGraph::LineStyle lineStyle;
+    QPen pen;
+    QCPScatterStyle scatter;
+    bool antialiased;
+    bool antialiasedScatters;
+
+    void render(QCPPainter *painter, const TileGeometry &geometry) const override {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        size_t count = keys.size();
+        QVector<QPointF> points;
+        points.reserve(static_cast<int>(count));
+        for (size_t i = 0; i < count; ++i) {
+            points.append(qIsNaN(values[i]) ? QPointF(nan, nan) : QPointF(geometry.keyToPixel(keys[i]), geometry.valueToPixel(values[i])));
+        }
+
+        painter->setPen(pen);
+        painter->setBrush(Qt::NoBrush);
+        painter->setAntialiasing(antialiased);
+        if (lineStyle == QCPGraph::lsLine) {
+            drawPolyline(painter, points);
+        } else if (lineStyle == QCPGraph::lsImpulse) {
+            double base = geometry.valueToPixel(0);
+            for (const QPointF &point : points) {
+                if (!qIsNaN(point.y())) {
+                    painter->drawLine(QLineF(point.x(), base, point.x(), point.y()));
+                }
+            }
+        }
+        if (!scatter.isNone() && !reduced) {
+            painter->setAntialiasing(antialiasedScatters);
+            scatter.applyTo(painter, pen);
+            for (const QPointF &point : points) {
+                if (!qIsNaN(point.x()) && !qIsNaN(point.y())) {
+                    scatter.drawShape(painter, point);
+                }
+            }
+        }
+    }
+};
+
+
+TiledGraph::TiledGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+    QCPGraph(keyAxis, valueAxis) {
+}
+
+
+void TiledGraph::setTileLayer(TileLayer *layer) {
+    tiles = layer;
+    if (layer) {
+        layer->addSource(this);
+    }
+}
+
+
+bool TiledGraph::tileable() const {
+    bool lines = mLineStyle == lsLine || mLineStyle == lsImpulse || mLineStyle == lsNone;
+    return lines && mBrush.style() == Qt::NoBrush && !mChannelFillGraph && mScatterSkip == 0;
+}
+
+
+TileContentPtr TiledGraph::tileContent(const TileGeometry &geometry) const {
+    TileSnapshot *snapshot = new TileSnapshot;
+    bool isSelected = selected() && mSelectionDecorator;
+    snapshot->lineStyle = mLineStyle;
+    snapshot->pen = isSelected ? mSelectionDecorator->pen() : mPen;
+    snapshot->scatter = isSelected ? mSelectionDecorator->getFinalScatterStyle(mScatterStyle) : mScatterStyle;
+    snapshot->antialiased = TileContent::antialiased(mParentPlot, mAntialiased, QCP::aePlottables);
+    snapshot->antialiasedScatters = TileContent::antialiased(mParentPlot, mAntialiasedScatters, QCP::aeScatters);
+
+    // one point beyond the tile on each side for the lines into it, scatters reach in from further away.
+    double margin = snapshot->scatter.isNone() ? 0 : snapshot->scatter.size() * geometry.keyPerPixel;
+    QCPGraphDataContainer::const_iterator begin = mDataContainer->findBegin(geometry.keyLower - margin);
+    QCPGraphDataContainer::const_iterator end = mDataContainer->findEnd(geometry.keyUpper() + margin);
+    size_t count = end - begin;
+    // dense lines are reduced right away, so the tile holds a few points per pixel column instead of a copy of all.
+    // scatters only are not reduced, the points between the extremes would be missing.
+    snapshot->reduced = mLineStyle != lsNone && count >= 2 * static_cast<size_t>(geometry.width) + 2;
+    if (snapshot->reduced) {
+        M4Key key = {geometry.keyLower, geometry.keyUpper(), geometry.width, 0};
+        M4Reduction reduction(key);
+        // the container stores the points as an array of QCPGraphData.
+        reduction.reduce(&begin->key, &begin->value, count, sizeof(QCPGraphData) / sizeof(double));
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        snapshot->keys.reserve(reduction.points().size());
+        snapshot->values.reserve(reduction.points().size());
+        for (const QPointF &point : reduction.points()) {
+            snapshot->keys.push_back(qIsNaN(point.y()) ? nan : point.x());
+            snapshot->values.push_back(point.y());
+        }
+        return TileContentPtr(snapshot);
+    }
+    snapshot->keys.reserve(count);
+    snapshot->values.reserve(count);
+    for (QCPGraphDataContainer::const_iterator it = begin; it != end; ++it) {
+        snapshot->keys.push_back(it->key);
+        snapshot->values.push_back(it->value);
+    }
+    return TileContentPtr(snapshot);
+}
+
+
+void TiledGraph::draw(QCPPainter *painter) {
+    if (tiles && tileable() && tiles->draws(painter)) {
+        if (mSelectionDecorator) {
+            mSelectionDecorator->drawDecoration(painter, selection());
+        }
+        return;
+    }
+    QCPGraph::draw(painter);
+}
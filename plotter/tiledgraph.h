@@ -0,0 +1,38 @@
+#ifndef TILEDGRAPH_H
+#define TILEDGRAPH_H
+
+#include "qcustomplot.h"
+#include "tilelayer.h"
+
+
+/**
+ * @brief TiledGraph: A QCPGraph that can be rendered into the tiles of a TileLayer. The tiles get a copy of the points
+ * they show, dense lines are reduced per pixel column like in SampledGraph while they are copied.
+ * Lines, impulses and scatters without fill are tiled, other styles are drawn by the QCPGraph.
+ * The data container is changed directly by the plotters, they have to invalidate the layer afterwards.
+ */
+class TiledGraph : public QCPGraph, public TileSource
+{
+    Q_OBJECT
+
+public:
+    TiledGraph(QCPAxis *keyAxis, QCPAxis *valueAxis);
+
+    /**
+     * @brief setTileLayer: adds the graph to the layer, which draws it from then on.
+     */
+    void setTileLayer(TileLayer *layer);
+
+    bool tileable() const override;
+    TileContentPtr tileContent(const TileGeometry &geometry) const override;
+
+protected:
+    void draw(QCPPainter *painter) override;
+
+private:
+    class TileSnapshot;
+
+    QPointer<TileLayer> tiles;
+};
+
+#endif // TILEDGRAPH_H
@@ -0,0 +1,407 @@
+#include "tilelayer.h"
+#include "replotscheduler.h"
+#include "../utils/loadscheduler.h"
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+
+double TileGeometry::keyUpper() const {
+    return keyLower + width * keyPerPixel;
+}
+
+
+double TileGeometry::keyToPixel(double key) const {
+    return (key - keyLower) / keyPerPixel;
+}
+
+
+double TileGeometry::valueToPixel(double value) const {
+    // the same mapping as QCPAxis::coordToPixel of a vertical axis, relative to the top of the axis rect.
+    if (valueReversed) {
+        return height - 1 - (valueRange.upper - value) / valueRange.size() * height;
+    }
+    return height - 1 - (value - valueRange.lower) / valueRange.size() * height;
+}
+
+
+TileContent::~TileContent() {}
+
+
+void TileContent::drawPolyline(QCPPainter *painter, const QVector<QPointF> &lines) {
+    int start = 0;
+    for (int i = 0; i <= lines.size(); ++i) {
+        if (i == lines.size() || qIsNaN(lines.at(i).x()) || qIsNaN(lines.at(i).y())) {
+            if (i - start > 1) {
+                painter->drawPolyline(lines.constData() + start, i - start);
+            } else if (i - start == 1) {
+                painter->drawPoint(lines.at(start));
+            }
+            start = i + 1;
+        }
+    }
+}
+
+
+bool TileContent::antialiased(const QCustomPlot *plot, bool local, QCP::AntialiasedElement element) {
+    if (plot->notAntialiasedElements().testFlag(element)) {
+        return false;
+    }
+    return local || plot->antialiasedElements().testFlag(element);
+}
+
+
+TileSource::~TileSource() {}
+
+
+static QPen drawn_pen(const QCPAbstractPlottable *plottable) {
+    if (plottable->selected() && plottable->selectionDecorator()) {
+        return plottable->selectionDecorator()->pen();
+    }
+    return plottable->pen();
+}
+
+
+/**
+ * @brief TileJob: renders the contents of one tile on a worker and hands the image to the layer.
+ */
+class TileLayer::TileJob : public LoadJob
+{
+public:
+    TileJob(TileLayer *layer, const void *lane, quint64 request, const TileGeometry &geometry, const QList<TileContentPtr> &contents) :
+        LoadJob(lane, LoadPriority::Visible), layer(layer), request(request), geometry(geometry), contents(contents) {
+    }
+
+    bool step() override {
+        if (isCancelled()) {
+            return false;
+        }
+        QImage image(qRound(geometry.width * geometry.pixelRatio), qRound(geometry.height * geometry.pixelRatio),
+                     QImage::Format_ARGB32_Premultiplied);
+        image.setDevicePixelRatio(geometry.pixelRatio);
+        image.fill(Qt::transparent);
+        QCPPainter painter(&image);
+        for (const TileContentPtr &content : contents) {
+            content->render(&painter, geometry);
+        }
+        painter.end();
+        // the layer waits for its running job when it is destroyed, so it is still alive here.
+        QMetaObject::invokeMethod(layer, "tileReady", Qt::QueuedConnection, Q_ARG(quint64, request), Q_ARG(QImage, image));
+        return false;
+    }
+
+private:
+    TileLayer *layer;
+    quint64 request;
+    TileGeometry geometry;
+    QList<TileContentPtr> contents;
+};
+
+
+bool TileLayer::Grid::operator==(const Grid &other) const {
+    // moving a range by an offset may change its size in the last bits, that is no zoom.
+    return qFuzzyCompare(keyPerPixel, other.keyPerPixel) && qFuzzyCompare(valuePerPixel, other.valuePerPixel) &&
+            valueReversed == other.valueReversed && pixelRatio == other.pixelRatio;
+}
+
+
+bool TileLayer::Grid::operator!=(const Grid &other) const {
+    return !(*this == other);
+}
+
+
+TileLayer::TileLayer(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+    QCPLayerable(keyAxis->parentPlot(), QString(), keyAxis->axisRect()), keyAxis(keyAxis), valueAxis(valueAxis),
+    hasGrid(false), nextRequest(0) {
+    lanes.assign(static_cast<size_t>(std::max(1, LoadScheduler::instance().workerCount())), 0);
+}
+
+
+TileLayer::~TileLayer() {
+    cancelJobs(true);
+}
+
+
+void TileLayer::cancelJobs(bool wait) {
+    LoadScheduler &scheduler = LoadScheduler::instance();
+    for (size_t l = 0; l < lanes.size(); l++) {
+        scheduler.cancel(&lanes[l], wait);
+    }
+}
+
+
+void TileLayer::addSource(QCPAbstractPlottable *plottable) {
+    TileSource *source = dynamic_cast<TileSource*>(plottable);
+    if (!source) {
+        std::cerr << "TileLayer::addSource: the plottable is no TileSource." << std::endl;
+        return;
+    }
+    Source entry;
+    entry.plottable = plottable;
+    entry.source = source;
+    entry.visible = plottable->realVisibility();
+    entry.selected = plottable->selected();
+    entry.pen = drawn_pen(plottable);
+    entry.tileable = source->tileable();
+    sources.append(entry);
+    invalidate();
+}
+
+
+void TileLayer::invalidate(double lower, double upper) {
+    if (!hasGrid) {
+        return;
+    }
+    double tileKeys = TILE_WIDTH * grid.keyPerPixel;
+    for (QHash<TileIndex, Tile>::iterator it = tiles.begin(); it != tiles.end(); ++it) {
+        if (it.key().first * tileKeys <= upper && (it.key().first + 1) * tileKeys >= lower) {
+            it.value().stale = true;
+        }
+    }
+    // renderings that started before the change are dropped when they arrive.
+    for (QHash<quint64, TileIndex>::iterator it = pending.begin(); it != pending.end();) {
+        if (it.value().first * tileKeys <= upper && (it.value().first + 1) * tileKeys >= lower) {
+            it = pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+
+void TileLayer::invalidate() {
+    invalidate(-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity());
+    cancelJobs();
+}
+
+
+bool TileLayer::draws(const QCPPainter *painter) const {
+    if (!keyAxis || !valueAxis || painter->modes().testFlag(QCPPainter::pmVectorized) || painter->modes().testFlag(QCPPainter::pmNoCaching)) {
+        return false;
+    }
+    return keyAxis->orientation() == Qt::Horizontal && keyAxis->scaleType() == QCPAxis::stLinear && !keyAxis->rangeReversed() &&
+            valueAxis->orientation() == Qt::Vertical && valueAxis->scaleType() == QCPAxis::stLinear;
+}
+
+
+void TileLayer::applyDefaultAntialiasingHint(QCPPainter *painter) const {
+    // the tiles are images, antialiasing is applied while they are rendered.
+    painter->setAntialiasing(false);
+}
+
+
+QRect TileLayer::clipRect() const {
+    if (keyAxis) {
+        return keyAxis->axisRect()->rect();
+    }
+    return QRect();
+}
+
+
+bool TileLayer::currentGrid(Grid &current) const {
+    QRect rect = keyAxis->axisRect()->rect();
+    if (rect.width() <= 0 || rect.height() <= 0) {
+        return false;
+    }
+    current.keyPerPixel = keyAxis->range().size() / rect.width();
+    current.valuePerPixel = valueAxis->range().size() / rect.height();
+    current.valueReversed = valueAxis->rangeReversed();
+    current.pixelRatio = mParentPlot->bufferDevicePixelRatio();
+    return current.keyPerPixel > 0 && current.valuePerPixel > 0;
+}
+
+
+void TileLayer::setGrid(const Grid &current) {
+    // the tiles being rendered do not fit any more.
+    cancelJobs();
+    pending.clear();
+    if (!tiles.isEmpty()) {
+        previousGrid = grid;
+        previousTiles = tiles;
+    }
+    tiles.clear();
+    grid = current;
+    hasGrid = true;
+}
+
+
+bool TileLayer::stylesChanged() {
+    bool changed = false;
+    for (int i = sources.size() - 1; i >= 0; --i) {
+        Source &entry = sources[i];
+        QCPAbstractPlottable *plottable = entry.plottable.data();
+        if (!plottable) {
+            sources.removeAt(i);
+            changed = true;
+            continue;
+        }
+        bool visible = plottable->realVisibility();
+        bool selected = plottable->selected();
+        QPen pen = drawn_pen(plottable);
+        bool tileable = entry.source->tileable();
+        if (visible != entry.visible || selected != entry.selected || pen != entry.pen || tileable != entry.tileable) {
+            entry.visible = visible;
+            entry.selected = selected;
+            entry.pen = pen;
+            entry.tileable = tileable;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+
+TileGeometry TileLayer::geometry(const Grid &tileGrid, const TileIndex &index) const {
+    TileGeometry tile;
+    tile.keyLower = index.first * TILE_WIDTH * tileGrid.keyPerPixel;
+    tile.keyPerPixel = tileGrid.keyPerPixel;
+    // absolute value pixels grow upwards, on a reversed axis they run against the values.
+    double lower = index.second * TILE_HEIGHT * tileGrid.valuePerPixel;
+    double upper = (index.second + 1) * TILE_HEIGHT * tileGrid.valuePerPixel;
+    tile.valueRange = tileGrid.valueReversed ? QCPRange(-upper, -lower) : QCPRange(lower, upper);
+    tile.valueReversed = tileGrid.valueReversed;
+    tile.width = TILE_WIDTH;
+    tile.height = TILE_HEIGHT;
+    tile.pixelRatio = tileGrid.pixelRatio;
+    return tile;
+}
+
+
+double TileLayer::valueOrigin(const Grid &tileGrid) const {
+    QCPRange range = valueAxis->range();
+    return (tileGrid.valueReversed ? -range.lower : range.upper) / tileGrid.valuePerPixel;
+}
+
+
+bool TileLayer::isPending(const TileIndex &index) const {
+    for (QHash<quint64, TileIndex>::const_iterator it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        if (it.value() == index) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void TileLayer::request(const TileIndex &index) {
+    if (isPending(index)) {
+        return;
+    }
+    TileGeometry tile = geometry(grid, index);
+    QList<TileContentPtr> contents;
+    for (const Source &entry : sources) {
+        if (entry.plottable && entry.visible && entry.tileable) {
+            contents.append(entry.source->tileContent(tile));
+        }
+    }
+    quint64 id = nextRequest++;
+    pending.insert(id, index);
+    LoadScheduler::instance().submit(QSharedPointer<LoadJob>(new TileJob(this, &lanes[id % lanes.size()], id, tile, contents)));
+}
+
+
+void TileLayer::tileReady(quint64 request, const QImage &image) {
+    QHash<quint64, TileIndex>::iterator it = pending.find(request);
+    if (it == pending.end()) {
+        return;
+    }
+    Tile tile = {image, false};
+    tiles.insert(it.value(), tile);
+    pending.erase(it);
+    if (mParentPlot) {
+        ReplotScheduler::instance().request(mParentPlot);
+    }
+}
+
+
+void TileLayer::draw(QCPPainter *painter) {
+    Grid current;
+    if (!draws(painter) || !currentGrid(current)) {
+        return;
+    }
+    if (!hasGrid || current != grid) {
+        setGrid(current);
+    }
+    if (stylesChanged()) {
+        invalidate();
+    }
+
+    QRect rect = keyAxis->axisRect()->rect();
+    // the absolute key pixel at the left border of the axis rect, tile column c starts at absolute pixel c * TILE_WIDTH.
+    double origin = keyAxis->range().lower / grid.keyPerPixel;
+    qint64 shift = qRound64(origin);
+    qint64 first = static_cast<qint64>(std::floor(origin / TILE_WIDTH));
+    qint64 last = static_cast<qint64>(std::floor((origin + rect.width()) / TILE_WIDTH));
+    // the same for the rows from the top border down, row r ends at absolute value pixel (r + 1) * TILE_HEIGHT.
+    double valueTop = valueOrigin(grid);
+    qint64 valueShift = qRound64(valueTop);
+    qint64 top = static_cast<qint64>(std::floor(valueTop / TILE_HEIGHT));
+    qint64 bottom = static_cast<qint64>(std::floor((valueTop - rect.height()) / TILE_HEIGHT));
+
+    for (qint64 row = top; row >= bottom; --row) {
+        for (qint64 column = first; column <= last; ++column) {
+            TileIndex index(column, row);
+            QPoint corner(rect.left() + static_cast<int>(column * TILE_WIDTH - shift),
+                          rect.top() + static_cast<int>(valueShift - (row + 1) * TILE_HEIGHT));
+            QHash<TileIndex, Tile>::const_iterator it = tiles.constFind(index);
+            if (it == tiles.constEnd() || it->stale) {
+                request(index);
+            }
+            if (it != tiles.constEnd()) {
+                painter->drawImage(corner, it->image);
+            } else {
+                drawPreview(painter, QRectF(corner, QSizeF(TILE_WIDTH, TILE_HEIGHT)));
+            }
+        }
+        // the neighbours are exposed next while panning.
+        if (!tiles.contains(TileIndex(first - 1, row))) {
+            request(TileIndex(first - 1, row));
+        }
+        if (!tiles.contains(TileIndex(last + 1, row))) {
+            request(TileIndex(last + 1, row));
+        }
+    }
+    evict(TileIndex(first, bottom), TileIndex(last, top));
+}
+
+
+void TileLayer::drawPreview(QCPPainter *painter, const QRectF &area) const {
+    if (previousTiles.isEmpty()) {
+        return;
+    }
+    painter->save();
+    painter->setClipRect(area, Qt::IntersectClip);
+    for (QHash<TileIndex, Tile>::const_iterator it = previousTiles.constBegin(); it != previousTiles.constEnd(); ++it) {
+        TileGeometry tile = geometry(previousGrid, it.key());
+        double top = tile.valueReversed ? tile.valueRange.lower : tile.valueRange.upper;
+        double bottom = tile.valueReversed ? tile.valueRange.upper : tile.valueRange.lower;
+        // valueToPixel() puts the top value one pixel above the first row.
+        QRectF target(QPointF(keyAxis->coordToPixel(tile.keyLower), valueAxis->coordToPixel(top) + 1),
+                      QPointF(keyAxis->coordToPixel(tile.keyUpper()), valueAxis->coordToPixel(bottom) + 1));
+        target = target.normalized();
+        if (target.intersects(area)) {
+            painter->drawImage(target, it->image);
+        }
+    }
+    painter->restore();
+}
+
+
+void TileLayer::evict(const TileIndex &firstVisible, const TileIndex &lastVisible) {
+    int keep = static_cast<int>((lastVisible.first - firstVisible.first + 1) * (lastVisible.second - firstVisible.second + 1)) +
+            TILE_CACHE_COUNT;
+    while (tiles.size() > keep) {
+        QHash<TileIndex, Tile>::iterator farthest = tiles.begin();
+        qint64 maxDistance = -1;
+        for (QHash<TileIndex, Tile>::iterator it = tiles.begin(); it != tiles.end(); ++it) {
+            qint64 column = it.key().first < firstVisible.first ? firstVisible.first - it.key().first : it.key().first - lastVisible.first;
+            qint64 row = it.key().second < firstVisible.second ? firstVisible.second - it.key().second : it.key().second - lastVisible.second;
+            qint64 distance = std::max(column, row);
+            if (distance > maxDistance) {
+                maxDistance = distance;
+                farthest = it;
+            }
+        }
+        tiles.erase(farthest);
+    }
+}
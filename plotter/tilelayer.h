@@ -0,0 +1,194 @@
+#ifndef TILELAYER_H
+#define TILELAYER_H
+
+#include <QHash>
+#include <QList>
+#include <QImage>
+#include <QPair>
+#include <QPointer>
+#include <QSharedPointer>
+#include <vector>
+#include "qcustomplot.h"
+
+
+/**
+ * @brief TileGeometry: the pixel grid of one tile. Keys map to columns from left to right, values like on the value axis.
+ */
+struct TileGeometry
+{
+    double keyLower;
+    double keyPerPixel;
+    QCPRange valueRange;
+    bool valueReversed;
+    int width;
+    int height;
+    // device pixels per pixel of the plot.
+    double pixelRatio;
+
+    double keyUpper() const;
+    double keyToPixel(double key) const;
+    double valueToPixel(double value) const;
+};
+
+
+/**
+ * @brief TileContent: What a plottable shows of a key range, captured on the gui thread. It must not refer to the plottable
+ * or the plot, render() is called on a worker of the LoadScheduler.
+ */
+class TileContent
+{
+public:
+    virtual ~TileContent();
+
+    virtual void render(QCPPainter *painter, const TileGeometry &geometry) const = 0;
+
+    /**
+     * @brief drawPolyline: draws the lines in parts, NaN points interrupt them. Single points between two NaN are drawn as points.
+     */
+    static void drawPolyline(QCPPainter *painter, const QVector<QPointF> &lines);
+
+    /**
+     * @brief antialiased: whether an element is antialiased, the overrides of the plot applied to the setting of the layerable.
+     */
+    static bool antialiased(const QCustomPlot *plot, bool local, QCP::AntialiasedElement element);
+};
+
+typedef QSharedPointer<const TileContent> TileContentPtr;
+
+
+/**
+ * @brief TileSource: A plottable that can be rasterized into the tiles of a TileLayer.
+ * While it is tiled (see TileLayer::draws()) its own draw() only has to draw what is not part of the tiles.
+ */
+class TileSource
+{
+public:
+    virtual ~TileSource();
+
+    /**
+     * @brief tileable: whether the current style can be rendered into tiles. If not, the plottable draws itself.
+     */
+    virtual bool tileable() const = 0;
+
+    /**
+     * @brief tileContent: the content of the tile, including what reaches into it from outside
+     * (e.g. the line to the next sample or a scatter next to the border).
+     */
+    virtual TileContentPtr tileContent(const TileGeometry &geometry) const = 0;
+};
+
+
+/**
+ * @brief TileLayer: Draws the TileSource plottables of an axis rect as QImage tiles, which are rendered on the workers of the LoadScheduler.
+ * The tiles lie on a grid of TILE_WIDTH x TILE_HEIGHT pixels in absolute key and value pixels, so panning and scrolling
+ * the value axis reuse the rendered tiles and only the newly exposed ones are rendered. The grid depends on the zoom
+ * (key and value per pixel), after a change the tiles of the previous grid are stretched into place until the new ones arrive.
+ * The tiles are rendered in parallel, on one lane of the scheduler per worker.
+ * The gui thread only composites the tiles, axes and overlays are drawn as usual.
+ * Vertical or logarithmic key axes and exports are drawn directly by the plottables.
+ */
+class TileLayer : public QCPLayerable
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief TileLayer: is added to the current layer of the plot, the sources should be on the same layer.
+     */
+    TileLayer(QCPAxis *keyAxis, QCPAxis *valueAxis);
+    ~TileLayer();
+
+    /**
+     * @brief addSource: adds a plottable that implements TileSource. The sources are drawn in the order they were added.
+     */
+    void addSource(QCPAbstractPlottable *plottable);
+
+    /**
+     * @brief invalidate: the content of all sources in [lower, upper] changed. The tiles there are rendered again,
+     * until then the old ones are shown.
+     */
+    void invalidate(double lower, double upper);
+    void invalidate();
+
+    /**
+     * @brief draws: whether the layer draws the sources with the painter, so they do not have to draw themselves.
+     */
+    bool draws(const QCPPainter *painter) const;
+
+protected:
+    void applyDefaultAntialiasingHint(QCPPainter *painter) const override;
+    void draw(QCPPainter *painter) override;
+    QRect clipRect() const override;
+
+private slots:
+    void tileReady(quint64 request, const QImage &image);
+
+private:
+    class TileJob;
+
+    struct Grid {
+        double keyPerPixel;
+        double valuePerPixel;
+        bool valueReversed;
+        double pixelRatio;
+
+        bool operator==(const Grid &other) const;
+        bool operator!=(const Grid &other) const;
+    };
+
+    // column and row of a tile, tile (c, r) starts at absolute key pixel c * TILE_WIDTH and absolute value pixel r * TILE_HEIGHT.
+    typedef QPair<qint64, qint64> TileIndex;
+
+    struct Tile {
+        QImage image;
+        // rendered before the content changed, shown until the new one arrives.
+        bool stale;
+    };
+
+    struct Source {
+        QPointer<QCPAbstractPlottable> plottable;
+        TileSource *source;
+        // the style the tiles were rendered with.
+        QPen pen;
+        bool visible;
+        bool selected;
+        bool tileable;
+    };
+
+    static const int TILE_WIDTH = 256;
+    static const int TILE_HEIGHT = 256;
+    // tiles of the current grid kept beyond the visible ones.
+    static const int TILE_CACHE_COUNT = 24;
+
+    QPointer<QCPAxis> keyAxis;
+    QPointer<QCPAxis> valueAxis;
+    QList<Source> sources;
+
+    Grid grid;
+    bool hasGrid;
+    QHash<TileIndex, Tile> tiles;
+    // request id -> the tiles being rendered.
+    QHash<quint64, TileIndex> pending;
+    quint64 nextRequest;
+    // the owners of the tile jobs on the scheduler, one per worker so the tiles render in parallel.
+    std::vector<char> lanes;
+
+    Grid previousGrid;
+    QHash<TileIndex, Tile> previousTiles;
+
+    bool currentGrid(Grid &current) const;
+    void setGrid(const Grid &current);
+    void cancelJobs(bool wait = false);
+    bool stylesChanged();
+    TileGeometry geometry(const Grid &tileGrid, const TileIndex &index) const;
+    /**
+     * @brief valueOrigin: the absolute value pixel at the top of the axis rect, absolute value pixels grow upwards.
+     */
+    double valueOrigin(const Grid &tileGrid) const;
+    bool isPending(const TileIndex &index) const;
+    void request(const TileIndex &index);
+    void drawPreview(QCPPainter *painter, const QRectF &area) const;
+    void evict(const TileIndex &firstVisible, const TileIndex &lastVisible);
+};
+
+#endif // TILELAYER_H
@@ -0,0 +1,225 @@
+#include "blockcache.h"
+#include "dataconvert.h"
+#include "storagelayout.h"
+#include "common/Common.hpp"
+#include <QSettings>
+#include <algorithm>
+#include <limits>
+
+// the size a block grows to from the storage chunks, in bytes.
+static const size_t BLOCK_CACHE_BLOCK = 1024 * 1024;
+// a read whose blocks hold more than this many times its values bypasses the cache.
+static const size_t BLOCK_CACHE_OVERREAD = 4;
+
+QMutex BlockCache::mutex;
+QWaitCondition BlockCache::loaded;
+std::string BlockCache::filePath;
+QHash<QString, BlockCache::Layout> BlockCache::layouts;
+QHash<QString, BlockCache::Entry> BlockCache::entries;
+size_t BlockCache::usage = 0;
+size_t BlockCache::budget = 0;
+unsigned long long BlockCache::useCounter = 0;
+quint64 BlockCache::generation = 0;
+
+
+void BlockCache::setFile(const std::string &path) {
+    QSettings settings;
+    settings.beginGroup(LOADER_GROUP);
+    qint64 megabytes = settings.value(LOADER_BLOCK_CACHE_SIZE, 256).toLongLong();
+    settings.endGroup();
+
+    QMutexLocker locker(&mutex);
+    filePath = path;
+    budget = static_cast<size_t>(std::max(megabytes, static_cast<qint64>(0))) * 1024 * 1024;
+    layouts.clear();
+    // blocks still being read are handed only to their reader, they see the generation changed.
+    entries.clear();
+    usage = 0;
+    generation++;
+}
+
+
+size_t BlockCache::memoryUsage() {
+    QMutexLocker locker(&mutex);
+    return usage;
+}
+
+
+BlockCache::Layout BlockCache::layout(const nix::DataArray &array, const QString &arrayKey) {
+    {
+        QMutexLocker locker(&mutex);
+        QHash<QString, Layout>::const_iterator it = layouts.constFind(arrayKey);
+        if (it != layouts.constEnd()) {
+            return *it;
+        }
+    }
+
+    Layout grid;
+    grid.shape = array.dataExtent();
+    size_t rank = grid.shape.size();
+    StorageLayout storage = StorageLayout::of(array);
+    grid.blockExtent = nix::NDSize(rank, 1);
+    for (size_t d = 0; d < rank; d++) {
+        if (storage.isChunked()) {
+            grid.blockExtent[d] = std::max<nix::ndsize_t>(1, std::min<nix::ndsize_t>(grid.shape[d], storage.chunkExtent(d)));
+        }
+    }
+    // all dimensions grow in turn, so a block of a wide array does not span all of its channels.
+    // Doubling keeps the blocks multiples of the storage chunks.
+    size_t target = BLOCK_CACHE_BLOCK / sizeof(double);
+    for (bool grown = true; grown;) {
+        grown = false;
+        for (size_t d = rank; d-- > 0;) {
+            if (grid.blockExtent[d] < grid.shape[d] && 2 * grid.blockExtent.nelms() <= target) {
+                grid.blockExtent[d] = std::min(grid.shape[d], 2 * grid.blockExtent[d]);
+                grown = true;
+            }
+        }
+    }
+    grid.gridExtent = nix::NDSize(rank, 0);
+    for (size_t d = 0; d < rank; d++) {
+        grid.gridExtent[d] = (grid.shape[d] + grid.blockExtent[d] - 1) / grid.blockExtent[d];
+    }
+
+    QMutexLocker locker(&mutex);
+    layouts.insert(arrayKey, grid);
+    return grid;
+}
+
+
+BlockCache::BlockPtr BlockCache::get(const nix::DataArray &array, const QString &arrayKey, const Layout &grid, quint64 index) {
+    QString key = arrayKey + "/" + QString::number(index);
+    QMutexLocker locker(&mutex);
+    for (;;) {
+        QHash<QString, Entry>::iterator it = entries.find(key);
+        if (it == entries.end()) {
+            break;
+        }
+        if (!it->loading) {
+            it->lastUse = ++useCounter;
+            return it->block;
+        }
+        // read by another thread, which wakes all waiting ones when it is done.
+        loaded.wait(&mutex);
+    }
+    Entry pending;
+    pending.loading = true;
+    pending.lastUse = ++useCounter;
+    entries.insert(key, pending);
+    quint64 readGeneration = generation;
+    locker.unlock();
+
+    size_t rank = grid.shape.size();
+    QSharedPointer<Block> block(new Block);
+    block->start = nix::NDSize(rank, 0);
+    block->extent = nix::NDSize(rank, 0);
+    quint64 rest = index;
+    for (size_t d = rank; d-- > 0;) {
+        block->start[d] = (rest % grid.gridExtent[d]) * grid.blockExtent[d];
+        block->extent[d] = std::min(grid.blockExtent[d], grid.shape[d] - block->start[d]);
+        rest /= grid.gridExtent[d];
+    }
+    std::vector<char> scratch;
+    try {
+        block->values.resize(block->extent.nelms());
+        nixview::util::read_as_double(array, block->values.data(), block->extent, block->start, scratch);
+    } catch (...) {
+        locker.relock();
+        if (generation == readGeneration) {
+            entries.remove(key);
+        }
+        loaded.wakeAll();
+        throw;
+    }
+
+    locker.relock();
+    // after setFile() the entry of this key, if any, belongs to a later read, the block is only handed to this reader.
+    QHash<QString, Entry>::iterator it = generation == readGeneration ? entries.find(key) : entries.end();
+    if (it != entries.end()) {
+        it->block = block;
+        it->loading = false;
+        usage += block->values.size() * sizeof(double);
+        evict(key);
+    }
+    loaded.wakeAll();
+    return block;
+}
+
+
+void BlockCache::evict(const QString &keep) {
+    while (usage > budget) {
+        QHash<QString, Entry>::iterator oldest = entries.end();
+        for (QHash<QString, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+            if (!it->loading && it.key() != keep && (oldest == entries.end() || it->lastUse < oldest->lastUse)) {
+                oldest = it;
+            }
+        }
+        if (oldest == entries.end()) {
+            return;
+        }
+        usage -= oldest->block->values.size() * sizeof(double);
+        entries.erase(oldest);
+    }
+}
+
+
+BlockCache::BlockPtr BlockCache::block(const nix::DataArray &array, quint64 index) {
+    QString arrayKey;
+    {
+        QMutexLocker locker(&mutex);
+        arrayKey = QString::fromStdString(filePath + "/" + array.id());
+    }
+    Layout grid = layout(array, arrayKey);
+    return get(array, arrayKey, grid, index);
+}
+
+
+void BlockCache::read(const nix::DataArray &array, double *dst, const nix::NDSize &count, const nix::NDSize &offset) {
+    size_t rank = count.size();
+    if (rank == 0 || count.nelms() == 0) {
+        return;
+    }
+    QString arrayKey;
+    {
+        QMutexLocker locker(&mutex);
+        arrayKey = QString::fromStdString(filePath + "/" + array.id());
+    }
+    Layout grid = layout(array, arrayKey);
+    if (grid.shape.size() != rank) {
+        std::cerr << "BlockCache::read(): rank of the request does not match the array " << array.name() << std::endl;
+        std::fill(dst, dst + count.nelms(), std::numeric_limits<double>::quiet_NaN());
+        return;
+    }
+
+    // the blocks overlapping the request, walked in row major order.
+    nix::NDSize firstBlock(rank, 0), lastBlock(rank, 0), blockPos(rank, 0);
+    size_t covered = 1;
+    for (size_t d = 0; d < rank; d++) {
+        firstBlock[d] = offset[d] / grid.blockExtent[d];
+        lastBlock[d] = (offset[d] + count[d] - 1) / grid.blockExtent[d];
+        blockPos[d] = firstBlock[d];
+        covered *= std::min(grid.shape[d], (lastBlock[d] + 1) * grid.blockExtent[d]) - firstBlock[d] * grid.blockExtent[d];
+    }
+    // e.g. one channel of a wide array: its blocks would mostly hold the neighbouring channels and push out the cache.
+    if (covered > BLOCK_CACHE_BLOCK / sizeof(double) && covered > BLOCK_CACHE_OVERREAD * count.nelms()) {
+        std::vector<char> scratch;
+        nixview::util::read_as_double(array, dst, count, offset, scratch);
+        return;
+    }
+    for (;;) {
+        quint64 index = 0;
+        for (size_t d = 0; d < rank; d++) {
+            index = index * grid.gridExtent[d] + blockPos[d];
+        }
+        BlockPtr b = get(array, arrayKey, grid, index);
+        nixview::util::copy_box(b->values.data(), b->start, b->extent, dst, offset, count);
+
+        size_t d = rank;
+        while (d-- > 0 && ++blockPos[d] > lastBlock[d]) {
+            blockPos[d] = firstBlock[d];
+        }
+        if (d == static_cast<size_t>(-1)) {
+            break;
+        }
+    }
+}
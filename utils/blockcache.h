@@ -0,0 +1,83 @@
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <QString>
+#include <QSharedPointer>
+#include <vector>
+#include <nix.hpp>
+
+
+/**
+ * @brief BlockCache: The blocks of DataArrays that were read, shared by all plots, tables and dialogs of the process.
+ * An array is divided into a grid of blocks of about BLOCK_CACHE_BLOCK bytes that are multiples of its storage chunks,
+ * grown along all dimensions in turn. A read whose blocks would hold much more than it asks for (e.g. one channel of a
+ * wide array) is read directly and not cached.
+ * Blocks are read with read_as_double() and kept as immutable, reference counted doubles, keyed by (file, array id, block index).
+ * A block requested while another thread reads it is waited for instead of being read twice.
+ * When the resident blocks exceed the budget (settings: LOADER_GROUP/LOADER_BLOCK_CACHE_SIZE in MB) the least recently used
+ * ones are dropped, readers still holding them keep them alive until they are done.
+ */
+class BlockCache
+{
+public:
+    struct Block {
+        nix::NDSize start;
+        nix::NDSize extent;
+        // row major over extent.
+        std::vector<double> values;
+    };
+    typedef QSharedPointer<const Block> BlockPtr;
+
+    /**
+     * @brief setFile: sets the path of the currently opened nix file and drops all blocks.
+     */
+    static void setFile(const std::string &path);
+
+    /**
+     * @brief read: copies the values of [offset, offset + count) into dst (row major over count), like read_as_double().
+     * The blocks covering the range are read on first use. Exceptions of nix are passed on.
+     * If the rank of count does not match the array, dst is filled with NaN.
+     */
+    static void read(const nix::DataArray &array, double *dst, const nix::NDSize &count, const nix::NDSize &offset);
+
+    /**
+     * @brief block: the block with the given index in the array's grid of blocks, read on first use.
+     */
+    static BlockPtr block(const nix::DataArray &array, quint64 index);
+
+    static size_t memoryUsage();
+
+private:
+    // the grid of blocks of one array.
+    struct Layout {
+        nix::NDSize shape;
+        nix::NDSize blockExtent;
+        nix::NDSize gridExtent;
+    };
+
+    struct Entry {
+        BlockPtr block;
+        bool loading;
+        unsigned long long lastUse;
+    };
+
+    static QMutex mutex;
+    static QWaitCondition loaded;
+    static std::string filePath;
+    static QHash<QString, Layout> layouts;
+    static QHash<QString, Entry> entries;
+    static size_t usage;
+    static size_t budget;
+    static unsigned long long useCounter;
+    // counts the calls of setFile(), reads that started before the last one do not touch the entries.
+    static quint64 generation;
+
+    static Layout layout(const nix::DataArray &array, const QString &arrayKey);
+    static BlockPtr get(const nix::DataArray &array, const QString &arrayKey, const Layout &grid, quint64 index);
+    static void evict(const QString &keep);
+};
+
+#endif // BLOCKCACHE_H
@@ -0,0 +1,280 @@
+#include "dataconvert.h"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NIXVIEW_SSE2
+#endif
+
+namespace nixview {
+namespace util {
+
+template<typename T>
+static void convert_loop(const T *src, double *dst, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] = static_cast<double>(src[i]);
+    }
+}
+
+
+#ifdef NIXVIEW_SSE2
+
+static inline void store_epi32(double *dst, __m128i v) {
+    _mm_storeu_pd(dst, _mm_cvtepi32_pd(v));
+    _mm_storeu_pd(dst + 2, _mm_cvtepi32_pd(_mm_srli_si128(v, 8)));
+}
+
+
+// 8 16 bit values are widened to two times 4 32 bit values, sign extended by an arithmetic shift or zero extended.
+template<bool is_signed>
+static inline void store_epi16(double *dst, __m128i v) {
+    __m128i lo, hi;
+    if (is_signed) {
+        lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    } else {
+        lo = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+        hi = _mm_unpackhi_epi16(v, _mm_setzero_si128());
+    }
+    store_epi32(dst, lo);
+    store_epi32(dst + 4, hi);
+}
+
+
+template<bool is_signed>
+static void convert_16(const void *src, double *dst, size_t count) {
+    const char *in = static_cast<const char*>(src);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        store_epi16<is_signed>(dst + i, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i)));
+    }
+    if (is_signed) {
+        convert_loop(reinterpret_cast<const int16_t*>(in) + i, dst + i, count - i);
+    } else {
+        convert_loop(reinterpret_cast<const uint16_t*>(in) + i, dst + i, count - i);
+    }
+}
+
+
+template<bool is_signed>
+static void convert_8(const void *src, double *dst, size_t count) {
+    const char *in = static_cast<const char*>(src);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i));
+        if (is_signed) {
+            v = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+        } else {
+            v = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+        }
+        store_epi16<true>(dst + i, v);
+    }
+    if (is_signed) {
+        convert_loop(reinterpret_cast<const int8_t*>(in) + i, dst + i, count - i);
+    } else {
+        convert_loop(reinterpret_cast<const uint8_t*>(in) + i, dst + i, count - i);
+    }
+}
+
+
+static void convert_int32(const void *src, double *dst, size_t count) {
+    const char *in = static_cast<const char*>(src);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        store_epi32(dst + i, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * i)));
+    }
+    convert_loop(reinterpret_cast<const int32_t*>(in) + i, dst + i, count - i);
+}
+
+
+static void convert_float(const void *src, double *dst, size_t count) {
+    const float *in = static_cast<const float*>(src);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_loadu_ps(in + i);
+        _mm_storeu_pd(dst + i, _mm_cvtps_pd(v));
+        _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+    }
+    convert_loop(in + i, dst + i, count - i);
+}
+
+#else
+
+template<bool is_signed>
+static void convert_16(const void *src, double *dst, size_t count) {
+    if (is_signed) {
+        convert_loop(static_cast<const int16_t*>(src), dst, count);
+    } else {
+        convert_loop(static_cast<const uint16_t*>(src), dst, count);
+    }
+}
+
+
+template<bool is_signed>
+static void convert_8(const void *src, double *dst, size_t count) {
+    if (is_signed) {
+        convert_loop(static_cast<const int8_t*>(src), dst, count);
+    } else {
+        convert_loop(static_cast<const uint8_t*>(src), dst, count);
+    }
+}
+
+
+static void convert_int32(const void *src, double *dst, size_t count) {
+    convert_loop(static_cast<const int32_t*>(src), dst, count);
+}
+
+
+static void convert_float(const void *src, double *dst, size_t count) {
+    convert_loop(static_cast<const float*>(src), dst, count);
+}
+
+#endif
+
+
+size_t native_type_size(nix::DataType type) {
+    switch (type) {
+    case nix::DataType::Int8:
+    case nix::DataType::UInt8:
+        return 1;
+    case nix::DataType::Int16:
+    case nix::DataType::UInt16:
+        return 2;
+    case nix::DataType::Int32:
+    case nix::DataType::UInt32:
+    case nix::DataType::Float:
+        return 4;
+    case nix::DataType::Int64:
+    case nix::DataType::UInt64:
+    case nix::DataType::Double:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+
+bool reads_native(const nix::DataArray &array) {
+    return native_type_size(array.dataType()) > 0 && array.polynomCoefficients().empty() && !array.expansionOrigin();
+}
+
+
+bool exact_in_float(const nix::DataArray &array) {
+    nix::DataType type = array.dataType();
+    // at most 24 significant bits.
+    bool fits = native_type_size(type) <= 2 || type == nix::DataType::Float;
+    return fits && reads_native(array);
+}
+
+
+void to_double(nix::DataType type, const void *src, double *dst, size_t count) {
+    switch (type) {
+    case nix::DataType::Int8:
+        convert_8<true>(src, dst, count);
+        break;
+    case nix::DataType::UInt8:
+        convert_8<false>(src, dst, count);
+        break;
+    case nix::DataType::Int16:
+        convert_16<true>(src, dst, count);
+        break;
+    case nix::DataType::UInt16:
+        convert_16<false>(src, dst, count);
+        break;
+    case nix::DataType::Int32:
+        convert_int32(src, dst, count);
+        break;
+    case nix::DataType::UInt32:
+        convert_loop(static_cast<const uint32_t*>(src), dst, count);
+        break;
+    case nix::DataType::Float:
+        convert_float(src, dst, count);
+        break;
+    case nix::DataType::Int64:
+        convert_loop(static_cast<const int64_t*>(src), dst, count);
+        break;
+    case nix::DataType::UInt64:
+        convert_loop(static_cast<const uint64_t*>(src), dst, count);
+        break;
+    case nix::DataType::Double:
+        std::memcpy(dst, src, count * sizeof(double));
+        break;
+    default:
+        std::cerr << "nixview::util::to_double(): unsupported data type " << type << std::endl;
+        break;
+    }
+}
+
+
+void deinterleave(const double *src, size_t rows, size_t cols, const std::vector<size_t> &columns, double * const *dst) {
+    const size_t tile = 32;
+    for (size_t r0 = 0; r0 < rows; r0 += tile) {
+        size_t r1 = std::min(r0 + tile, rows);
+        for (size_t c0 = 0; c0 < columns.size(); c0 += tile) {
+            size_t c1 = std::min(c0 + tile, columns.size());
+            for (size_t c = c0; c < c1; ++c) {
+                const double *in = src + columns[c];
+                double *out = dst[c];
+                for (size_t r = r0; r < r1; ++r) {
+                    out[r] = in[r * cols];
+                }
+            }
+        }
+    }
+}
+
+
+void copy_box(const double *src, const nix::NDSize &srcOffset, const nix::NDSize &srcExtent,
+              double *dst, const nix::NDSize &dstOffset, const nix::NDSize &dstExtent) {
+    size_t rank = srcExtent.size();
+    if (rank == 0 || dstExtent.size() != rank) {
+        return;
+    }
+    nix::NDSize lo(rank, 0), hi(rank, 0), pos(rank, 0);
+    for (size_t d = 0; d < rank; ++d) {
+        lo[d] = std::max(srcOffset[d], dstOffset[d]);
+        hi[d] = std::min(srcOffset[d] + srcExtent[d], dstOffset[d] + dstExtent[d]);
+        if (lo[d] >= hi[d]) {
+            return;
+        }
+        pos[d] = lo[d];
+    }
+    size_t run = hi[rank - 1] - lo[rank - 1];
+    for (;;) {
+        size_t from = 0, to = 0;
+        for (size_t d = 0; d < rank; ++d) {
+            from = from * srcExtent[d] + (pos[d] - srcOffset[d]);
+            to = to * dstExtent[d] + (pos[d] - dstOffset[d]);
+        }
+        std::memcpy(dst + to, src + from, run * sizeof(double));
+        // the next run: counts up the dimensions before the last one.
+        size_t d = rank - 1;
+        while (d-- > 0 && ++pos[d] == hi[d]) {
+            pos[d] = lo[d];
+        }
+        if (d == static_cast<size_t>(-1)) {
+            return;
+        }
+    }
+}
+
+
+void read_as_double(const nix::DataArray &array, double *dst, const nix::NDSize &count, const nix::NDSize &offset,
+                    std::vector<char> &scratch) {
+    nix::DataType type = array.dataType();
+    if (type == nix::DataType::Double || !reads_native(array)) {
+        array.getData(nix::DataType::Double, dst, count, offset);
+        return;
+    }
+
+    size_t elements = count.nelms();
+    scratch.resize(elements * native_type_size(type));
+    array.getData(type, scratch.data(), count, offset);
+    to_double(type, scratch.data(), dst, elements);
+}
+
+} //namespace util
+} //namespace nixview
@@ -0,0 +1,67 @@
+#ifndef DATACONVERT_H
+#define DATACONVERT_H
+
+#include <vector>
+#include <nix.hpp>
+
+namespace nixview {
+namespace util {
+
+/**
+ * @brief native_type_size: size in bytes of one element of a numeric nix::DataType.
+ * @return the size or 0 if the type cannot be converted by to_double().
+ */
+size_t native_type_size(nix::DataType type);
+
+
+/**
+ * @brief reads_native: whether read_as_double() reads the array in its own data type.
+ * This is the case for numeric arrays without polynomial calibration, nix applies a calibration only when reading doubles.
+ */
+bool reads_native(const nix::DataArray &array);
+
+
+/**
+ * @brief exact_in_float: whether every value read_as_double() returns for the array can be stored as float without loss.
+ * True for arrays read natively as int8/16, uint8/16 or float.
+ */
+bool exact_in_float(const nix::DataArray &array);
+
+
+/**
+ * @brief to_double: converts count elements of the given type to double.
+ * int8/16/32, uint8/16 and float use SSE2 kernels where available, everything else a plain loop.
+ * @param type: a type with native_type_size(type) > 0.
+ */
+void to_double(nix::DataType type, const void *src, double *dst, size_t count);
+
+
+/**
+ * @brief deinterleave: copies columns of a row major block [rows x cols] into separate rows, columns[i] goes to dst[i].
+ * The block is walked in tiles, so the strided reads stay in cache instead of touching a new cache line per element.
+ */
+void deinterleave(const double *src, size_t rows, size_t cols, const std::vector<size_t> &columns, double * const *dst);
+
+
+/**
+ * @brief copy_box: copies the intersection of two row major boxes of the same array, src holding the values of
+ * [srcOffset, srcOffset + srcExtent) and dst those of [dstOffset, dstOffset + dstExtent). Runs along the last dimension are
+ * copied with memcpy.
+ */
+void copy_box(const double *src, const nix::NDSize &srcOffset, const nix::NDSize &srcExtent,
+              double *dst, const nix::NDSize &dstOffset, const nix::NDSize &dstExtent);
+
+
+/**
+ * @brief read_as_double: reads a block of the array into dst. If possible the block is read in the array's native type
+ * into the scratch buffer and converted with to_double(), which moves a half to an eighth of the bytes through the
+ * HDF5 type conversion. Otherwise nix converts to double.
+ * @param scratch: reused between calls to avoid reallocations.
+ */
+void read_as_double(const nix::DataArray &array, double *dst, const nix::NDSize &count, const nix::NDSize &offset,
+                    std::vector<char> &scratch);
+
+} //namespace util
+} //namespace nixview
+
+#endif // DATACONVERT_H
@@ -0,0 +1,294 @@
+#include "eventcounts.h"
+#include "dataconvert.h"
+#include "lodcache.h"
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+
+namespace fs = boost::filesystem;
+
+static const char EVENT_MAGIC[8] = {'N', 'V', 'E', 'V', 'C', '0', '0', '1'};
+// the finest level has at most this many bins.
+static const size_t MAX_BINS = 1 << 20;
+// the number of events read per step.
+static const size_t COUNT_CHUNK = 1 << 20;
+
+
+template<typename T>
+static void write_value(std::ostream &out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+template<typename T>
+static bool read_value(std::istream &in, T &value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+
+/**
+ * @brief EventCountJob: Reads the counts of an EventCounts from the cache, or counts the events chunk by chunk
+ * and stores the result.
+ */
+class EventCountJob : public LoadJob
+{
+public:
+    EventCountJob(EventCounts *counts, LoadPriority priority, const nix::DataArray &array) :
+        LoadJob(counts, priority), counts(counts), array(array), initialized(false) {
+    }
+
+    bool step() override;
+
+private:
+    EventCounts *counts;
+    nix::DataArray array;
+    bool initialized;
+    std::string path;
+    double first;
+    size_t events;
+    size_t position;
+    std::vector<EventCounts::Level> levels;
+    std::vector<double> values;
+    std::vector<char> nativeData;
+
+    bool init();
+    bool load();
+    void save() const;
+    void finish();
+};
+
+
+bool EventCountJob::init() {
+    initialized = true;
+    path = LodCache::eventEntryPath(array);
+    events = array.dataExtent()[0];
+    levels.resize(1);
+    if(load()) {
+        return false;
+    }
+
+    double last = 0;
+    first = 0;
+    if(events > 0) {
+        nix::NDSize offset(1, 0), extent(1, 1);
+        nixview::util::read_as_double(array, &first, extent, offset, nativeData);
+        offset[0] = events - 1;
+        nixview::util::read_as_double(array, &last, extent, offset, nativeData);
+    }
+    size_t bins = std::max(static_cast<size_t>(1), std::min(events, MAX_BINS));
+    levels[0].width = last > first ? (last - first) / bins : 1;
+    levels[0].counts.assign(bins, 0);
+    position = 0;
+    if(events == 0) {
+        finish();
+        return false;
+    }
+    return true;
+}
+
+
+bool EventCountJob::load() {
+    boost::system::error_code ec;
+    if(!fs::exists(fs::path(path), ec)) {
+        return false;
+    }
+    std::ifstream in(path.c_str(), std::ios::binary);
+    char magic[sizeof(EVENT_MAGIC)];
+    uint64_t storedEvents, bins;
+    double width;
+    in.read(magic, sizeof(magic));
+    bool ok = in && std::equal(magic, magic + sizeof(magic), EVENT_MAGIC) &&
+              read_value(in, first) && read_value(in, width) && read_value(in, storedEvents) && read_value(in, bins) &&
+              storedEvents == events && bins > 0 && bins <= MAX_BINS;
+    if(ok) {
+        levels[0].width = width;
+        levels[0].counts.resize(bins);
+        in.read(reinterpret_cast<char*>(levels[0].counts.data()), bins * sizeof(quint32));
+        ok = static_cast<bool>(in);
+    }
+    in.close();
+    if(!ok) {
+        std::cerr << "EventCountJob::load(): dropping unreadable entry " << path << std::endl;
+        fs::remove(fs::path(path), ec);
+        return false;
+    }
+    // the modification time serves as last access time for the LRU eviction of the LodCache.
+    fs::last_write_time(fs::path(path), std::time(nullptr), ec);
+    finish();
+    return true;
+}
+
+
+void EventCountJob::save() const {
+    fs::path target(path);
+    fs::path tmp(path + ".tmp");
+    boost::system::error_code ec;
+    fs::create_directories(target.parent_path(), ec);
+    {
+        std::ofstream out(tmp.string().c_str(), std::ios::binary | std::ios::trunc);
+        out.write(EVENT_MAGIC, sizeof(EVENT_MAGIC));
+        write_value<double>(out, first);
+        write_value<double>(out, levels[0].width);
+        write_value<uint64_t>(out, events);
+        write_value<uint64_t>(out, levels[0].counts.size());
+        out.write(reinterpret_cast<const char*>(levels[0].counts.data()), levels[0].counts.size() * sizeof(quint32));
+        if(!out) {
+            out.close();
+            fs::remove(tmp, ec);
+            return;
+        }
+    }
+    // written under a temporary name and renamed, so other loaders never see a partial entry.
+    fs::rename(tmp, target, ec);
+    if(ec) {
+        fs::remove(tmp, ec);
+        return;
+    }
+    LodCache::evict();
+}
+
+
+void EventCountJob::finish() {
+    // only the finest level is stored, the others are merged from it.
+    while(levels.back().counts.size() > 1) {
+        const EventCounts::Level &below = levels.back();
+        EventCounts::Level level;
+        level.width = below.width * counts->factor;
+        level.counts.assign((below.counts.size() + counts->factor - 1) / counts->factor, 0);
+        for(size_t i=0; i<below.counts.size(); i++) {
+            level.counts[i / counts->factor] += below.counts[i];
+        }
+        levels.push_back(level);
+    }
+    counts->publish(first, events, levels);
+}
+
+
+bool EventCountJob::step() {
+    if(!initialized) {
+        return init();
+    }
+
+    size_t n = std::min(COUNT_CHUNK, events - position);
+    nix::NDSize offset(1, position), extent(1, n);
+    values.resize(n);
+    nixview::util::read_as_double(array, values.data(), extent, offset, nativeData);
+
+    EventCounts::Level &level = levels[0];
+    size_t last = level.counts.size() - 1;
+    for(double value : values) {
+        if(std::isnan(value)) {
+            continue;
+        }
+        double bin = (value - first) / level.width;
+        level.counts[bin <= 0 ? 0 : std::min(static_cast<size_t>(bin), last)]++;
+    }
+    position += n;
+    if(position < events) {
+        return true;
+    }
+    save();
+    finish();
+    return false;
+}
+
+
+EventCounts::EventCounts(QObject *parent, unsigned int factor) :
+    QObject(parent), factor(std::max(2u, factor)), priority(LoadPriority::Visible),
+    complete(false), first(0), events(0) {
+}
+
+
+EventCounts::~EventCounts() {
+    // the running job publishes through this object, so wait for it to finish its current step.
+    LoadScheduler::instance().cancel(this, true);
+}
+
+
+void EventCounts::build(const nix::DataArray &array) {
+    LoadScheduler &scheduler = LoadScheduler::instance();
+    scheduler.cancel(this, true);
+    {
+        QMutexLocker locker(&mutex);
+        complete = false;
+        levels.clear();
+        events = 0;
+    }
+    if(array.dataExtent().size() != 1) {
+        std::cerr << "EventCounts::build(): can only count 1D arrays." << std::endl;
+        return;
+    }
+    scheduler.submit(QSharedPointer<LoadJob>(new EventCountJob(this, priority, array)));
+}
+
+
+void EventCounts::publish(double first, size_t events, std::vector<Level> &levels) {
+    {
+        QMutexLocker locker(&mutex);
+        this->first = first;
+        this->events = events;
+        this->levels.swap(levels);
+        complete = true;
+    }
+    emit ready();
+}
+
+
+bool EventCounts::isReady() const {
+    QMutexLocker locker(&mutex);
+    return complete;
+}
+
+
+size_t EventCounts::eventCount() const {
+    QMutexLocker locker(&mutex);
+    return events;
+}
+
+
+double EventCounts::histogram(double from, double to, double minWidth, QVector<double> &keys, QVector<double> &rates) const {
+    QMutexLocker locker(&mutex);
+    keys.clear();
+    rates.clear();
+    if(!complete || levels.empty() || !(to > from)) {
+        return 0;
+    }
+    size_t k = 0;
+    while(k + 1 < levels.size() && levels[k].width < minWidth) {
+        k++;
+    }
+    const Level &level = levels[k];
+    double lo = (from - first) / level.width;
+    double hi = (to - first) / level.width;
+    size_t bins = level.counts.size();
+    if(hi <= 0 || lo >= bins) {
+        return 0;
+    }
+    size_t b0 = lo <= 0 ? 0 : static_cast<size_t>(lo);
+    size_t b1 = std::min(bins, static_cast<size_t>(std::ceil(hi)));
+
+    double total = 0;
+    keys.resize(static_cast<int>(b1 - b0 + 1));
+    rates.resize(keys.size());
+    for(size_t b=b0; b<b1; b++) {
+        int i = static_cast<int>(b - b0);
+        double count = level.counts[b];
+        keys[i] = first + b * level.width;
+        rates[i] = count / level.width;
+        double overlap = std::min(static_cast<double>(b + 1), hi) - std::max(static_cast<double>(b), lo);
+        total += count * std::max(0.0, std::min(1.0, overlap));
+    }
+    keys.last() = first + b1 * level.width;
+    rates.last() = rates[rates.size() - 2];
+    return total;
+}
+
+
+void EventCounts::setPriority(LoadPriority priority) {
+    this->priority = priority;
+    LoadScheduler::instance().setPriority(this, priority);
+}
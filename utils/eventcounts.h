@@ -0,0 +1,68 @@
+#ifndef EVENTCOUNTS_H
+#define EVENTCOUNTS_H
+
+#include <QObject>
+#include <QMutex>
+#include <QVector>
+#include <vector>
+#include <nix.hpp>
+#include "loadscheduler.h"
+
+
+class EventCounts : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief EventCounts: Count pyramid of a sorted 1D event array. Level 0 counts the events in equal bins over the
+     * range of the events, every further level merges factor bins of the level below. The bins of level 0 are capped,
+     * so the pyramid has a fixed size no matter how many events there are.
+     * It is read from the LodCache or counted in one pass over the array on the shared LoadScheduler.
+     */
+    explicit EventCounts(QObject *parent = 0, unsigned int factor = 4);
+    ~EventCounts();
+
+    /**
+     * @brief build: drops the counts and starts loading or counting those of the array, emits ready() when done.
+     */
+    void build(const nix::DataArray &array);
+
+    bool isReady() const;
+    size_t eventCount() const;
+
+    /**
+     * @brief histogram: the event rate (events per unit of the positions) over [from, to] in the bins of the finest level
+     * whose bins are at least minWidth wide. Fills a step curve: keys are the left edges of the bins followed by the
+     * right edge of the last one, which repeats the last rate.
+     * @return the number of events in [from, to], those of the bins at the ends weighted by their overlap.
+     */
+    double histogram(double from, double to, double minWidth, QVector<double> &keys, QVector<double> &rates) const;
+
+    void setPriority(LoadPriority priority);
+
+signals:
+    void ready();
+
+private:
+    friend class EventCountJob;
+
+    struct Level {
+        double width;
+        std::vector<quint32> counts;
+    };
+
+    unsigned int factor;
+    LoadPriority priority;
+
+    // guards the levels, the job swaps in the finished pyramid.
+    mutable QMutex mutex;
+    bool complete;
+    double first;
+    size_t events;
+    std::vector<Level> levels;
+
+    void publish(double first, size_t events, std::vector<Level> &levels);
+};
+
+#endif // EVENTCOUNTS_H
@@ -0,0 +1,201 @@
+#include "framering.h"
+#include "dataconvert.h"
+#include "common/Common.hpp"
+#include <QSettings>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+
+/**
+ * @brief FrameRingJob: Loads the missing frames of the window of a FrameRing, nearest to the current frame first.
+ * Ends when the window is complete, FrameRing::setPosition() submits a new one when the window moves.
+ */
+class FrameRingJob : public LoadJob
+{
+public:
+    FrameRingJob(FrameRing *ring, LoadPriority priority) :
+        LoadJob(ring, priority), ring(ring), array(ring->array) {
+    }
+
+    bool step() override {
+        int frame;
+        {
+            QMutexLocker locker(&ring->mutex);
+            frame = ring->nextMissing();
+            if(frame < 0) {
+                ring->prefetching = false;
+                return false;
+            }
+        }
+
+        nix::NDSize offset(3, 0), extent(3);
+        offset[0] = frame;
+        extent[0] = 1;
+        extent[1] = ring->height;
+        extent[2] = ring->width;
+        values.resize(static_cast<size_t>(ring->height) * ring->width);
+        ValueStats stats;
+        try {
+            nixview::util::read_as_double(array, values.data(), extent, offset, nativeData);
+            stats = nixview::util::value_stats(values.data(), values.size());
+        } catch (std::exception &e) {
+            // an empty frame is stored in its place, otherwise it stays the next missing one and stalls the playback.
+            std::cerr << "FrameRingJob::step(): reading frame " << frame << " of " << array.name() << " failed: "
+                      << e.what() << std::endl;
+            std::fill(values.begin(), values.end(), std::numeric_limits<double>::quiet_NaN());
+        }
+
+        if(ring->store(frame, values, stats)) {
+            emit ring->frameReady(frame);
+        }
+        return true;
+    }
+
+private:
+    FrameRing *ring;
+    nix::DataArray array;
+    // swapped with the buffer of the slot a frame is stored in.
+    std::vector<double> values;
+    std::vector<char> nativeData;
+};
+
+
+FrameRing::FrameRing(QObject *parent) :
+    QObject(parent), priority(LoadPriority::Visible), frames(0), height(0), width(0),
+    position(0), direction(1), prefetching(false) {
+    QSettings settings;
+    settings.beginGroup(PLOT_GROUP);
+    capacity = std::max(2, settings.value(PLOT_STACK_PREFETCH, 16).toInt());
+    settings.endGroup();
+}
+
+
+FrameRing::~FrameRing() {
+    // the running job emits through this object, so wait for it to finish its current step.
+    LoadScheduler::instance().cancel(this, true);
+}
+
+
+void FrameRing::setArray(const nix::DataArray &array) {
+    LoadScheduler::instance().cancel(this, true);
+
+    QMutexLocker locker(&mutex);
+    this->array = array;
+    nix::NDSize shape = array.dataExtent();
+    if(shape.size() != 3) {
+        std::cerr << "FrameRing::setArray(): can only play 3D arrays." << std::endl;
+        frames = height = width = 0;
+        ring.clear();
+        return;
+    }
+    frames = static_cast<int>(shape[0]);
+    height = static_cast<int>(shape[1]);
+    width = static_cast<int>(shape[2]);
+    ring.resize(std::min(capacity, frames));
+    for(Slot &slot : ring) {
+        slot.frame = -1;
+        slot.values.assign(static_cast<size_t>(height) * width, 0.0);
+    }
+    position = 0;
+    direction = 1;
+    prefetching = false;
+}
+
+
+void FrameRing::setPosition(int frame, int direction) {
+    bool start = false;
+    {
+        QMutexLocker locker(&mutex);
+        position = std::max(0, std::min(frame, frames - 1));
+        this->direction = direction < 0 ? -1 : 1;
+        if(!prefetching && nextMissing() >= 0) {
+            prefetching = start = true;
+        }
+    }
+    if(start) {
+        LoadScheduler::instance().submit(QSharedPointer<LoadJob>(new FrameRingJob(this, priority)));
+    }
+}
+
+
+bool FrameRing::copy(int frame, double *dst, ValueStats &stats) {
+    QMutexLocker locker(&mutex);
+    for(const Slot &slot : ring) {
+        if(slot.frame == frame) {
+            std::memcpy(dst, slot.values.data(), slot.values.size() * sizeof(double));
+            stats = slot.stats;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void FrameRing::setPriority(LoadPriority priority) {
+    this->priority = priority;
+    LoadScheduler::instance().setPriority(this, priority);
+}
+
+
+int FrameRing::frameCount() const {
+    return frames;
+}
+
+
+int FrameRing::rows() const {
+    return height;
+}
+
+
+int FrameRing::cols() const {
+    return width;
+}
+
+
+bool FrameRing::inWindow(int frame) const {
+    int distance = (frame - position) * direction;
+    return frame >= 0 && frame < frames && distance >= 0 && distance < static_cast<int>(ring.size());
+}
+
+
+int FrameRing::nextMissing() const {
+    for(int k=0; k<static_cast<int>(ring.size()); k++) {
+        int frame = position + k * direction;
+        if(frame < 0 || frame >= frames) {
+            break;
+        }
+        bool present = false;
+        for(const Slot &slot : ring) {
+            present = present || slot.frame == frame;
+        }
+        if(!present) {
+            return frame;
+        }
+    }
+    return -1;
+}
+
+
+bool FrameRing::store(int frame, std::vector<double> &values, const ValueStats &stats) {
+    QMutexLocker locker(&mutex);
+    if(!inWindow(frame)) {
+        return false;
+    }
+    // an empty slot or one whose frame the playback has passed.
+    Slot *target = 0;
+    for(Slot &slot : ring) {
+        if(slot.frame < 0 || !inWindow(slot.frame)) {
+            target = &slot;
+            break;
+        }
+    }
+    if(!target) {
+        return false;
+    }
+    target->values.swap(values);
+    target->frame = frame;
+    target->stats = stats;
+    return true;
+}
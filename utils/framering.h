@@ -0,0 +1,84 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <QObject>
+#include <QMutex>
+#include <vector>
+#include <nix.hpp>
+#include "loadscheduler.h"
+#include "valuestats.h"
+
+
+class FrameRing : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief FrameRing: Ring buffer of the frames of a 3D array [frames x rows x cols] for playback.
+     * A job on the shared LoadScheduler prefetches the frames following the current one in the playback direction.
+     * The frame buffers are allocated once per array and swapped between the ring and the job, never reallocated.
+     * The number of frames held, the current one included, is read from the settings (PLOT_GROUP/PLOT_STACK_PREFETCH).
+     */
+    explicit FrameRing(QObject *parent = 0);
+    ~FrameRing();
+
+    /**
+     * @brief setArray: drops all frames and prepares the ring for a 3D array.
+     */
+    void setArray(const nix::DataArray &array);
+
+    /**
+     * @brief setPosition: moves the window of the ring to [frame, frame + direction * capacity) and starts
+     * prefetching the frames of the window that are missing.
+     * @param direction: 1 for forward, -1 for backward playback.
+     */
+    void setPosition(int frame, int direction);
+
+    /**
+     * @brief copy: copies a frame into dst, rows * cols values.
+     * @return false if the frame is not loaded yet.
+     */
+    bool copy(int frame, double *dst, ValueStats &stats);
+
+    void setPriority(LoadPriority priority);
+
+    int frameCount() const;
+    int rows() const;
+    int cols() const;
+
+signals:
+    /**
+     * @brief frameReady: emitted when a frame was loaded into the ring.
+     */
+    void frameReady(int frame);
+
+private:
+    friend class FrameRingJob;
+
+    struct Slot {
+        int frame;
+        std::vector<double> values;
+        ValueStats stats;
+    };
+
+    int capacity;
+    LoadPriority priority;
+    nix::DataArray array;
+    int frames;
+    int height;
+    int width;
+
+    // guards the ring and the window, the job only holds it while it picks or stores a frame.
+    QMutex mutex;
+    std::vector<Slot> ring;
+    int position;
+    int direction;
+    bool prefetching;
+
+    bool inWindow(int frame) const;
+    int nextMissing() const;
+    bool store(int frame, std::vector<double> &values, const ValueStats &stats);
+};
+
+#endif // FRAMERING_H
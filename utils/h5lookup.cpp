@@ -0,0 +1,87 @@
+#include "h5lookup.h"
+#include <vector>
+#include <string>
+
+namespace nixview {
+namespace util {
+
+static std::string read_string_attribute(hid_t object, const char *name) {
+    std::string value;
+    if (H5Aexists(object, name) <= 0) {
+        return value;
+    }
+    hid_t attribute = H5Aopen(object, name, H5P_DEFAULT);
+    hid_t type = H5Aget_type(attribute);
+
+    if (H5Tis_variable_str(type) > 0) {
+        hid_t memtype = H5Tcopy(H5T_C_S1);
+        H5Tset_size(memtype, H5T_VARIABLE);
+        char *str = nullptr;
+        if (H5Aread(attribute, memtype, &str) >= 0 && str) {
+            value = str;
+            H5free_memory(str);
+        }
+        H5Tclose(memtype);
+    } else {
+        std::vector<char> buffer(H5Tget_size(type) + 1, 0);
+        if (H5Aread(attribute, type, buffer.data()) >= 0) {
+            value = buffer.data();
+        }
+    }
+    H5Tclose(type);
+    H5Aclose(attribute);
+    return value;
+}
+
+
+static bool link_exists(hid_t location, const std::string &path) {
+    // H5Lexists needs every intermediate link to exist, so the path is checked step by step.
+    size_t pos = 0;
+    while (pos != std::string::npos) {
+        pos = path.find('/', pos + 1);
+        if (H5Lexists(location, path.substr(0, pos).c_str(), H5P_DEFAULT) <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+hid_t open_array_group(hid_t file, const nix::DataArray &array) {
+    if (!link_exists(file, "data")) {
+        return -1;
+    }
+    hid_t data = H5Gopen2(file, "data", H5P_DEFAULT);
+    H5G_info_t info;
+    H5Gget_info(data, &info);
+
+    hid_t found = -1;
+    std::vector<std::string> names = {array.name(), array.id()};
+    for (hsize_t i = 0; i < info.nlinks && found < 0; ++i) {
+        ssize_t size = H5Lget_name_by_idx(data, ".", H5_INDEX_NAME, H5_ITER_INC, i, nullptr, 0, H5P_DEFAULT);
+        if (size <= 0) {
+            continue;
+        }
+        std::vector<char> block(size + 1, 0);
+        H5Lget_name_by_idx(data, ".", H5_INDEX_NAME, H5_ITER_INC, i, block.data(), size + 1, H5P_DEFAULT);
+
+        for (const std::string &name : names) {
+            std::string path = std::string(block.data()) + "/data_arrays/" + name;
+            if (!link_exists(data, path)) {
+                continue;
+            }
+            hid_t group = H5Gopen2(data, path.c_str(), H5P_DEFAULT);
+            std::string id = read_string_attribute(group, "entity_id");
+            if (id.empty() || id == array.id()) {
+                found = group;
+                break;
+            }
+            H5Gclose(group);
+        }
+    }
+    H5Gclose(data);
+    return found;
+}
+
+} //namespace util
+} //namespace nixview
@@ -0,0 +1,43 @@
+#ifndef H5LOOKUP_H
+#define H5LOOKUP_H
+
+#include <hdf5.h>
+#include <nix.hpp>
+
+namespace nixview {
+namespace util {
+
+/**
+ * @brief H5ErrorsOff: disables the automatic HDF5 error printing while it exists.
+ * Looking up the objects of an entity probes links that may not exist, HDF5 would print each miss as an error.
+ */
+class H5ErrorsOff
+{
+public:
+    H5ErrorsOff() {
+        H5Eget_auto2(H5E_DEFAULT, &func, &data);
+        H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+    }
+
+    ~H5ErrorsOff() {
+        H5Eset_auto2(H5E_DEFAULT, func, data);
+    }
+
+private:
+    H5E_auto2_t func;
+    void *data;
+};
+
+
+/**
+ * @brief open_array_group: finds the group of the array in a nix file: data/<block>/data_arrays/<array name or id>
+ * with the matching entity_id. It holds the dataset "data" and the dimensions ("dimensions/<index>/ticks", ...).
+ * nix does not expose the HDF5 objects, this is for reads nix can only do as a whole.
+ * @return the group, to be closed with H5Gclose(), or a negative value if it was not found.
+ */
+hid_t open_array_group(hid_t file, const nix::DataArray &array);
+
+} //namespace util
+} //namespace nixview
+
+#endif // H5LOOKUP_H
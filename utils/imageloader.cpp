@@ -0,0 +1,372 @@
+#include "imageloader.h"
+#include "dataconvert.h"
+#include "storagelayout.h"
+#include "lodcache.h"
+#include <algorithm>
+#include <cmath>
+
+// the preview has about this many values along the longer side of the image.
+static const size_t PREVIEW_SIZE = 512;
+// with filtered chunks the preview reads at most one row in this many chunk rows, each row decompresses its whole band.
+static const size_t PREVIEW_CHUNK_SKIP = 4;
+
+
+/**
+ * @brief ImageLoadJob: One load of an ImageLoader. The first steps deliver the preview: the coarsest pyramid level if the
+ * pyramid is complete, otherwise every stride-th row of the image, pooled to one mean per stride columns.
+ * While the pyramid is incomplete each step feeds a band of whole rows into it and delivers the part of the region that
+ * the band completed. The last steps read the remaining tiles of the region, from the pyramid or from the array.
+ */
+class ImageLoadJob : public LoadJob
+{
+public:
+    ImageLoadJob(ImageLoader *loader, LoadPriority priority, const nix::DataArray &array, int request, int level,
+                 const QRect &region, unsigned int tileSize);
+
+    bool step() override;
+
+private:
+    ImageLoader *loader;
+    nix::DataArray array;
+    int request;
+    int level;
+    QRect requested;
+    unsigned int tileSize;
+
+    bool initialized;
+    StorageLayout layout;
+    size_t rows;
+    size_t cols;
+    size_t stride;
+    size_t previewRow;
+    // the region in cells of the level.
+    size_t top;
+    size_t bottom;
+    size_t left;
+    size_t right;
+    // the tiles cover the rows [top, tileEnd), the others are delivered by the build.
+    size_t tileEnd;
+    size_t tileRows;
+    size_t tileCols;
+    size_t row;
+    size_t col;
+    size_t loaded;
+    size_t work;
+    std::vector<double> rowData;
+    std::vector<double> band;
+    std::vector<double> produced;
+    std::vector<char> nativeData;
+
+    void init();
+    void previewStep();
+    void buildStep();
+    void tileStep();
+    void deliver(size_t first, size_t count, const std::vector<double> &values, size_t width);
+    void reportProgress();
+};
+
+
+ImageLoadJob::ImageLoadJob(ImageLoader *loader, LoadPriority priority, const nix::DataArray &array, int request, int level,
+                           const QRect &region, unsigned int tileSize) :
+    LoadJob(loader, priority), loader(loader), array(array), request(request), level(level), requested(region),
+    tileSize(tileSize) {
+    initialized = false;
+}
+
+
+void ImageLoadJob::init() {
+    nix::NDSize shape = array.dataExtent();
+    rows = shape[0];
+    cols = shape[1];
+    layout = StorageLayout::of(array);
+
+    ImagePyramid &pyramid = loader->pyramid;
+    std::string path = LodCache::imageEntryPath(array);
+    if(path != loader->pyramidPath) {
+        // a failed open is not retried for the same array, the loads fall back to the image itself.
+        loader->pyramidPath = path;
+        loader->previewDone = false;
+        if(static_cast<qint64>(ImagePyramid::fileSize(rows, cols)) > LodCache::maxSize()) {
+            // it would be evicted again right away, the loads use the image itself.
+            std::cerr << "ImageLoadJob::init(): the pyramid of " << array.name() << " takes "
+                      << ImagePyramid::fileSize(rows, cols) / (1024 * 1024) << " MB, more than the cache may hold. It is not built."
+                      << std::endl;
+            pyramid.close();
+        } else {
+            pyramid.open(path, rows, cols);
+        }
+    }
+
+    level = std::max(0, std::min(level, ImagePyramid::levelCount(rows, cols) - 1));
+    if(level > 0 && !pyramid.isOpen()) {
+        level = 0;
+        requested = QRect();
+    }
+    QRect bounds(0, 0, static_cast<int>(ImagePyramid::levelSize(cols, level)),
+                 static_cast<int>(ImagePyramid::levelSize(rows, level)));
+    QRect region = requested & bounds;
+    top = region.isEmpty() ? 0 : region.y();
+    bottom = region.isEmpty() ? 0 : region.y() + region.height();
+    left = region.isEmpty() ? 0 : region.x();
+    right = region.isEmpty() ? 0 : region.x() + region.width();
+
+    bool building = pyramid.isOpen() && !pyramid.isComplete();
+    tileEnd = std::min(bottom, building ? pyramid.rowsDone(level) : bottom);
+
+    size_t longer = std::max(rows, cols);
+    stride = (longer + PREVIEW_SIZE - 1) / PREVIEW_SIZE;
+    if(layout.isFiltered()) {
+        stride = std::max(stride, PREVIEW_CHUNK_SKIP * layout.chunkExtent(0));
+    }
+    // a small image is loaded faster than its preview.
+    previewRow = stride > 1 && rows * cols > tileSize ? 0 : rows;
+
+    // whole rows are one contiguous read. Wide chunked images are read in blocks of whole chunks instead,
+    // a band over the full width would decompress more chunks than the HDF5 chunk cache holds.
+    // The pyramid is read in whole rows of the region.
+    tileCols = right - left;
+    if(level == 0 && layout.isChunked() && layout.chunkExtent(1) < tileCols) {
+        tileCols = std::max(layout.chunkExtent(1), static_cast<size_t>(std::sqrt(static_cast<double>(tileSize))));
+    }
+    tileRows = std::max(static_cast<size_t>(1), tileSize / std::max(tileCols, static_cast<size_t>(1)));
+    row = top;
+    col = left;
+    loaded = 0;
+    work = (tileEnd > top ? tileEnd - top : 0) * (right - left);
+    if(building) {
+        work += (rows - pyramid.rowsFed()) * cols;
+    }
+    initialized = true;
+}
+
+
+bool ImageLoadJob::step() {
+    if(! initialized) {
+        init();
+    }
+    if(rows == 0 || cols == 0) {
+        emit loader->progress(request, 1);
+        return false;
+    }
+    ImagePyramid &pyramid = loader->pyramid;
+    if(!loader->previewDone) {
+        previewStep();
+        return true;
+    }
+    if(pyramid.isOpen() && !pyramid.isComplete()) {
+        buildStep();
+        return true;
+    }
+    if(row < tileEnd) {
+        tileStep();
+        return true;
+    }
+    emit loader->progress(request, 1);
+    return false;
+}
+
+
+void ImageLoadJob::previewStep() {
+    ImagePyramid &pyramid = loader->pyramid;
+    if(pyramid.isComplete()) {
+        loader->previewDone = true;
+        int coarsest = ImagePyramid::levelCount(rows, cols) - 1;
+        if(coarsest == 0) {
+            return;
+        }
+        ImageBlock *block = new ImageBlock;
+        block->request = request;
+        block->preview = true;
+        block->row = 0;
+        block->col = 0;
+        block->rows = static_cast<int>(ImagePyramid::levelSize(rows, coarsest));
+        block->cols = static_cast<int>(ImagePyramid::levelSize(cols, coarsest));
+        block->step = 1 << coarsest;
+        block->values.resize(static_cast<size_t>(block->rows) * block->cols);
+        if(!pyramid.read(coarsest, 0, 0, block->rows, block->cols, block->values.data())) {
+            delete block;
+            return;
+        }
+        block->stats = nixview::util::value_stats(block->values.data(), block->values.size());
+        emit loader->blockReady(ImageBlockPtr(block));
+        return;
+    }
+    if(previewRow >= rows) {
+        loader->previewDone = true;
+        return;
+    }
+
+    size_t previewCols = (cols + stride - 1) / stride;
+    size_t count = std::max(static_cast<size_t>(1), tileSize / cols);
+    count = std::min(count, (rows - previewRow + stride - 1) / stride);
+
+    ImageBlock *block = new ImageBlock;
+    block->request = request;
+    block->preview = true;
+    block->row = static_cast<int>(previewRow);
+    block->col = 0;
+    block->rows = static_cast<int>(count);
+    block->cols = static_cast<int>(previewCols);
+    block->step = static_cast<int>(stride);
+    block->values.resize(count * previewCols);
+
+    nix::NDSize offset(2), extent(2);
+    extent[0] = 1;
+    extent[1] = cols;
+    offset[1] = 0;
+    rowData.resize(cols);
+    for(size_t r=0; r<count; r++) {
+        offset[0] = previewRow + r * stride;
+        nixview::util::read_as_double(array, rowData.data(), extent, offset, nativeData);
+        for(size_t c=0; c<previewCols; c++) {
+            size_t first = c * stride;
+            size_t length = std::min(stride, cols - first);
+            block->values[r * previewCols + c] = nixview::util::value_stats(rowData.data() + first, length).mean();
+        }
+    }
+    block->stats = nixview::util::value_stats(block->values.data(), block->values.size());
+    previewRow += count * stride;
+    loader->previewDone = previewRow >= rows;
+
+    emit loader->blockReady(ImageBlockPtr(block));
+}
+
+
+void ImageLoadJob::buildStep() {
+    ImagePyramid &pyramid = loader->pyramid;
+    size_t first = pyramid.rowsFed();
+    size_t count = std::min(layout.alignedEnd(0, first, std::max(static_cast<size_t>(1), tileSize / cols)), rows) - first;
+
+    // bands of whole rows, each chunk is decompressed once.
+    nix::NDSize offset(2), extent(2);
+    offset[0] = first;
+    offset[1] = 0;
+    extent[0] = count;
+    extent[1] = cols;
+    band.resize(count * cols);
+    nixview::util::read_as_double(array, band.data(), extent, offset, nativeData);
+
+    produced.clear();
+    size_t producedFirst = 0;
+    bool ok = pyramid.append(band.data(), count, level, produced, producedFirst);
+    loaded += count * cols;
+
+    if(level == 0) {
+        deliver(first, count, band, cols);
+    } else {
+        size_t width = ImagePyramid::levelSize(cols, level);
+        deliver(producedFirst, produced.size() / width, produced, width);
+    }
+    if(!ok) {
+        // the image itself is still there, the pyramid levels are not.
+        tileEnd = level == 0 ? bottom : row;
+    } else if(pyramid.isComplete()) {
+        LodCache::evict(loader->pyramidPath);
+    }
+    reportProgress();
+}
+
+
+void ImageLoadJob::deliver(size_t first, size_t count, const std::vector<double> &values, size_t width) {
+    size_t from = std::max(first, top);
+    size_t to = std::min(first + count, bottom);
+    if(from >= to || left >= right) {
+        return;
+    }
+    ImageBlock *block = new ImageBlock;
+    block->request = request;
+    block->preview = false;
+    block->row = static_cast<int>(from) << level;
+    block->col = static_cast<int>(left) << level;
+    block->rows = static_cast<int>(to - from);
+    block->cols = static_cast<int>(right - left);
+    block->step = 1 << level;
+    block->values.resize((to - from) * (right - left));
+    for(size_t r=from; r<to; r++) {
+        const double *src = values.data() + (r - first) * width + left;
+        std::copy(src, src + (right - left), block->values.begin() + (r - from) * (right - left));
+    }
+    block->stats = nixview::util::value_stats(block->values.data(), block->values.size());
+    emit loader->blockReady(ImageBlockPtr(block));
+}
+
+
+void ImageLoadJob::tileStep() {
+    size_t rowEnd = std::min(level == 0 ? layout.alignedEnd(0, row, tileRows) : row + tileRows, tileEnd);
+    size_t colEnd = std::min(level == 0 ? layout.alignedEnd(1, col, tileCols) : right, right);
+
+    ImageBlock *block = new ImageBlock;
+    block->request = request;
+    block->preview = false;
+    block->row = static_cast<int>(row) << level;
+    block->col = static_cast<int>(col) << level;
+    block->rows = static_cast<int>(rowEnd - row);
+    block->cols = static_cast<int>(colEnd - col);
+    block->step = 1 << level;
+    block->values.resize((rowEnd - row) * (colEnd - col));
+
+    if(level == 0) {
+        nix::NDSize offset(2), extent(2);
+        offset[0] = row;
+        offset[1] = col;
+        extent[0] = rowEnd - row;
+        extent[1] = colEnd - col;
+        nixview::util::read_as_double(array, block->values.data(), extent, offset, nativeData);
+    } else if(!loader->pyramid.read(level, row, col, rowEnd - row, colEnd - col, block->values.data())) {
+        std::cerr << "ImageLoadJob::tileStep(): cannot read pyramid level " << level << std::endl;
+        delete block;
+        tileEnd = row;
+        return;
+    }
+    block->stats = nixview::util::value_stats(block->values.data(), block->values.size());
+    loaded += block->values.size();
+
+    // row major: the tiles of a band from left to right, then the next band.
+    col = colEnd;
+    if(col >= right) {
+        col = left;
+        row = rowEnd;
+    }
+
+    emit loader->blockReady(ImageBlockPtr(block));
+    reportProgress();
+}
+
+
+void ImageLoadJob::reportProgress() {
+    if(work > 0) {
+        // the last step reports 1 once it is done.
+        emit loader->progress(request, std::min(0.99, static_cast<double>(loaded) / work));
+    }
+}
+
+
+ImageLoader::ImageLoader(QObject *parent, unsigned int tileSize) :
+    QObject(parent), tileSize(std::max(1u, tileSize)), priority(LoadPriority::Visible), requests(0), previewDone(false) {
+    qRegisterMetaType<ImageBlockPtr>("ImageBlockPtr");
+}
+
+
+ImageLoader::~ImageLoader() {
+    // running jobs emit through this object, so wait for them to finish their current step.
+    LoadScheduler::instance().cancel(this, true);
+}
+
+
+int ImageLoader::load(const nix::DataArray &array, int level, const QRect &region) {
+    if(array.dataExtent().size() != 2) {
+        std::cerr << "ImageLoader::load(): can only load 2D arrays." << std::endl;
+        return -1;
+    }
+    LoadScheduler &scheduler = LoadScheduler::instance();
+    scheduler.cancel(this);
+    int request = ++requests;
+    scheduler.submit(QSharedPointer<LoadJob>(new ImageLoadJob(this, priority, array, request, level, region, tileSize)));
+    return request;
+}
+
+
+void ImageLoader::setPriority(LoadPriority priority) {
+    this->priority = priority;
+    LoadScheduler::instance().setPriority(this, priority);
+}
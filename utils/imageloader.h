@@ -0,0 +1,93 @@
+#ifndef IMAGELOADER_H
+#define IMAGELOADER_H
+
+#include <QObject>
+#include <QRect>
+#include <QSharedPointer>
+#include <QMetaType>
+#include <vector>
+#include <nix.hpp>
+#include "loadscheduler.h"
+#include "valuestats.h"
+#include "imagepyramid.h"
+
+
+/**
+ * @brief ImageBlock: A rectangle of a 2D array delivered by the ImageLoader. Rows run along the first dimension of the array.
+ * Value (r, c) stands for the step x step cells of the image beginning at row + r * step, col + c * step, the last ones
+ * may reach beyond the image. Blocks of pyramid level k have step 2^k, preview blocks may have any step.
+ */
+struct ImageBlock
+{
+    // the load that delivered the block.
+    int request;
+    bool preview;
+    int row;
+    int col;
+    int rows;
+    int cols;
+    int step;
+    // row major, rows * cols values.
+    std::vector<double> values;
+    ValueStats stats;
+};
+
+typedef QSharedPointer<const ImageBlock> ImageBlockPtr;
+Q_DECLARE_METATYPE(ImageBlockPtr)
+
+
+class ImageLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief ImageLoader: Loads rectangles of a 2D array or of its ImagePyramid on the workers of the shared LoadScheduler.
+     * A coarse preview of the whole image is delivered once per array. The pyramid is cached by the LodCache, if it is
+     * not there yet the first load builds it, delivering the requested rectangle as the build passes it.
+     * @param tileSize: about the number of values of one tile.
+     */
+    explicit ImageLoader(QObject *parent = 0, unsigned int tileSize = 1 << 20);
+    ~ImageLoader();
+
+    /**
+     * @brief load: cancels the running load and submits the loading of a rectangle of the array.
+     * @param level: the pyramid level, 0 for the image itself.
+     * @param region: the rectangle in cells of the level, x along the columns.
+     * @return the number of the request, part of its blocks and progress.
+     */
+    int load(const nix::DataArray &array, int level, const QRect &region);
+
+    /**
+     * @brief setPriority: sets the LoadPriority of the following and the pending loads, e.g. LoadPriority::Background while
+     * the plot is hidden.
+     */
+    void setPriority(LoadPriority priority);
+
+signals:
+    /**
+     * @brief blockReady: emitted for every block of the preview and every tile, in this order.
+     */
+    void blockReady(const ImageBlockPtr &block);
+
+    /**
+     * @brief progress: emitted after each tile.
+     * @param request: the number returned by load().
+     * @param percent: number between 0-1, 1 after the last tile.
+     */
+    void progress(int request, double percent);
+
+private:
+    friend class ImageLoadJob;
+
+    unsigned int tileSize;
+    LoadPriority priority;
+    int requests;
+
+    // only touched by the jobs, which never run at the same time.
+    ImagePyramid pyramid;
+    std::string pyramidPath;
+    bool previewDone;
+};
+
+#endif // IMAGELOADER_H
@@ -0,0 +1,278 @@
+#include "imagepyramid.h"
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <ctime>
+#include <limits>
+
+namespace fs = boost::filesystem;
+
+static const char IMAGE_MAGIC[8] = {'N', 'V', 'I', 'M', 'G', '0', '0', '1'};
+static const std::streamoff HEADER_SIZE = sizeof(IMAGE_MAGIC) + 2 * sizeof(uint64_t);
+// the coarsest level is not larger than this along either dimension.
+static const size_t PYRAMID_TOP_SIZE = 256;
+
+
+template<typename T>
+static void write_value(std::ostream &out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+template<typename T>
+static bool read_value(std::istream &in, T &value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+
+ImagePyramid::ImagePyramid() : rows(0), cols(0), fed(0), opened(false), complete(false) {
+}
+
+
+ImagePyramid::~ImagePyramid() {
+    close();
+}
+
+
+size_t ImagePyramid::levelSize(size_t size, int level) {
+    size_t cell = static_cast<size_t>(1) << level;
+    return (size + cell - 1) / cell;
+}
+
+
+int ImagePyramid::levelCount(size_t rows, size_t cols) {
+    int count = 1;
+    while (std::max(levelSize(rows, count - 1), levelSize(cols, count - 1)) > PYRAMID_TOP_SIZE) {
+        count++;
+    }
+    return count;
+}
+
+
+size_t ImagePyramid::fileSize(size_t rows, size_t cols) {
+    int levels = levelCount(rows, cols);
+    if (levels == 1) {
+        return 0;
+    }
+    size_t size = HEADER_SIZE;
+    for (int k = 1; k < levels; ++k) {
+        size += levelSize(rows, k) * levelSize(cols, k) * sizeof(float);
+    }
+    return size;
+}
+
+
+std::streamoff ImagePyramid::offset(int level, size_t row, size_t col) const {
+    std::streamoff pos = HEADER_SIZE;
+    for (int k = 1; k < level; ++k) {
+        pos += static_cast<std::streamoff>(levelSize(rows, k) * levelSize(cols, k) * sizeof(float));
+    }
+    return pos + static_cast<std::streamoff>((row * levelSize(cols, level) + col) * sizeof(float));
+}
+
+
+bool ImagePyramid::open(const std::string &path, size_t rows, size_t cols) {
+    close();
+    this->path = path;
+    this->rows = rows;
+    this->cols = cols;
+    fed = 0;
+    complete = false;
+
+    int levels = levelCount(rows, cols);
+    if (levels == 1) {
+        // the image is its own preview, nothing to store.
+        fed = rows;
+        opened = complete = true;
+        return true;
+    }
+
+    boost::system::error_code ec;
+    fs::path stored(path);
+    uintmax_t expected = static_cast<uintmax_t>(offset(levels, 0, 0));
+    if (fs::exists(stored, ec) && fs::file_size(stored, ec) == expected) {
+        file.open(path.c_str(), std::ios::in | std::ios::binary);
+        char magic[sizeof(IMAGE_MAGIC)];
+        uint64_t storedRows, storedCols;
+        file.read(magic, sizeof(magic));
+        if (file && std::equal(magic, magic + sizeof(magic), IMAGE_MAGIC) &&
+                read_value(file, storedRows) && read_value(file, storedCols) && storedRows == rows && storedCols == cols) {
+            // the modification time serves as last access time for the LRU eviction of the LodCache.
+            fs::last_write_time(stored, std::time(nullptr), ec);
+            fed = rows;
+            opened = complete = true;
+            return true;
+        }
+        file.close();
+        std::cerr << "ImagePyramid::open(): dropping unreadable entry " << path << std::endl;
+    }
+    fs::remove(stored, ec);
+
+    fs::create_directories(stored.parent_path(), ec);
+    std::string tmp = path + ".tmp";
+    file.open(tmp.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+        file.close();
+        std::cerr << "ImagePyramid::open(): cannot create " << tmp << std::endl;
+        return false;
+    }
+    file.write(IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    write_value<uint64_t>(file, rows);
+    write_value<uint64_t>(file, cols);
+
+    accumulators.resize(levels - 1);
+    for (int k = 0; k < levels - 1; ++k) {
+        Accumulator &acc = accumulators[k];
+        size_t width = levelSize(cols, k + 1);
+        acc.sum.assign(width, 0.0);
+        acc.count.assign(width, 0);
+        acc.out.resize(width);
+        acc.rowsIn = 0;
+        acc.rowsOut = 0;
+    }
+    opened = true;
+    return static_cast<bool>(file) || fail("cannot write");
+}
+
+
+void ImagePyramid::close() {
+    if (file.is_open()) {
+        file.close();
+    }
+    if (opened && !complete) {
+        // a partial build is of no use to anybody else.
+        boost::system::error_code ec;
+        fs::remove(fs::path(path + ".tmp"), ec);
+    }
+    accumulators.clear();
+    opened = false;
+    complete = false;
+}
+
+
+bool ImagePyramid::isOpen() const {
+    return opened;
+}
+
+
+bool ImagePyramid::isComplete() const {
+    return complete;
+}
+
+
+size_t ImagePyramid::rowsFed() const {
+    return fed;
+}
+
+
+size_t ImagePyramid::rowsDone(int level) const {
+    if (level == 0) {
+        return fed;
+    }
+    if (complete) {
+        return levelSize(rows, level);
+    }
+    if (!opened || level > static_cast<int>(accumulators.size())) {
+        return 0;
+    }
+    return accumulators[level - 1].rowsOut;
+}
+
+
+bool ImagePyramid::append(const double *values, size_t count, int level, std::vector<double> &produced, size_t &first) {
+    if (!opened || complete) {
+        return false;
+    }
+    first = rowsDone(level);
+    for (size_t r = 0; r < count && fed < rows; ++r) {
+        if (!accumulate(0, values + r * cols, level, produced)) {
+            return false;
+        }
+        fed++;
+    }
+    return fed < rows || finish();
+}
+
+
+bool ImagePyramid::accumulate(size_t level, const double *values, int wanted, std::vector<double> &produced) {
+    Accumulator &acc = accumulators[level];
+    size_t width = levelSize(cols, static_cast<int>(level));
+    for (size_t c = 0; c < width; ++c) {
+        if (!std::isnan(values[c])) {
+            acc.sum[c / 2] += values[c];
+            acc.count[c / 2]++;
+        }
+    }
+    acc.rowsIn++;
+    if (acc.rowsIn % 2 == 1 && acc.rowsIn < levelSize(rows, static_cast<int>(level))) {
+        return true;
+    }
+
+    // a pair of rows (or the odd last one) is complete.
+    size_t outWidth = acc.out.size();
+    floats.resize(outWidth);
+    for (size_t c = 0; c < outWidth; ++c) {
+        acc.out[c] = acc.count[c] > 0 ? acc.sum[c] / acc.count[c] : std::numeric_limits<double>::quiet_NaN();
+        floats[c] = static_cast<float>(acc.out[c]);
+    }
+    std::fill(acc.sum.begin(), acc.sum.end(), 0.0);
+    std::fill(acc.count.begin(), acc.count.end(), 0);
+
+    file.seekp(offset(static_cast<int>(level) + 1, acc.rowsOut, 0));
+    file.write(reinterpret_cast<const char*>(floats.data()), outWidth * sizeof(float));
+    if (!file) {
+        return fail("cannot write");
+    }
+    acc.rowsOut++;
+
+    if (static_cast<int>(level) + 1 == wanted) {
+        produced.insert(produced.end(), acc.out.begin(), acc.out.end());
+    }
+    if (level + 1 < accumulators.size()) {
+        return accumulate(level + 1, acc.out.data(), wanted, produced);
+    }
+    return true;
+}
+
+
+bool ImagePyramid::finish() {
+    file.close();
+    boost::system::error_code ec;
+    // written under a temporary name and renamed, so other loaders never see a partial entry.
+    fs::rename(fs::path(path + ".tmp"), fs::path(path), ec);
+    if (ec) {
+        return fail("cannot rename");
+    }
+    complete = true;
+    accumulators.clear();
+    file.open(path.c_str(), std::ios::in | std::ios::binary);
+    return static_cast<bool>(file) || fail("cannot reopen");
+}
+
+
+bool ImagePyramid::read(int level, size_t row, size_t col, size_t rows, size_t cols, double *dst) {
+    if (!opened || level < 1 || row + rows > rowsDone(level)) {
+        return false;
+    }
+    floats.resize(cols);
+    for (size_t r = 0; r < rows; ++r) {
+        file.clear();
+        file.seekg(offset(level, row + r, col));
+        file.read(reinterpret_cast<char*>(floats.data()), cols * sizeof(float));
+        if (!file) {
+            file.clear();
+            return false;
+        }
+        std::copy(floats.begin(), floats.end(), dst + r * cols);
+    }
+    return true;
+}
+
+
+bool ImagePyramid::fail(const char *what) {
+    std::cerr << "ImagePyramid: " << what << " " << path << std::endl;
+    close();
+    return false;
+}
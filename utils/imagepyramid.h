@@ -0,0 +1,100 @@
+#ifndef IMAGEPYRAMID_H
+#define IMAGEPYRAMID_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cstddef>
+
+
+/**
+ * @brief ImagePyramid: Mip-map levels of a 2D image kept in a file. Every cell of level k is the mean of the
+ * 2 x 2 cells of level k-1 below it (NaNs excluded), level 0 is the image itself and is not stored.
+ * The levels are built in a single pass over the image, fed in bands of whole rows, with one row of
+ * accumulators per level, so building and reading never hold more than a few rows of any level in memory.
+ */
+class ImagePyramid
+{
+public:
+    ImagePyramid();
+    ~ImagePyramid();
+
+    /**
+     * @brief open: opens the pyramid stored at path, or starts building it if the file is missing or does not match
+     * the image. The build is written to path + ".tmp" and renamed when it is complete.
+     * @return false if the file can neither be read nor written.
+     */
+    bool open(const std::string &path, size_t rows, size_t cols);
+
+    void close();
+
+    bool isOpen() const;
+    bool isComplete() const;
+
+    /**
+     * @brief rowsFed: the number of image rows fed with append() so far.
+     */
+    size_t rowsFed() const;
+
+    /**
+     * @brief rowsDone: the number of rows of a level that can be read already.
+     */
+    size_t rowsDone(int level) const;
+
+    /**
+     * @brief append: feeds the next count whole rows of the image.
+     * @param level: the rows of this level completed by the call are returned in produced, the first of them in first.
+     * @return false if writing failed, the pyramid is closed then.
+     */
+    bool append(const double *values, size_t count, int level, std::vector<double> &produced, size_t &first);
+
+    /**
+     * @brief read: reads rows x cols cells of a level > 0, beginning at cell (row, col). The rows have to be done.
+     */
+    bool read(int level, size_t row, size_t col, size_t rows, size_t cols, double *dst);
+
+    /**
+     * @brief levelCount: the number of levels including the image, the coarsest one is not larger than a preview.
+     * Only depends on the size of the image, so it can be used before the pyramid is built.
+     */
+    static int levelCount(size_t rows, size_t cols);
+
+    /**
+     * @brief levelSize: the number of cells of a level along a dimension of size cells in the image.
+     */
+    static size_t levelSize(size_t size, int level);
+
+    /**
+     * @brief fileSize: the number of bytes the stored pyramid of an image takes, 0 if it is not stored.
+     */
+    static size_t fileSize(size_t rows, size_t cols);
+
+private:
+    struct Accumulator {
+        std::vector<double> sum;
+        std::vector<unsigned int> count;
+        // the last completed row of the level above.
+        std::vector<double> out;
+        size_t rowsIn;
+        size_t rowsOut;
+    };
+
+    std::string path;
+    std::fstream file;
+    size_t rows;
+    size_t cols;
+    size_t fed;
+    bool opened;
+    bool complete;
+    // accumulators[k] collects level k+1 from the rows of level k.
+    std::vector<Accumulator> accumulators;
+    std::vector<float> floats;
+
+    std::streamoff offset(int level, size_t row, size_t col) const;
+    bool accumulate(size_t level, const double *values, int wanted, std::vector<double> &produced);
+    bool finish();
+    bool fail(const char *what);
+};
+
+#endif // IMAGEPYRAMID_H
@@ -0,0 +1,65 @@
+#ifndef LOADBUFFER_H
+#define LOADBUFFER_H
+
+#include <QSharedPointer>
+#include <QMetaType>
+#include <vector>
+
+
+/**
+ * @brief LoadBuffer: The preallocated storage a LoadThread fills in place, chunk by chunk.
+ * One buffer holds all channels of a request, they share the keys (the x-axis).
+ * The loader hands the shared buffer to the receivers after every chunk together with the range that became valid.
+ * Ranges that were handed out are never written again, so receivers may read them while the loader continues behind them.
+ * For a sampled dimension the keys are implicit: only the key of the first sample and the interval are stored, key() computes them.
+ */
+class LoadBuffer
+{
+public:
+    /**
+     * @param size: number of samples per channel.
+     * @param indices: the index every channel is delivered with, see LoadThread::dataReady().
+     */
+    LoadBuffer(size_t size, const std::vector<int> &indices) :
+        keys(size), values(indices.size(), std::vector<double>(size)), indices(indices),
+        firstKey(0), interval(0), implicitKeys(false) {}
+
+    /**
+     * @brief LoadBuffer: a buffer with implicit keys, keys stays empty.
+     * @param firstKey: the key of the first sample.
+     * @param interval: the distance between two samples.
+     */
+    LoadBuffer(size_t size, const std::vector<int> &indices, double firstKey, double interval) :
+        values(indices.size(), std::vector<double>(size)), indices(indices),
+        firstKey(firstKey), interval(interval), implicitKeys(true) {}
+
+    size_t size() const {
+        return values.empty() ? keys.size() : values[0].size();
+    }
+
+    size_t channelCount() const {
+        return values.size();
+    }
+
+    bool hasImplicitKeys() const {
+        return implicitKeys;
+    }
+
+    double key(size_t index) const {
+        return implicitKeys ? firstKey + index * interval : keys[index];
+    }
+
+    std::vector<double> keys;
+    std::vector<std::vector<double>> values;
+    std::vector<int> indices;
+    double firstKey;
+    double interval;
+
+private:
+    bool implicitKeys;
+};
+
+typedef QSharedPointer<LoadBuffer> LoadBufferPtr;
+Q_DECLARE_METATYPE(LoadBufferPtr)
+
+#endif // LOADBUFFER_H
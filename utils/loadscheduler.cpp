@@ -0,0 +1,246 @@
+#include "loadscheduler.h"
+#include "common/Common.hpp"
+#include <QSettings>
+#include <iostream>
+
+
+LoadJob::LoadJob(const void *owner, LoadPriority priority):
+    jobOwner(owner), jobPriority(static_cast<int>(priority)), cancelled(0) {
+}
+
+
+LoadJob::~LoadJob() {}
+
+
+void LoadJob::cancel() {
+    cancelled.store(1);
+}
+
+
+bool LoadJob::isCancelled() const {
+    return cancelled.load() != 0;
+}
+
+
+const void* LoadJob::owner() const {
+    return jobOwner;
+}
+
+
+LoadPriority LoadJob::priority() const {
+    return static_cast<LoadPriority>(jobPriority.load());
+}
+
+
+LoadScheduler::Worker::Worker(LoadScheduler *scheduler):
+    QThread(), scheduler(scheduler) {
+}
+
+
+void LoadScheduler::Worker::run() {
+    scheduler->work();
+}
+
+
+LoadScheduler& LoadScheduler::instance() {
+    static LoadScheduler scheduler;
+    return scheduler;
+}
+
+
+LoadScheduler::LoadScheduler() {
+    stopping = false;
+
+    QSettings settings;
+    settings.beginGroup(LOADER_GROUP);
+    int count = settings.value(LOADER_WORKER_COUNT, 2).toInt();
+    settings.endGroup();
+    if(count < 1) {
+        std::cerr << "LoadScheduler: worker count has to be at least 1." << std::endl;
+        count = 1;
+    }
+
+    for(int i=0; i<count; i++) {
+        workers.append(new Worker(this));
+        workers.last()->start(QThread::LowPriority);
+    }
+}
+
+
+LoadScheduler::~LoadScheduler() {
+    mutex.lock();
+    stopping = true;
+    for(int p=0; p<PRIORITY_COUNT; p++) {
+        queues[p].ring.clear();
+        queues[p].jobs.clear();
+    }
+    for(QSharedPointer<LoadJob> job : running) {
+        job->cancel();
+    }
+    jobAvailable.wakeAll();
+    mutex.unlock();
+
+    for(Worker *w : workers) {
+        w->wait();
+        delete w;
+    }
+}
+
+
+int LoadScheduler::workerCount() const {
+    QMutexLocker locker(&mutex);
+    return workers.size();
+}
+
+
+void LoadScheduler::submit(QSharedPointer<LoadJob> job) {
+    QMutexLocker locker(&mutex);
+    if(stopping) {
+        return;
+    }
+    enqueue(job, false);
+    jobAvailable.wakeOne();
+}
+
+
+void LoadScheduler::cancel(const void *owner, bool wait, bool prefetch) {
+    QMutexLocker locker(&mutex);
+
+    const int prefetchQueue = static_cast<int>(LoadPriority::Prefetch);
+    for(int p=0; p<PRIORITY_COUNT; p++) {
+        if(p == prefetchQueue && ! prefetch) {
+            continue;
+        }
+        queues[p].ring.removeAll(owner);
+        queues[p].jobs.remove(owner);
+    }
+    if(running.contains(owner)) {
+        QSharedPointer<LoadJob> job = running.value(owner);
+        if(prefetch || job->priority() != LoadPriority::Prefetch) {
+            job->cancel();
+        }
+    }
+
+    while(wait && running.contains(owner)) {
+        jobFinished.wait(&mutex);
+    }
+}
+
+
+void LoadScheduler::cancelPrefetch(const void *owner) {
+    QMutexLocker locker(&mutex);
+
+    Queue &queue = queues[static_cast<int>(LoadPriority::Prefetch)];
+    queue.ring.removeAll(owner);
+    queue.jobs.remove(owner);
+    if(running.contains(owner) && running.value(owner)->priority() == LoadPriority::Prefetch) {
+        running.value(owner)->cancel();
+    }
+}
+
+
+void LoadScheduler::setPriority(const void *owner, LoadPriority priority) {
+    QMutexLocker locker(&mutex);
+    if(priority == LoadPriority::Prefetch) {
+        return;
+    }
+
+    const int prefetchQueue = static_cast<int>(LoadPriority::Prefetch);
+    QList<QSharedPointer<LoadJob>> moved;
+    for(int p=0; p<PRIORITY_COUNT; p++) {
+        if(p == prefetchQueue || p == static_cast<int>(priority)) {
+            continue;
+        }
+        queues[p].ring.removeAll(owner);
+        moved.append(queues[p].jobs.take(owner));
+    }
+    // the jobs keep their order behind those already queued with the new priority.
+    for(QSharedPointer<LoadJob> job : moved) {
+        job->jobPriority.store(static_cast<int>(priority));
+        enqueue(job, false);
+    }
+    if(running.contains(owner)) {
+        QSharedPointer<LoadJob> job = running.value(owner);
+        if(job->priority() != LoadPriority::Prefetch) {
+            job->jobPriority.store(static_cast<int>(priority));
+        }
+    }
+    if(! moved.isEmpty()) {
+        jobAvailable.wakeOne();
+    }
+}
+
+
+void LoadScheduler::enqueue(QSharedPointer<LoadJob> job, bool front) {
+    Queue &queue = queues[static_cast<int>(job->priority())];
+    const void *owner = job->owner();
+
+    if(! queue.ring.contains(owner)) {
+        queue.ring.append(owner);
+    }
+    if(front) {
+        queue.jobs[owner].prepend(job);
+    } else {
+        queue.jobs[owner].append(job);
+    }
+}
+
+
+QSharedPointer<LoadJob> LoadScheduler::take() {
+    // highest priority first, round robin over the owners that are not busy.
+    for(int p=0; p<PRIORITY_COUNT; p++) {
+        Queue &queue = queues[p];
+        for(int i=0; i<queue.ring.size(); i++) {
+            const void *owner = queue.ring[i];
+            if(running.contains(owner)) {
+                continue;
+            }
+            queue.ring.removeAt(i);
+
+            QList<QSharedPointer<LoadJob>> &jobs = queue.jobs[owner];
+            QSharedPointer<LoadJob> job = jobs.takeFirst();
+            if(jobs.isEmpty()) {
+                queue.jobs.remove(owner);
+            } else {
+                queue.ring.append(owner);
+            }
+            return job;
+        }
+    }
+    return QSharedPointer<LoadJob>();
+}
+
+
+void LoadScheduler::work() {
+    mutex.lock();
+    while(! stopping) {
+        QSharedPointer<LoadJob> job = take();
+        if(job.isNull()) {
+            jobAvailable.wait(&mutex);
+            continue;
+        }
+        running.insert(job->owner(), job);
+        mutex.unlock();
+
+        bool more = false;
+        if(! job->isCancelled()) {
+            try {
+                more = job->step();
+            } catch (std::exception &e) {
+                std::cerr << "LoadScheduler: loading job failed: " << e.what() << std::endl;
+                more = false;
+            }
+        }
+
+        mutex.lock();
+        running.remove(job->owner());
+        if(more && ! job->isCancelled() && ! stopping) {
+            // the owner goes to the back of the ring, its job stays in front of its other jobs.
+            enqueue(job, true);
+        }
+        jobFinished.wakeAll();
+        // the owner may have queued jobs that had to wait for this one.
+        jobAvailable.wakeOne();
+    }
+    mutex.unlock();
+}
@@ -0,0 +1,124 @@
+#ifndef LOADSCHEDULER_H
+#define LOADSCHEDULER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QList>
+#include <QHash>
+#include <QSet>
+
+
+/**
+ * @brief LoadPriority: Order in which the LoadScheduler serves its jobs. Lower values go first.
+ */
+enum class LoadPriority : int {
+    Visible = 0, Background = 1, Prefetch = 2
+};
+
+
+/**
+ * @brief LoadJob: A piece of loading work that is executed step by step on the workers of the LoadScheduler.
+ * Between two steps the scheduler may run steps of other owners, so one step should not do much more than one chunk.
+ */
+class LoadJob
+{
+public:
+    /**
+     * @param owner: the object the job works for (e.g. a LoadThread). Jobs of one owner never run concurrently
+     *          and are interleaved round robin with the jobs of other owners of the same priority.
+     */
+    LoadJob(const void *owner, LoadPriority priority);
+    virtual ~LoadJob();
+
+    /**
+     * @brief step: does the next part of the work. Called on a worker thread.
+     * @return true if the job has more work and wants to be scheduled again.
+     */
+    virtual bool step() = 0;
+
+    void cancel();
+    bool isCancelled() const;
+
+    const void* owner() const;
+    LoadPriority priority() const;
+
+private:
+    friend class LoadScheduler;
+
+    const void *jobOwner;
+    // a LoadPriority, changed by the LoadScheduler while the job is queued or running, see LoadScheduler::setPriority().
+    QAtomicInt jobPriority;
+    QAtomicInt cancelled;
+};
+
+
+/**
+ * @brief LoadScheduler: The process wide pool of loading workers shared by all plotters.
+ * The number of workers is read from the settings (LOADER_GROUP/LOADER_WORKER_COUNT) when the scheduler is first used.
+ */
+class LoadScheduler
+{
+public:
+    static LoadScheduler& instance();
+    ~LoadScheduler();
+
+    void submit(QSharedPointer<LoadJob> job);
+
+    /**
+     * @brief cancel: drops all queued jobs of the owner and marks its running job as cancelled.
+     * @param wait: if true blocks until no job of the owner is running any more.
+     * @param prefetch: whether the jobs with LoadPriority::Prefetch are cancelled as well,
+     *          so a new request for visible data can leave the prefetching of its owner running.
+     */
+    void cancel(const void *owner, bool wait = false, bool prefetch = true);
+
+    /**
+     * @brief cancelPrefetch: drops the queued prefetch jobs of the owner and marks a running one as cancelled.
+     */
+    void cancelPrefetch(const void *owner);
+
+    /**
+     * @brief setPriority: moves the queued jobs of the owner to the priority, e.g. to LoadPriority::Background when its plot
+     * is hidden, and requeues its running job there after the current step. Prefetch jobs keep their priority.
+     */
+    void setPriority(const void *owner, LoadPriority priority);
+
+    int workerCount() const;
+
+private:
+    LoadScheduler();
+    LoadScheduler(const LoadScheduler&) = delete;
+    LoadScheduler& operator=(const LoadScheduler&) = delete;
+
+    class Worker : public QThread {
+    public:
+        Worker(LoadScheduler *scheduler);
+        void run() override;
+    private:
+        LoadScheduler *scheduler;
+    };
+
+    struct Queue {
+        QList<const void*> ring;
+        QHash<const void*, QList<QSharedPointer<LoadJob>>> jobs;
+    };
+
+    static const int PRIORITY_COUNT = 3;
+
+    mutable QMutex mutex;
+    QWaitCondition jobAvailable;
+    QWaitCondition jobFinished;
+    bool stopping;
+    QList<Worker*> workers;
+    Queue queues[PRIORITY_COUNT];
+    QHash<const void*, QSharedPointer<LoadJob>> running;
+
+    void work();
+    QSharedPointer<LoadJob> take();
+    void enqueue(QSharedPointer<LoadJob> job, bool front);
+};
+
+#endif // LOADSCHEDULER_H
@@ -1,211 +1,514 @@
 #include "loadthread.h"
-#include <QVector>
-#include <chrono>
-#include <thread>
+#include "blockcache.h"
+#include "lodcache.h"
+#include "dataconvert.h"
+#include "storagelayout.h"
+#include "tickindex.h"
+#include <QElapsedTimer>
+
+// a pan that pauses longer than this starts a new velocity estimate.
+static const double PAN_PAUSE_MS = 300;
+static const double PREFETCH_MIN_LEAD_MS = 500;
+static const double PREFETCH_MAX_WINDOWS = 8;
+// the read size adapts so that one step takes about this long.
+static const double TARGET_STEP_MS = 100;
+
+
+/**
+ * @brief LoadThreadJob: One request of a LoadThread. Each step delivers the next cached part of the request,
+ * loads one chunk of all channels, or feeds one chunk of all channels into their LodPyramids.
+ * A prefetch job only fills the SegmentCache of its loader and delivers nothing.
+ * Raw data is read through the BlockCache, which shares it with the other views of the array. The pyramids stream
+ * through the whole array once and read directly, so they do not push the blocks of the views out of the cache.
+ */
+class LoadThreadJob : public LoadJob
+{
+public:
+    LoadThreadJob(LoadThread *loader, LoadPriority priority, const nix::DataArray &array, nix::NDSize start, nix::NDSize extent,
+                  nix::Dimension dim, unsigned int dimNumber, std::vector<int> index2D, int level, unsigned int chunksize, int graphIndex);
+
+    bool step() override;
+
+    bool isPrefetch() const;
+
+private:
+    LoadThread *loader;
+    nix::DataArray array;
+    nix::NDSize start;
+    nix::NDSize extent;
+    nix::Dimension dim;
+    unsigned int dimNumber;
+    std::vector<int> channels;
+    int level;
+    unsigned int chunksize;
+    int graphIndex;
+
+    bool initialized;
+    bool oneD;
+    bool sampled;
+    double axisOffset;
+    double interval;
+    unsigned int xDimIndex;
+    unsigned int dataLength;
+    unsigned int offset;
+    unsigned int chunkLength;
+    unsigned int minChunkLength;
+    unsigned int maxChunkLength;
+    StorageLayout layout;
+    bool blockRead;
+    int minChannel;
+    int maxChannel;
+    size_t channel;
+    unsigned int position;
+    LoadBufferPtr buffer;
+    std::vector<double> chunkdata;
+    std::vector<double> blockData;
+    std::vector<std::vector<double>> columnData;
+    std::vector<char> nativeData;
+
+    void init();
+    LoadBufferPtr createBuffer(size_t size, const std::vector<int> &indices, unsigned int fileStart) const;
+    bool rawStep();
+    bool prefetchStep();
+    void readChunk(unsigned int bufferOffset, unsigned int fileStart, unsigned int count);
+    void readBlock(unsigned int bufferOffset, unsigned int fileStart, unsigned int count);
+    bool envelopeStep();
+    void buildChunk(const std::vector<size_t> &building);
+};
+
+
+LoadThreadJob::LoadThreadJob(LoadThread *loader, LoadPriority priority, const nix::DataArray &array, nix::NDSize start, nix::NDSize extent,
+                             nix::Dimension dim, unsigned int dimNumber, std::vector<int> index2D, int level, unsigned int chunksize, int graphIndex):
+    LoadJob(loader, priority), loader(loader), array(array), start(start), extent(extent), dim(dim), dimNumber(dimNumber),
+    channels(index2D), level(level), chunksize(chunksize), graphIndex(graphIndex) {
+    initialized = false;
+    channel = 0;
+    position = 0;
+}
 
 
-LoadThread::LoadThread(QObject *parent, unsigned int chunksize):
-    QThread(parent) {
-    abort = false;
-    restart = false;
-    this->chunksize = chunksize;
+void LoadThreadJob::init() {
+    oneD = array.dataExtent().size() == 1;
+    xDimIndex = oneD ? 0 : dimNumber-1;
+    dataLength = extent[xDimIndex];
+    offset = start[xDimIndex];
+
+    // the keys of a sampled dimension follow from offset and interval, they are neither read nor stored.
+    sampled = dim.dimensionType() == nix::DimensionType::Sample;
+    axisOffset = 0;
+    interval = 1;
+    if(sampled) {
+        nix::SampledDimension sd = dim.asSampledDimension();
+        interval = sd.samplingInterval();
+        if(sd.offset()) {
+            axisOffset = sd.offset().get();
+        }
+    }
+
+    //if index2D is empty do all.
+    if(oneD) {
+        channels = std::vector<int>(1, 0);
+    } else if(channels.size() == 0) {
+        channels.resize(array.dataExtent()[1-xDimIndex]);
+        for(unsigned int i=0; i< array.dataExtent()[1-xDimIndex]; i++) {
+            channels[i] = static_cast<int>(i);
+        }
+    }
+
+    // all channels are loaded together, the chunksize limits the samples of all channels in one step.
+    // reads never split less than one storage chunk, the length adapts to the measured speed in readChunk().
+    layout = StorageLayout::of(array);
+    chunkLength = std::max(1u, chunksize / static_cast<unsigned int>(channels.size()));
+    minChunkLength = static_cast<unsigned int>(layout.chunkExtent(xDimIndex));
+    maxChunkLength = std::max(4 * chunkLength, minChunkLength);
+    chunkLength = std::max(chunkLength, minChunkLength);
+
+    // one hyperslab over the range of the selected channels, unless the selection is too sparse to read the gaps.
+    minChannel = *std::min_element(channels.begin(), channels.end());
+    maxChannel = *std::max_element(channels.begin(), channels.end());
+    // a filtered storage chunk spanning several channels would be decompressed again for every channel read from it.
+    blockRead = ! oneD && channels.size() > 1 &&
+            (static_cast<size_t>(maxChannel - minChannel + 1) <= 2 * channels.size() ||
+             (layout.isFiltered() && layout.chunkExtent(1-xDimIndex) > 1));
+
+    if(array.id() != loader->pyramidArray) {
+        loader->pyramids.clear();
+        loader->pyramidArray = array.id();
+    }
+    // complete pyramids are kept by the LodCache, only those of the requested channels stay in memory.
+    for(QMap<int, LodPyramid>::iterator it = loader->pyramids.begin(); it != loader->pyramids.end();) {
+        if(it->isComplete() && std::find(channels.begin(), channels.end(), it.key()) == channels.end()) {
+            it = loader->pyramids.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    std::string segmentKey = array.id() + "/" + nix::util::numToStr(xDimIndex);
+    for(int c : channels) {
+        segmentKey += "," + nix::util::numToStr(c);
+    }
+    loader->segments.reset(segmentKey, channels.size());
+    initialized = true;
 }
 
-LoadThread::~LoadThread() {
-    mutex.lock();
-    abort = true;
-    condition.wakeOne();
-    mutex.unlock();
 
-    wait();
+LoadBufferPtr LoadThreadJob::createBuffer(size_t size, const std::vector<int> &indices, unsigned int fileStart) const {
+    if(sampled) {
+        return LoadBufferPtr(new LoadBuffer(size, indices, axisOffset + fileStart * interval, interval));
+    }
+    return LoadBufferPtr(new LoadBuffer(size, indices));
 }
 
 
-void LoadThread::run() {
-    while(! abort) {
+bool LoadThreadJob::isPrefetch() const {
+    return priority() == LoadPriority::Prefetch;
+}
 
-        mutex.lock();
-        if(restart) {
-            mutex.unlock();
-            restart=false;
-            continue;
-        }
 
-        nix::DataArray array = this->array;
-        nix::NDSize start = this->start;
-        nix::NDSize extent = this->extent;
-        unsigned int chunksize = this->chunksize;
-        int graphIndex = this->graphIndex;
-        nix::Dimension dim = this->dim;
-        mutex.unlock();
-
-        int dimCount = array.dataExtent().size();;
-
-        if(dimCount == 1) {
-            load1D(array, start, extent, dim, chunksize, graphIndex);
-        } else if(dimCount == 2) {
-            mutex.lock();
-            unsigned int dimNumber = this->dimNumber;
-            std::vector<int> index2D = this->index2D;
-            mutex.unlock();
-
-            load2D(array, start, extent, dim, dimNumber, index2D, chunksize, graphIndex);
-        }
+bool LoadThreadJob::step() {
+    if(! initialized) {
+        init();
+    }
+    if(channel >= channels.size()) {
+        return false;
+    }
+    if(isPrefetch()) {
+        return prefetchStep();
+    }
+    if(level >= 0) {
+        return envelopeStep();
+    }
+    return rawStep();
+}
 
-        mutex.lock();
-        if(! restart) {
-            condition.wait(&mutex);
-        } else {
-            restart = false;
+
+bool LoadThreadJob::rawStep() {
+    if(position >= dataLength) {
+        channel = channels.size();
+        return false;
+    }
+
+    if(position == 0) {
+        std::vector<int> indices(channels.size());
+        for(size_t i=0; i<channels.size(); i++) {
+            indices[i] = oneD ? graphIndex : graphIndex + channels[i];
         }
-        mutex.unlock();
+        buffer = createBuffer(dataLength, indices, offset);
     }
-}
+    //starts with 0 ends with one step below 1
+    emit(loader->progress(static_cast<double>(position) / dataLength, graphIndex));
 
+    unsigned int from = position;
+    unsigned int count = static_cast<unsigned int>(loader->segments.copy(offset + from, dataLength - from, *buffer, from));
 
-void LoadThread::load1D(nix::DataArray array, nix::NDSize start, nix::NDSize extent, nix::Dimension dim, unsigned int chunksize, int graphIndex) {
+    if(count == 0) {
+        // a gap: read up to the next cached segment, at most one chunk ending on a storage chunk boundary.
+        size_t gapEnd = std::min(loader->segments.nextSegment(offset + from), static_cast<size_t>(offset) + dataLength);
+        size_t readEnd = std::min(layout.alignedEnd(xDimIndex, offset + from, chunkLength), gapEnd);
+        count = static_cast<unsigned int>(readEnd - offset - from);
 
-    int dataLength = extent[0];
-    unsigned int offset = start[0];
-    int totalChunks = (dataLength / chunksize) + 1;
+        // read straight into the part of the buffer that belongs to this chunk.
+        readChunk(from, offset + from, count);
+        loader->segments.insert(offset + from, count, *buffer, from, offset, dataLength);
+    }
+    position += count;
 
-    if( dataLength / chunksize == static_cast<double>(dataLength) / chunksize) {
-        totalChunks = dataLength / chunksize;
+    // summarized while the chunk is still in the cache, the receivers only merge the summaries.
+    ChunkStats stats(static_cast<int>(buffer->channelCount()));
+    for(size_t i=0; i<buffer->channelCount(); i++) {
+        stats[static_cast<int>(i)] = nixview::util::value_stats(buffer->values[i].data() + from, count);
+    }
+    emit loader->dataReady(buffer, from, position, stats);
+
+    if(position >= dataLength) {
+        buffer.clear();
+        channel = channels.size();
+        return false;
     }
+    return true;
+}
 
-    extent[0] = chunksize;
-    std::vector<double> loadedData;
-    std::vector<double> chunkdata(chunksize);
 
-    bool brokenData = false;
-    for (int i=0; i<totalChunks; i++) {
-        mutex.lock();
-        if(restart) {
-            brokenData = true;
-            mutex.unlock();
-            break;
-        }
-        mutex.unlock();
+bool LoadThreadJob::prefetchStep() {
+    size_t begin = static_cast<size_t>(offset) + position;
+    size_t end = static_cast<size_t>(offset) + dataLength;
 
-        emit(progress(static_cast<double>(i)/totalChunks, graphIndex)); //starts with 0 ends with one step below 1
+    // what is cached already is skipped, only the gaps are read.
+    size_t cachedEnd = std::min(loader->segments.cachedUntil(begin), end);
+    if(cachedEnd == begin) {
+        size_t gapEnd = std::min(loader->segments.nextSegment(begin), end);
+        unsigned int count = static_cast<unsigned int>(std::min(layout.alignedEnd(xDimIndex, begin, chunkLength), gapEnd) - begin);
 
-        if(i == totalChunks-1) {
-            extent[0] = (dataLength - (totalChunks-1) * chunksize);
-            chunkdata.resize((dataLength - (totalChunks-1) * chunksize));
+        if(buffer.isNull() || buffer->size() < count) {
+            buffer = createBuffer(std::max(count, maxChunkLength), std::vector<int>(channels.size(), graphIndex), static_cast<unsigned int>(begin));
         }
-        start[0] = offset + i * chunksize;
-        array.getData(chunkdata,extent, start);
+        readChunk(0, begin, count);
+        loader->segments.insert(begin, count, *buffer, 0, offset, dataLength);
+        cachedEnd = begin + count;
+    }
+    position = static_cast<unsigned int>(cachedEnd - offset);
+
+    if(position >= dataLength) {
+        buffer.clear();
+        channel = channels.size();
+        return false;
+    }
+    return true;
+}
+
 
-        loadedData.insert(loadedData.end(), chunkdata.begin(), chunkdata.end());
+void LoadThreadJob::readChunk(unsigned int bufferOffset, unsigned int fileStart, unsigned int count) {
+    QElapsedTimer timer;
+    timer.start();
 
-        //loadedData.append(QVector<double>::fromStdVector(chunkdata));
+    if(blockRead) {
+        readBlock(bufferOffset, fileStart, count);
+    } else {
+        for(size_t i=0; i<channels.size(); i++) {
+            nix::NDSize chunkStart = start;
+            nix::NDSize chunkExtent = extent;
+            if(! oneD) {
+                chunkStart[1-xDimIndex] = channels[i];
+            }
+            chunkStart[xDimIndex] = fileStart;
+            chunkExtent[xDimIndex] = count;
+
+            BlockCache::read(array, buffer->values[i].data() + bufferOffset, chunkExtent, chunkStart);
+        }
+    }
+    if(! buffer->hasImplicitKeys()) {
+        LoadThread::getAxis(array, xDimIndex + 1, dim, buffer->keys.data() + bufferOffset, count, fileStart);
     }
 
-    if(! brokenData) {
-        QVector<double> axis(0);
-        getAxis(dim, axis, dataLength, offset);
+    qint64 nsecs = timer.nsecsElapsed();
+    loader->updateReadRate(count, nsecs);
 
-        emit dataReady(QVector<double>::fromStdVector(loadedData), axis, graphIndex);
+    if(nsecs > 0) {
+        double target = TARGET_STEP_MS * 1e6 / nsecs * count;
+        double length = std::min(std::max((chunkLength + target) / 2, static_cast<double>(minChunkLength)),
+                                 static_cast<double>(maxChunkLength));
+        chunkLength = static_cast<unsigned int>(length);
     }
 }
 
 
-void LoadThread::load2D(nix::DataArray array, nix::NDSize start, nix::NDSize extent, nix::Dimension dim, unsigned int xDim, std::vector<int> index2D, unsigned int chunksize, int graphIndex) {
+void LoadThreadJob::readBlock(unsigned int bufferOffset, unsigned int fileStart, unsigned int count) {
+    size_t span = maxChannel - minChannel + 1;
 
-    unsigned int xDimIndex = xDim-1;
-    unsigned int dataLength = extent[xDimIndex];
-    unsigned int offset = start[xDimIndex];
+    nix::NDSize blockStart(2), blockExtent(2);
+    blockStart[xDimIndex] = fileStart;
+    blockExtent[xDimIndex] = count;
+    blockStart[1-xDimIndex] = minChannel;
+    blockExtent[1-xDimIndex] = span;
 
-    int totalChunks;
-    if( dataLength / chunksize == static_cast<double>(dataLength) / chunksize) {
-        totalChunks = dataLength / chunksize;
-    } else {
-        totalChunks = dataLength / chunksize + 1;
-    }
+    blockData.resize(count * span);
+    BlockCache::read(array, blockData.data(), blockExtent, blockStart);
 
-    extent[xDimIndex] = chunksize;
-    QVector<double> chunkdata(chunksize);
+    std::vector<size_t> columns(channels.size());
+    std::vector<double*> dst(channels.size());
+    for(size_t i=0; i<channels.size(); i++) {
+        columns[i] = channels[i] - minChannel;
+        dst[i] = buffer->values[i].data() + bufferOffset;
+    }
 
-    //if index2D is empty do all.
-    if(index2D.size() == 0) {
-        index2D.resize(array.dataExtent()[1-xDimIndex]);
-        for(unsigned int i=0; i< array.dataExtent()[1-xDimIndex]; i++) {
-            index2D[i] = static_cast<int>(i);
+    if(xDimIndex == 0) {
+        // [samples x channels]: each channel is a strided column of the block.
+        nixview::util::deinterleave(blockData.data(), count, span, columns, dst.data());
+    } else {
+        // [channels x samples]: each channel already is a contiguous row of the block.
+        for(size_t i=0; i<channels.size(); i++) {
+            std::copy(blockData.begin() + columns[i] * count, blockData.begin() + (columns[i] + 1) * count, dst[i]);
         }
     }
+}
 
-    //iterate over given indices
-    for(unsigned int j=0; j<index2D.size(); j++) {
-        bool brokenData = false;
-        std::vector<double> loadedData;
 
-        start[1-xDimIndex] = index2D[j];
+bool LoadThreadJob::envelopeStep() {
+    nix::ndsize_t length = array.dataExtent()[xDimIndex];
 
-        mutex.lock();
-        if(restart) {
-            brokenData = true;
-            mutex.unlock();
-            break;
+    std::vector<size_t> building;
+    for(size_t i=channel; i<channels.size(); i++) {
+        LodPyramid &pyramid = loader->pyramids[channels[i]];
+        if(! pyramid.isComplete() && pyramid.samplesFed() == 0) {
+            LodCache::load(array, xDimIndex, channels[i], pyramid);
         }
-        mutex.unlock();
-
-        for (int i=0; i<totalChunks; i++) {
-            mutex.lock();
-            if(restart) {
-                brokenData = true;
-                mutex.unlock();
-                break;
+        if(! pyramid.isComplete()) {
+            if(pyramid.sampleCount() != length) {
+                pyramid.reset(length);
             }
-            mutex.unlock();
+            building.push_back(i);
+        }
+    }
+    if(! building.empty()) {
+        // one chunk of all unfinished channels per step, a cancelled build resumes at samplesFed() with the next request.
+        buildChunk(building);
+        for(size_t i : building) {
+            if(loader->pyramids[channels[i]].isComplete()) {
+                LodCache::store(array, xDimIndex, channels[i], loader->pyramids[channels[i]]);
+            }
+        }
+        return true;
+    }
 
-            emit(progress(static_cast<double>(i)*j / (totalChunks*index2D.size()), graphIndex)); //starts with 0 ends with one step below 1
+    int channelIndex = channels[channel];
+    int index = oneD ? graphIndex : graphIndex + channelIndex;
+    const LodPyramid &pyramid = loader->pyramids[channelIndex];
 
-            if(i == totalChunks-1) {
-                extent[xDimIndex] = (dataLength - (totalChunks-1) * chunksize);
-                chunkdata.resize((dataLength - (totalChunks-1) * chunksize));
-            }
-            start[xDimIndex] = offset + i * chunksize;
+    std::vector<double> sampleIndex, values;
+    pyramid.envelope(std::min(level, pyramid.levelCount()-1), offset, dataLength, sampleIndex, values);
+    if(sampleIndex.empty()) {
+        channel++;
+        return channel < channels.size();
+    }
 
-            array.getData(array.dataType(),chunkdata.data(),extent, start);
+    // the min/max points lie at a quarter and three quarters of their buckets, which is a regular grid of half a bucket.
+    // Only a shorter last bucket deviates from it, by less than a pixel.
+    double step = sampleIndex.size() > 1 ? sampleIndex[1] - sampleIndex[0] : 1;
+    LoadBufferPtr envelope(new LoadBuffer(0, std::vector<int>(1, index), axisOffset + sampleIndex[0] * interval, step * interval));
+    envelope->values[0].swap(values);
+
+    ChunkStats stats(1, nixview::util::value_stats(envelope->values[0].data(), envelope->size()));
+    emit loader->dataReady(envelope, 0, static_cast<int>(envelope->size()), stats);
+
+    channel++;
+    return channel < channels.size();
+}
 
-            loadedData.insert(loadedData.end(), chunkdata.begin(), chunkdata.end());
+
+void LoadThreadJob::buildChunk(const std::vector<size_t> &building) {
+    nix::NDSize shape = array.dataExtent();
+    nix::ndsize_t length = shape[xDimIndex];
+
+    // the pyramids of channels resumed from an earlier request may be ahead, the chunk starts at the one furthest behind.
+    nix::ndsize_t first = length;
+    int low = channels[building.front()], high = low;
+    for(size_t i : building) {
+        const LodPyramid &pyramid = loader->pyramids[channels[i]];
+        first = std::min(first, static_cast<nix::ndsize_t>(pyramid.samplesFed()));
+        low = std::min(low, channels[i]);
+        high = std::max(high, channels[i]);
+        emit(loader->progress(static_cast<double>(pyramid.samplesFed()) / length, oneD ? graphIndex : graphIndex + channels[i]));
+    }
+    size_t span = high - low + 1;
+    // the same choice as for the raw data in init(): one hyperslab over all channels unless the selection is sparse.
+    bool block = ! oneD && building.size() > 1 &&
+            (span <= 2 * building.size() || (layout.isFiltered() && layout.chunkExtent(1-xDimIndex) > 1));
+    size_t width = block ? span : 1;
+    nix::ndsize_t count = layout.alignedEnd(xDimIndex, first, std::max(static_cast<size_t>(1), chunksize / width)) - first;
+    count = std::min(count, length - first);
+
+    nix::NDSize chunkStart(shape.size(), 0);
+    nix::NDSize chunkExtent(shape.size(), 1);
+    chunkStart[xDimIndex] = first;
+    chunkExtent[xDimIndex] = count;
+
+    if(! block) {
+        // one column per channel, each from where its pyramid stands.
+        for(size_t i : building) {
+            LodPyramid &pyramid = loader->pyramids[channels[i]];
+            nix::ndsize_t fed = pyramid.samplesFed();
+            if(fed >= first + count) {
+                continue;
             }
+            if(! oneD) {
+                chunkStart[1-xDimIndex] = channels[i];
+            }
+            chunkStart[xDimIndex] = fed;
+            chunkExtent[xDimIndex] = first + count - fed;
+            chunkdata.resize(chunkExtent[xDimIndex]);
+            nixview::util::read_as_double(array, chunkdata.data(), chunkExtent, chunkStart, nativeData);
+            pyramid.append(chunkdata.data(), chunkdata.size());
+        }
+        return;
+    }
 
-        if(! brokenData) {
-            QVector<double> axis(0);
-            getAxis(dim, axis, dataLength, offset);
+    // [samples x channels] or [channels x samples]: all channels come out of the same read and decompression.
+    chunkStart[1-xDimIndex] = low;
+    chunkExtent[1-xDimIndex] = span;
+    blockData.resize(count * span);
+    nixview::util::read_as_double(array, blockData.data(), chunkExtent, chunkStart, nativeData);
+
+    std::vector<const double*> src(building.size());
+    if(xDimIndex == 0) {
+        std::vector<size_t> columns(building.size());
+        std::vector<double*> dst(building.size());
+        columnData.resize(building.size());
+        for(size_t b=0; b<building.size(); b++) {
+            columns[b] = channels[building[b]] - low;
+            columnData[b].resize(count);
+            dst[b] = columnData[b].data();
+            src[b] = dst[b];
+        }
+        nixview::util::deinterleave(blockData.data(), count, span, columns, dst.data());
+    } else {
+        for(size_t b=0; b<building.size(); b++) {
+            src[b] = blockData.data() + (channels[building[b]] - low) * count;
+        }
+    }
 
-            emit dataReady(QVector<double>::fromStdVector(loadedData), axis, graphIndex + index2D[j]);
+    for(size_t b=0; b<building.size(); b++) {
+        LodPyramid &pyramid = loader->pyramids[channels[building[b]]];
+        nix::ndsize_t skip = pyramid.samplesFed() - first;
+        if(skip < count) {
+            pyramid.append(src[b] + skip, count - skip);
         }
     }
 }
 
 
+LoadThread::LoadThread(QObject *parent, unsigned int chunksize):
+    QObject(parent), readRate(0) {
+    qRegisterMetaType<LoadBufferPtr>("LoadBufferPtr");
+    qRegisterMetaType<ChunkStats>("ChunkStats");
+    velocity = 0;
+    prefetchFirst = prefetchLast = -1;
+    pixelWidth = 0;
+    lodLevel = -1;
+    dimNumber = 1;
+    graphIndex = 0;
+    configured = false;
+    priority = LoadPriority::Visible;
+    this->chunksize = chunksize;
+}
 
-void LoadThread::getAxis(nix::Dimension dim, QVector<double> &axis, unsigned int count, unsigned int offset) {
+LoadThread::~LoadThread() {
+    // running jobs emit through this object, so wait for them to finish their current step.
+    LoadScheduler::instance().cancel(this, true);
+}
+
+
+void LoadThread::submit() {
+    LoadScheduler &scheduler = LoadScheduler::instance();
+    // the prefetching of this loader keeps running, it only fills the cache.
+    scheduler.cancel(this, false, false);
+    scheduler.submit(QSharedPointer<LoadJob>(new LoadThreadJob(this, priority, array, start, extent, dim, dimNumber,
+                                                               index2D, lodLevel, chunksize, graphIndex)));
+}
+
+
+void LoadThread::getAxis(const nix::DataArray &array, unsigned int dimNumber, nix::Dimension dim, double *axis, unsigned int count, unsigned int offset) {
 
     if(dim.dimensionType() == nix::DimensionType::Sample) {
-        axis = QVector<double>::fromStdVector(dim.asSampledDimension().axis(count, offset));
+        std::vector<double> ax = dim.asSampledDimension().axis(count, offset);
+        std::copy(ax.begin(), ax.end(), axis);
     } else if(dim.dimensionType() == nix::DimensionType::Range) {
-        axis = QVector<double>::fromStdVector(dim.asRangeDimension().axis(count, offset));
+        TickIndex::of(array, dimNumber)->ticks(offset, count, axis);
     } else {
-        axis.resize(count);
         for (unsigned int i=0; i<count; i++) {
-            axis[0] = i+offset;
+            axis[i] = i+offset;
         }
     }
 }
 
 
-void LoadThread::setVariables(const nix::DataArray &array, nix::NDSize start, nix::NDSize extent, nix::Dimension dim, std::vector<int> index2D, unsigned int dimNumber, int graphIndex) {
+void LoadThread::setVariables(const nix::DataArray &array, nix::NDSize start, nix::NDSize extent, nix::Dimension dim, std::vector<int> index2D, unsigned int dimNumber, int graphIndex,
+                              int level) {
 
     if(! testInput(array, start, extent)) {
         std::cerr << "LoadThread::setVariables(): Input not correct." << std::endl;
         return;
     }
 
-    QMutexLocker locker(&mutex); // locks the members and unlocks them when it goes out of scope.
-
     this->array = nix::DataArray(array);
     this->start = start;
     this->extent = extent;
@@ -213,13 +516,12 @@ void LoadThread::setVariables(const nix::DataArray &array, nix::NDSize start, ni
     this->index2D = index2D;
     this->dimNumber = dimNumber;
     this->dim = dim;
+    this->lodLevel = level;
+    this->configured = true;
 
-    if(! isRunning()) {
-        QThread::start(LowPriority);
-    } else {
-        this->restart = true;
-        condition.wakeOne();
-    }
+    LoadScheduler::instance().cancelPrefetch(this);
+    prefetchFirst = prefetchLast = -1;
+    submit();
 }
 
 void LoadThread::setVariables1D(const nix::DataArray &array, nix::NDSize start, nix::NDSize extent, nix::Dimension dim, int graphIndex) {
@@ -233,20 +535,18 @@ void LoadThread::setVariables1D(const nix::DataArray &array, nix::NDSize start,
         return;
     }
 
-    QMutexLocker locker(&mutex);
-
     this->array = nix::DataArray(array);
     this->start = start;
     this->extent = extent;
     this->dim = dim;
+    this->dimNumber = 1;
     this->graphIndex = graphIndex;
+    this->lodLevel = -1;
+    this->configured = true;
 
-    if(! isRunning()) {
-        QThread::start(LowPriority);
-    } else {
-        this->restart = true;
-        condition.wakeOne();
-    }
+    LoadScheduler::instance().cancelPrefetch(this);
+    prefetchFirst = prefetchLast = -1;
+    submit();
 }
 
 void LoadThread::setChuncksize(unsigned int size) {
@@ -255,38 +555,61 @@ void LoadThread::setChuncksize(unsigned int size) {
         return;
     }
 
-    mutex.lock();
     chunksize = size;
-    mutex.unlock();
 }
 
 
-void LoadThread::restartThread(nix::NDSize start, nix::NDSize extent) {
+void LoadThread::setPixelWidth(int width) {
+    pixelWidth = width;
+}
 
-    QMutexLocker locker(&mutex);
 
-    this->start = start;
-    this->extent = extent;
+void LoadThread::setPriority(LoadPriority priority) {
+    this->priority = priority;
+    LoadScheduler::instance().setPriority(this, priority);
+}
 
-    if(! isRunning()) {
+
+void LoadThread::restartThread(nix::NDSize start, nix::NDSize extent, int level) {
+
+    if(! configured) {
         std::cerr << "You have to call Loadthread::setVariables[1D]() first to set all needed members." << std::endl;
-    } else {
-        this->restart = true;
-        condition.wakeOne();
+        return;
     }
+
+    this->start = start;
+    this->extent = extent;
+    this->lodLevel = level;
+
+    submit();
 }
 
 
 void LoadThread::startLoadingIfNeeded(QCPRange range, int xDim, double dataMin, double dataMax, double meanPoints) {
-    mutex.lock();
     nix::DataArray array = this->array;
-    mutex.unlock();
+    int currentLevel = this->lodLevel;
 
-    if(dataMin == dataMax) {
+    trackPan(range);
+
+    int level = lodLevelFor(array, range, xDim);
+
+    if(dataMin == dataMax || level != currentLevel) {
         nix::NDSize start, extent;
 
-        calcStartExtent(array, start, extent, range, xDim);
-        restartThread(start, extent);
+        calcStartExtent(array, start, extent, range, xDim, level);
+        restartThread(start, extent, level);
+        return;
+    }
+
+    if(level >= 0) {
+        // envelopes have a fixed number of points per view: reload when the view comes closer than a quarter of its size to the loaded edge.
+        double margin = range.size() / 4;
+        if((range.lower - margin < dataMin && checkForMoreData(array, dataMin, false, xDim)) ||
+                (range.upper + margin > dataMax && checkForMoreData(array, dataMax, true, xDim))) {
+            nix::NDSize start, extent;
+            calcStartExtent(array, start, extent, range, xDim, level);
+            restartThread(start, extent, level);
+        }
         return;
     }
 
@@ -306,10 +629,91 @@ void LoadThread::startLoadingIfNeeded(QCPRange range, int xDim, double dataMin,
             restartThread(start, extent);
         }
     }
+
+    prefetch(range, xDim);
 }
 
 
-void LoadThread::calcStartExtent(const nix::DataArray &array, nix::NDSize &start_size, nix::NDSize &extent_size, QCPRange curRange, int xDim) {
+void LoadThread::trackPan(QCPRange range) {
+    double elapsed = panTimer.isValid() ? panTimer.nsecsElapsed() / 1e6 : -1;
+    panTimer.start();
+
+    bool zoomed = std::abs(range.size() - lastRange.size()) > range.size() * 0.01;
+    if(elapsed <= 0 || elapsed > PAN_PAUSE_MS || zoomed) {
+        velocity = 0;
+    } else {
+        double current = (range.center() - lastRange.center()) / elapsed;
+        velocity = velocity == 0 ? current : (velocity + current) / 2;
+    }
+    lastRange = range;
+}
+
+
+void LoadThread::prefetch(QCPRange range, int xDim) {
+    if(velocity == 0 || lodLevel >= 0 || array.getDimension(xDim).dimensionType() == nix::DimensionType::Set) {
+        return;
+    }
+
+    double windowStart, windowCount;
+    rangeToIndex(array, range, xDim, windowStart, windowCount);
+    if(windowCount < 1) {
+        return;
+    }
+
+    // the next window is needed about when reading one would be done, prefetch what the view travels in that time.
+    double rate = readRate.load();
+    double lead = rate > 0 ? std::max(PREFETCH_MIN_LEAD_MS, 2 * windowCount / rate) : PREFETCH_MIN_LEAD_MS;
+    double speed = std::abs(velocity) / range.size() * windowCount;
+    double ahead = std::min(speed * lead, PREFETCH_MAX_WINDOWS * windowCount);
+
+    double length = array.dataExtent()[xDim-1];
+    double first = velocity > 0 ? windowStart + windowCount : windowStart - ahead;
+    double last = std::min(first + ahead, length);
+    first = std::max(first, 0.0);
+    if(last - first < 1) {
+        return;
+    }
+    // only a new job if the prefetched range moved noticeably.
+    if(std::abs(first - prefetchFirst) < windowCount / 4 && std::abs(last - prefetchLast) < windowCount / 4) {
+        return;
+    }
+    prefetchFirst = first;
+    prefetchLast = last;
+
+    nix::NDSize start, extent;
+    indexToNDSize(array, first, last - first, xDim, start, extent);
+
+    LoadScheduler &scheduler = LoadScheduler::instance();
+    scheduler.cancelPrefetch(this);
+    scheduler.submit(QSharedPointer<LoadJob>(new LoadThreadJob(this, LoadPriority::Prefetch, array, start, extent, dim, dimNumber,
+                                                               index2D, -1, chunksize, graphIndex)));
+}
+
+
+void LoadThread::updateReadRate(unsigned int samples, qint64 nsecs) {
+    if(nsecs <= 0) {
+        return;
+    }
+    int rate = static_cast<int>(std::min(samples * 1e6 / nsecs, 1e9));
+    int old = readRate.load();
+    readRate.store(old == 0 ? rate : (old + rate) / 2);
+}
+
+
+int LoadThread::lodLevelFor(const nix::DataArray &array, QCPRange range, int xDim) {
+    int width = pixelWidth;
+
+    nix::Dimension d = array.getDimension(xDim);
+    if(width <= 0 || d.dimensionType() != nix::DimensionType::Sample) {
+        return -1;
+    }
+
+    double samplesPerPixel = range.size() / d.asSampledDimension().samplingInterval() / width;
+    return LodPyramid::levelFor(samplesPerPixel, array.dataExtent()[xDim-1]);
+}
+
+
+void LoadThread::calcStartExtent(const nix::DataArray &array, nix::NDSize &start_size, nix::NDSize &extent_size, QCPRange curRange, int xDim, int level) {
     nix::Dimension d = array.getDimension(xDim);
 
     double start, extent;
@@ -320,28 +724,15 @@ void LoadThread::calcStartExtent(const nix::DataArray &array, nix::NDSize &start
     } else {
         double pInRange;
         double startIndex;
-
-        if( d.dimensionType() == nix::DimensionType::Sample) {
-            nix::SampledDimension spd = d.asSampledDimension();
-            double samplingIntervall = spd.samplingInterval();
-            double offset = 0;
-            if(spd.offset()) {
-                offset = spd.offset().get();
-            }
-
-            startIndex = (curRange.lower - offset) / samplingIntervall;
-            pInRange = curRange.size() / samplingIntervall;
-
-        } else { // rangeDimension
-            nix::RangeDimension rd = d.asRangeDimension();
-            std::vector<double> ticks = rd.ticks();
-            startIndex = std::distance(ticks.cbegin(), std::lower_bound(ticks.cbegin(), ticks.cend(), curRange.lower));
-            pInRange   = std::distance(ticks.cbegin(), std::upper_bound(ticks.cbegin(), ticks.cend(), curRange.upper)) - startIndex;
-        }
+        rangeToIndex(array, curRange, xDim, startIndex, pInRange);
 
         double numOfPoints = static_cast<double>(chunksize) / 3;
 
-        if(pInRange <= numOfPoints) {
+        if(level >= 0) {
+            // an envelope of the view plus one view to each side.
+            start  = startIndex - pInRange;
+            extent = 3 * pInRange;
+        } else if(pInRange <= numOfPoints) {
             start  = startIndex - numOfPoints;
             extent =  numOfPoints + pInRange + numOfPoints;
 
@@ -354,6 +745,36 @@ void LoadThread::calcStartExtent(const nix::DataArray &array, nix::NDSize &start
         }
     }
 
+    indexToNDSize(array, start, extent, xDim, start_size, extent_size);
+}
+
+
+void LoadThread::rangeToIndex(const nix::DataArray &array, QCPRange range, int xDim, double &startIndex, double &count) {
+    nix::Dimension d = array.getDimension(xDim);
+
+    if( d.dimensionType() == nix::DimensionType::Sample) {
+        nix::SampledDimension spd = d.asSampledDimension();
+        double samplingIntervall = spd.samplingInterval();
+        double offset = 0;
+        if(spd.offset()) {
+            offset = spd.offset().get();
+        }
+
+        startIndex = (range.lower - offset) / samplingIntervall;
+        count = range.size() / samplingIntervall;
+
+    } else if( d.dimensionType() == nix::DimensionType::Range) {
+        TickIndexPtr ticks = TickIndex::of(array, xDim);
+        startIndex = static_cast<double>(ticks->lowerBound(range.lower));
+        count      = static_cast<double>(ticks->upperBound(range.upper)) - startIndex;
+    } else {
+        startIndex = 0;
+        count = array.dataExtent()[xDim-1];
+    }
+}
+
+
+void LoadThread::indexToNDSize(const nix::DataArray &array, double start, double extent, int xDim, nix::NDSize &start_size, nix::NDSize &extent_size) {
     start = std::floor(start);
     extent = std::ceil(extent);
 
@@ -392,10 +813,11 @@ bool LoadThread::checkForMoreData(const nix::DataArray &array, double currentExt
             return (d.asSampledDimension().axis(1,0)[0] < currentExtreme);
         }
     } else if(d.dimensionType() == nix::DimensionType::Range) {
+        TickIndexPtr ticks = TickIndex::of(array, xDim);
         if(higher) {
-            return (d.asRangeDimension().axis(1,array.dataExtent()[xDim-1]-1)[0] > currentExtreme);
+            return (ticks->last() > currentExtreme);
         } else {
-            return (d.asRangeDimension().axis(1,0)[0] < currentExtreme);
+            return (ticks->first() < currentExtreme);
         }
     } else {
         std::cerr << "LoadThread::CheckForMoreData(): unsupported dimension type." << std::endl;
@@ -1,30 +1,35 @@
 #ifndef LOADTHREAD_H
 #define LOADTHREAD_H
 
-#include <QThread>
-#include <QMutex>
-#include <QWaitCondition>
+#include <QObject>
+#include <QMap>
+#include <QElapsedTimer>
+#include <QAtomicInt>
 #include <nix.hpp>
 #include "../plotter/plotter.h"
+#include "lodpyramid.h"
+#include "loadscheduler.h"
+#include "loadbuffer.h"
+#include "valuestats.h"
+#include "segmentcache.h"
 
 
-class LoadThread: public QThread
+class LoadThread: public QObject
 {
     Q_OBJECT
 
 public:
     /**
-     * @brief LoadThread: A small thread made to easily load data for plots outside of the guiThread.
+     * @brief LoadThread: Loads the data of one plotted array outside of the guiThread.
+     * The work runs chunk by chunk on the workers of the shared LoadScheduler. Each new request replaces the pending one.
      * @param parent
-     * @param chunksize: The size the thread splits the work into. It emits the progress signal after each chunk.
+     * @param chunksize: The size the loader splits the work into. It emits the progress signal after each chunk.
      */
     LoadThread(QObject *parent = 0, unsigned int chunksize=1000000);
     ~LoadThread();
 
-    void run() override;
-
     /**
-     * @brief setVariables: The main way to interact with the thread. It sets all needed variables and starts the thread.
+     * @brief setVariables: The main way to interact with the loader. It sets all needed variables and submits the loading.
      * @param array: The array with the data to be loaded (currently max 2D)
      * @param start: nix::NDSize with the same dimensionality as the Array defining the offset/startIndex where the loading begins.
      * @param extent: nix::NDSize with the same dimensionality as the Array defining the length of data to get.
@@ -33,11 +38,13 @@ public:
      * @param dimNumber: The 'index' of the nix::Dimension to be used as the xAxis.
      * @param Index: An Index that will be givenin the signals to be able to use multiple threads at the same time.
      *          For 2D Arrays the Index is increassed by the index in second dimension of the loaded data.
+     * @param level: the LodPyramid level to load, -1 for the raw data.
      */
-    void setVariables(const nix::DataArray &array, nix::NDSize start, nix::NDSize extent, nix::Dimension dim, std::vector<int> index2D, unsigned int dimNumber, int Index);
+    void setVariables(const nix::DataArray &array, nix::NDSize start, nix::NDSize extent, nix::Dimension dim, std::vector<int> index2D, unsigned int dimNumber, int Index,
+                      int level = -1);
 
     /**
-     * @brief setVariables1D: A smaller setVariables for 1D Arrays that don't need all members. Also starts the thread.
+     * @brief setVariables1D: A smaller setVariables for 1D Arrays that don't need all members. Also submits the loading.
      * @param array: 1D DataArray to be loaded.
      * @param start: 1D nix::NDSize defining the startindex of the loading.
      * @param extent: 1D nix::NDSize defining the size of the part to be loaded.
@@ -47,30 +54,82 @@ public:
     void setVariables1D(const nix::DataArray &array, nix::NDSize start, nix::NDSize extent, nix::Dimension dim, int graphIndex);
 
     /**
-     * @brief setChuncksize: sets the chunksize of the thread. Defines the size of the parts the thread will split the work.
+     * @brief setChuncksize: sets the chunksize of the loader. Defines the size of the parts the loader will split the work.
      * @param size: cannot be 0
      */
     void setChuncksize(unsigned int size);
 
-    void restartThread(nix::NDSize start, nix::NDSize extent);
+    /**
+     * @brief setPixelWidth: sets the width of the plot area in pixels. A width > 0 enables level-of-detail loading:
+     * when more samples of a sampled dimension fall on one pixel than the finest LodPyramid level summarizes,
+     * min/max envelopes are delivered instead of the raw data.
+     * @param width: width in pixels, 0 disables the envelopes.
+     */
+    void setPixelWidth(int width);
+
+    /**
+     * @brief setPriority: sets the LoadPriority of the following and the pending requests, e.g. LoadPriority::Background while
+     * the plot is hidden.
+     */
+    void setPriority(LoadPriority priority);
+
+    /**
+     * @brief restartThread: restarts the loading with a new start and extent.
+     * @param level: the LodPyramid level to load, -1 for the raw data.
+     */
+    void restartThread(nix::NDSize start, nix::NDSize extent, int level = -1);
     void startLoadingIfNeeded(QCPRange range, int xDim, double dataMin, double dataMax, double meanPoints);
-    void calcStartExtent(const nix::DataArray &array, nix::NDSize &start_size, nix::NDSize& extent_size, QCPRange curRange, int xDim);
+    void calcStartExtent(const nix::DataArray &array, nix::NDSize &start_size, nix::NDSize& extent_size, QCPRange curRange, int xDim, int level = -1);
     bool checkForMoreData(const nix::DataArray &array, double currentExtreme, bool higher, int xDim);
 
+    /**
+     * @brief lodLevelFor: the LodPyramid level that fits the given range into the current pixel width.
+     * @return the level or -1 if the raw data should be loaded.
+     */
+    int lodLevelFor(const nix::DataArray &array, QCPRange range, int xDim);
+
 private:
-    void getAxis(nix::Dimension dim, QVector<double> &axis, unsigned int count, unsigned int offset);
+    friend class LoadThreadJob;
+
+    /**
+     * @brief getAxis: writes count keys of the dimension beginning at offset to axis. Ticks of a RangeDimension come from its TickIndex.
+     * @param dimNumber: the index of dim in the array (starting with 1).
+     */
+    static void getAxis(const nix::DataArray &array, unsigned int dimNumber, nix::Dimension dim, double *axis, unsigned int count, unsigned int offset);
+    static void rangeToIndex(const nix::DataArray &array, QCPRange range, int xDim, double &startIndex, double &count);
+    static void indexToNDSize(const nix::DataArray &array, double start, double extent, int xDim, nix::NDSize &start_size, nix::NDSize &extent_size);
     bool testInput(const nix::DataArray &array, nix::NDSize start, nix::NDSize extent);
-    void load1D(nix::DataArray array, nix::NDSize start, nix::NDSize extent, nix::Dimension dim, unsigned int chunksize, int graphIndex);
-    void load2D(nix::DataArray array, nix::NDSize start, nix::NDSize extent, nix::Dimension dim,  unsigned int dimNumber, std::vector<int> index2D, unsigned int chunksize, int Index);
+    void submit();
+
+    /**
+     * @brief trackPan: estimates the pan velocity from the successive ranges of the view.
+     */
+    void trackPan(QCPRange range);
+
+    /**
+     * @brief prefetch: while the view pans, loads the data ahead of it into the SegmentCache with LoadPriority::Prefetch.
+     * The prefetched distance is what the view travels in the time reading a window takes (at least PREFETCH_MIN_LEAD_MS).
+     */
+    void prefetch(QCPRange range, int xDim);
+
+    /**
+     * @brief updateReadRate: called by the jobs after each read to keep the measured samples per millisecond.
+     */
+    void updateReadRate(unsigned int samples, qint64 nsecs);
 
 signals:
     /**
-     * @brief dataReady: Signal that is triggered after the thread finished loading the data.
-     * @param data: the data that was loaded.
-     * @param axis: the corresponding part of the given x-axis fitting to the part of the data
-     * @param index: 1D: the index given at the start, 2D: the index given at the start + the index of the second dimension.
+     * @brief dataReady: Signal that is triggered after each loaded chunk, so the data can be shown while it is loading.
+     * @param buffer: the buffer of the request with the data of all channels (values) and the corresponding part of the x-axis (keys).
+     *          The keys of a sampled dimension are implicit, use buffer->key().
+     *          It is allocated for the whole request and shared with the loader, nothing is copied.
+     *          The index of each channel (buffer->indices) is 1D: the index given at the start,
+     *          2D: the index given at the start + the index of the second dimension.
+     * @param from: first index of the buffer that became valid with this chunk.
+     * @param to: index behind the last valid one. to == buffer->size() marks the last chunk of the request.
+     * @param stats: the ValueStats of [from, to) of every channel, computed by the loader right after reading the chunk.
      */
-    void dataReady(const QVector<double> &data, const QVector<double> &axis, int index);
+    void dataReady(const LoadBufferPtr &buffer, int from, int to, const ChunkStats &stats);
     /**
      * @brief progress: Signal triggerd after each chunk a part of the data is loaded.
      * @param percent: number between 0-1. Starts at 0 and ends one step bevor 1.
@@ -79,8 +138,6 @@ signals:
     void progress(double percent, int index);
 
 private:
-    QMutex mutex;
-    QWaitCondition condition;
     nix::DataArray array;
     nix::NDSize start;
     nix::NDSize extent;
@@ -89,8 +146,22 @@ private:
     unsigned int dimNumber;
     std::vector<int> index2D;
     int graphIndex;
-    bool abort;
-    bool restart;
+    int pixelWidth;
+    int lodLevel;
+    bool configured;
+    LoadPriority priority;
+
+    // only touched by the jobs of this loader, which the LoadScheduler never runs concurrently.
+    std::string pyramidArray;
+    QMap<int, LodPyramid> pyramids;
+    SegmentCache segments;
+    QAtomicInt readRate;
+
+    QElapsedTimer panTimer;
+    QCPRange lastRange;
+    double velocity;
+    double prefetchFirst;
+    double prefetchLast;
 };
 
 #endif // LOADTHREAD_H
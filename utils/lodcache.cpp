@@ -0,0 +1,166 @@
+#include "lodcache.h"
+#include "common/Common.hpp"
+#include <QCryptographicHash>
+#include <QSettings>
+#include <QStandardPaths>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <ctime>
+
+namespace fs = boost::filesystem;
+
+QMutex LodCache::mutex;
+std::string LodCache::filePath;
+
+
+void LodCache::setFile(const std::string &path) {
+    QMutexLocker locker(&mutex);
+    filePath = path;
+}
+
+
+QString LodCache::directory() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/lod";
+}
+
+
+qint64 LodCache::maxSize() {
+    QSettings settings;
+    settings.beginGroup(LOD_CACHE_GROUP);
+    qint64 megabytes = settings.value(LOD_CACHE_SIZE, 1024).toLongLong();
+    settings.endGroup();
+    return megabytes * 1024 * 1024;
+}
+
+
+std::string LodCache::entryPath(const nix::DataArray &array, unsigned int xDimIndex, int channel) {
+    return keyPath(array, QString::number(xDimIndex) + "\n" + QString::number(channel));
+}
+
+
+std::string LodCache::imageEntryPath(const nix::DataArray &array) {
+    return keyPath(array, "image");
+}
+
+
+std::string LodCache::eventEntryPath(const nix::DataArray &array) {
+    return keyPath(array, "events");
+}
+
+
+std::string LodCache::keyPath(const nix::DataArray &array, const QString &suffix) {
+    std::string file;
+    {
+        QMutexLocker locker(&mutex);
+        file = filePath;
+    }
+    QString key = QString::fromStdString(file) + "\n" + QString::fromStdString(array.id()) + "\n" +
+                  QString::number(static_cast<qint64>(array.updatedAt())) + "\n" + suffix;
+    QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+
+    return (directory() + "/" + QString::fromLatin1(hash) + ".lod").toStdString();
+}
+
+
+bool LodCache::load(const nix::DataArray &array, unsigned int xDimIndex, int channel, LodPyramid &pyramid) {
+    fs::path path(entryPath(array, xDimIndex, channel));
+    boost::system::error_code ec;
+    if (!fs::exists(path, ec)) {
+        return false;
+    }
+
+    std::ifstream in(path.string().c_str(), std::ios::binary);
+    if (!in || !pyramid.load(in) || pyramid.sampleCount() != array.dataExtent()[xDimIndex]) {
+        std::cerr << "LodCache::load(): dropping unreadable entry " << path.string() << std::endl;
+        in.close();
+        fs::remove(path, ec);
+        pyramid.reset(0);
+        return false;
+    }
+    // the modification time serves as last access time for the LRU eviction.
+    fs::last_write_time(path, std::time(nullptr), ec);
+    return true;
+}
+
+
+void LodCache::store(const nix::DataArray &array, unsigned int xDimIndex, int channel, const LodPyramid &pyramid) {
+    if (!pyramid.isComplete()) {
+        return;
+    }
+    fs::path path(entryPath(array, xDimIndex, channel));
+    fs::path tmp(path.string() + ".tmp");
+
+    if (static_cast<qint64>(pyramid.storedSize()) > maxSize()) {
+        std::cerr << "LodCache::store(): the pyramid of " << array.name() << " takes " << pyramid.storedSize() / (1024 * 1024)
+                  << " MB, more than the cache may hold. It is not stored." << std::endl;
+        return;
+    }
+
+    boost::system::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    if (ec) {
+        std::cerr << "LodCache::store(): cannot create cache directory " << path.parent_path().string() << std::endl;
+        return;
+    }
+
+    {
+        std::ofstream out(tmp.string().c_str(), std::ios::binary | std::ios::trunc);
+        if (!out || !pyramid.save(out)) {
+            out.close();
+            fs::remove(tmp, ec);
+            return;
+        }
+    }
+    // written under a temporary name and renamed, so other loaders never see a partial entry.
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return;
+    }
+    evict(path.string());
+}
+
+
+void LodCache::evict(const std::string &keep) {
+    QMutexLocker locker(&mutex);
+
+    fs::path dir(directory().toStdString());
+    boost::system::error_code ec;
+
+    std::vector<std::pair<std::time_t, fs::path>> entries;
+    uintmax_t total = 0;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != ".lod") {
+            continue;
+        }
+        bool kept = it->path() == fs::path(keep);
+        uintmax_t size = fs::file_size(it->path(), ec);
+        if (ec) {
+            ec.clear();
+            continue;
+        }
+        total += size;
+        if (!kept) {
+            entries.push_back(std::make_pair(fs::last_write_time(it->path(), ec), it->path()));
+        }
+        ec.clear();
+    }
+
+    uintmax_t limit = static_cast<uintmax_t>(maxSize());
+    if (total <= limit) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end());
+    for (const auto &entry : entries) {
+        if (total <= limit) {
+            break;
+        }
+        uintmax_t size = fs::file_size(entry.second, ec);
+        if (!ec && fs::remove(entry.second, ec)) {
+            total -= size;
+        }
+        ec.clear();
+    }
+}
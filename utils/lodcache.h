@@ -0,0 +1,66 @@
+#ifndef LODCACHE_H
+#define LODCACHE_H
+
+#include <QMutex>
+#include <QString>
+#include <nix.hpp>
+#include "lodpyramid.h"
+
+
+/**
+ * @brief LodCache: Persistent sidecar cache for LodPyramids.
+ * Pyramids are stored as one file per (file path, DataArray id, updatedAt, x-dimension, channel) in the user's
+ * cache directory, so a modified DataArray gets a new key and is rebuilt. The directory is kept below a size cap
+ * (settings: LOD_CACHE_GROUP/LOD_CACHE_SIZE in MB) by evicting the least recently used entries.
+ */
+class LodCache
+{
+public:
+    /**
+     * @brief setFile: sets the path of the currently opened nix file, part of every key.
+     */
+    static void setFile(const std::string &path);
+
+    /**
+     * @brief load: looks up the pyramid of a channel and marks the entry as recently used.
+     * @param xDimIndex: index (starting with 0) of the dimension the pyramid runs along.
+     * @param channel: index in the other dimension of a 2D array, 0 for 1D arrays.
+     * @return true if a complete pyramid was read into pyramid.
+     */
+    static bool load(const nix::DataArray &array, unsigned int xDimIndex, int channel, LodPyramid &pyramid);
+
+    /**
+     * @brief store: writes a complete pyramid and evicts old entries if the cache exceeds its size.
+     * A pyramid larger than the size cap is not stored.
+     */
+    static void store(const nix::DataArray &array, unsigned int xDimIndex, int channel, const LodPyramid &pyramid);
+
+    /**
+     * @brief imageEntryPath: the path of the ImagePyramid of a 2D array. Image pyramids are written by the ImagePyramid
+     * itself and share the directory, the size cap and the eviction with the LodPyramids.
+     */
+    static std::string imageEntryPath(const nix::DataArray &array);
+
+    /**
+     * @brief eventEntryPath: the path of the EventCounts of an event array, written by the EventCounts like imageEntryPath().
+     */
+    static std::string eventEntryPath(const nix::DataArray &array);
+
+    /**
+     * @brief evict: removes the least recently used entries until the cache is below its size cap.
+     * @param keep: the path of an entry that was just written, it is never removed.
+     */
+    static void evict(const std::string &keep = std::string());
+
+    static QString directory();
+    static qint64 maxSize();
+
+private:
+    static QMutex mutex;
+    static std::string filePath;
+
+    static std::string entryPath(const nix::DataArray &array, unsigned int xDimIndex, int channel);
+    static std::string keyPath(const nix::DataArray &array, const QString &suffix);
+};
+
+#endif // LODCACHE_H
@@ -0,0 +1,306 @@
+#include "lodpyramid.h"
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+
+static const size_t MIN_TOP_BUCKETS = 64;
+// level 0 has at most this many buckets, zooms finer than it read the raw data.
+static const size_t MAX_BASE_BUCKETS = 1 << 20;
+static const char LOD_MAGIC[8] = {'N', 'V', 'L', 'O', 'D', '0', '0', '2'};
+
+
+static size_t first_bucket(size_t count, unsigned int baseBucket, unsigned int factor) {
+    size_t bucket = baseBucket;
+    while ((count + bucket - 1) / bucket > MAX_BASE_BUCKETS) {
+        bucket *= factor;
+    }
+    return bucket;
+}
+
+
+template<typename T>
+static void write_value(std::ostream &out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+template<typename T>
+static bool read_value(std::istream &in, T &value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+
+LodPyramid::LodPyramid(unsigned int baseBucket, unsigned int factor) {
+    this->baseBucket = baseBucket < 2 ? 2 : baseBucket;
+    this->factor = factor < 2 ? 2 : factor;
+    reset(0);
+}
+
+
+void LodPyramid::reset(size_t count) {
+    this->count = count;
+    fed = 0;
+    complete = false;
+    levels.clear();
+
+    curMin = std::numeric_limits<double>::infinity();
+    curMax = -std::numeric_limits<double>::infinity();
+    curMinPos = curMaxPos = curFill = 0;
+
+    Level base;
+    base.bucket = first_bucket(count, baseBucket, factor);
+    size_t buckets = count / base.bucket + 1;
+    base.min.reserve(buckets);
+    base.max.reserve(buckets);
+    base.minFirst.reserve(buckets);
+    levels.push_back(base);
+}
+
+
+void LodPyramid::append(const double *data, size_t n) {
+    if (complete) {
+        return;
+    }
+    if (fed + n > count) {
+        n = count - fed;
+    }
+
+    const size_t bucket = levels[0].bucket;
+    for (size_t i = 0; i < n; i++) {
+        double v = data[i];
+        // NaN compares false and is skipped
+        if (v < curMin) {
+            curMin = v;
+            curMinPos = curFill;
+        }
+        if (v > curMax) {
+            curMax = v;
+            curMaxPos = curFill;
+        }
+        if (++curFill == bucket) {
+            flushBucket();
+        }
+    }
+    fed += n;
+
+    if (fed >= count) {
+        finish();
+    }
+}
+
+
+void LodPyramid::flushBucket() {
+    Level &base = levels[0];
+    base.min.push_back(curMin);
+    base.max.push_back(curMax);
+    base.minFirst.push_back(curMinPos <= curMaxPos);
+
+    curMin = std::numeric_limits<double>::infinity();
+    curMax = -std::numeric_limits<double>::infinity();
+    curMinPos = curMaxPos = curFill = 0;
+}
+
+
+void LodPyramid::finish() {
+    if (complete) {
+        return;
+    }
+    if (curFill > 0) {
+        flushBucket();
+    }
+    while (levels.back().min.size() > MIN_TOP_BUCKETS) {
+        buildLevel();
+    }
+    complete = true;
+}
+
+
+void LodPyramid::buildLevel() {
+    const Level &below = levels.back();
+    Level next;
+    next.bucket = below.bucket * factor;
+
+    size_t n = (below.min.size() + factor - 1) / factor;
+    next.min.resize(n);
+    next.max.resize(n);
+    next.minFirst.resize(n);
+
+    for (size_t b = 0; b < n; b++) {
+        size_t first = b * factor;
+        size_t last = std::min(first + factor, below.min.size());
+        size_t minChild = first, maxChild = first;
+        for (size_t c = first + 1; c < last; c++) {
+            if (below.min[c] < below.min[minChild]) {
+                minChild = c;
+            }
+            if (below.max[c] > below.max[maxChild]) {
+                maxChild = c;
+            }
+        }
+        next.min[b] = below.min[minChild];
+        next.max[b] = below.max[maxChild];
+        next.minFirst[b] = minChild == maxChild ? below.minFirst[minChild] : minChild < maxChild;
+    }
+    levels.push_back(next);
+}
+
+
+bool LodPyramid::isComplete() const {
+    return complete;
+}
+
+
+size_t LodPyramid::sampleCount() const {
+    return count;
+}
+
+
+size_t LodPyramid::samplesFed() const {
+    return fed;
+}
+
+
+int LodPyramid::levelCount() const {
+    return static_cast<int>(levels.size());
+}
+
+
+size_t LodPyramid::bucketSize(int level) const {
+    return levels[level].bucket;
+}
+
+
+size_t LodPyramid::bucketCount(int level) const {
+    return levels[level].min.size();
+}
+
+
+int LodPyramid::levelFor(double samplesPerPixel, size_t count, unsigned int baseBucket, unsigned int factor) {
+    // mirrors reset() and finish(): a further level exists as long as the one below has more than MIN_TOP_BUCKETS buckets
+    size_t first = first_bucket(count, baseBucket < 2 ? 2 : baseBucket, factor < 2 ? 2 : factor);
+    if (samplesPerPixel < first) {
+        return -1;
+    }
+    int level = 0;
+    double bucket = static_cast<double>(first);
+    size_t buckets = (count + first - 1) / first;
+    while (buckets > MIN_TOP_BUCKETS && bucket * factor <= samplesPerPixel) {
+        bucket *= factor;
+        buckets = (buckets + factor - 1) / factor;
+        level++;
+    }
+    return level;
+}
+
+
+void LodPyramid::envelope(int level, size_t start, size_t extent, std::vector<double> &index, std::vector<double> &values) const {
+    index.clear();
+    values.clear();
+    if (level < 0 || level >= levelCount() || extent == 0 || start >= count) {
+        return;
+    }
+
+    const Level &l = levels[level];
+    size_t first = start / l.bucket;
+    size_t last = std::min((start + extent - 1) / l.bucket, l.min.size() - 1);
+
+    index.reserve(2 * (last - first + 1));
+    values.reserve(2 * (last - first + 1));
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (size_t b = first; b <= last; b++) {
+        double base = static_cast<double>(b * l.bucket);
+        double span = static_cast<double>(std::min(l.bucket, count - b * l.bucket));
+        bool valid = l.min[b] <= l.max[b];
+        double lo = valid ? l.min[b] : nan;
+        double hi = valid ? l.max[b] : nan;
+
+        index.push_back(base + span / 4);
+        index.push_back(base + 3 * span / 4);
+        if (l.minFirst[b]) {
+            values.push_back(lo);
+            values.push_back(hi);
+        } else {
+            values.push_back(hi);
+            values.push_back(lo);
+        }
+    }
+}
+
+
+
+bool LodPyramid::save(std::ostream &out) const {
+    if (!complete) {
+        return false;
+    }
+    out.write(LOD_MAGIC, sizeof(LOD_MAGIC));
+    write_value<uint32_t>(out, baseBucket);
+    write_value<uint32_t>(out, factor);
+    write_value<uint64_t>(out, count);
+    write_value<uint32_t>(out, static_cast<uint32_t>(levels.size()));
+
+    for (const Level &l : levels) {
+        write_value<uint64_t>(out, l.bucket);
+        write_value<uint64_t>(out, l.min.size());
+        out.write(reinterpret_cast<const char*>(l.min.data()), l.min.size() * sizeof(double));
+        out.write(reinterpret_cast<const char*>(l.max.data()), l.max.size() * sizeof(double));
+        out.write(l.minFirst.data(), l.minFirst.size());
+    }
+    return static_cast<bool>(out);
+}
+
+
+size_t LodPyramid::storedSize() const {
+    size_t size = sizeof(LOD_MAGIC) + 2 * sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t);
+    for (const Level &l : levels) {
+        size += 2 * sizeof(uint64_t) + l.min.size() * (2 * sizeof(double) + 1);
+    }
+    return size;
+}
+
+
+bool LodPyramid::load(std::istream &in) {
+    char magic[sizeof(LOD_MAGIC)];
+    uint32_t base, fac, levelCount;
+    uint64_t samples;
+
+    in.read(magic, sizeof(magic));
+    if (!in || !std::equal(magic, magic + sizeof(magic), LOD_MAGIC) ||
+            !read_value(in, base) || !read_value(in, fac) || !read_value(in, samples) || !read_value(in, levelCount) ||
+            base != baseBucket || fac != factor) {
+        reset(0);
+        return false;
+    }
+
+    std::vector<Level> loaded(levelCount);
+    for (Level &l : loaded) {
+        uint64_t bucket, n;
+        if (!read_value(in, bucket) || !read_value(in, n) || n > samples / 2 + 1) {
+            reset(0);
+            return false;
+        }
+        if (&l == &loaded.front() && bucket != first_bucket(samples, baseBucket, factor)) {
+            reset(0);
+            return false;
+        }
+        l.bucket = bucket;
+        l.min.resize(n);
+        l.max.resize(n);
+        l.minFirst.resize(n);
+        in.read(reinterpret_cast<char*>(l.min.data()), n * sizeof(double));
+        in.read(reinterpret_cast<char*>(l.max.data()), n * sizeof(double));
+        in.read(l.minFirst.data(), n);
+        if (!in) {
+            reset(0);
+            return false;
+        }
+    }
+
+    reset(samples);
+    levels.swap(loaded);
+    fed = count;
+    complete = true;
+    return true;
+}
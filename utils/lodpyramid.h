@@ -0,0 +1,100 @@
+#ifndef LODPYRAMID_H
+#define LODPYRAMID_H
+
+#include <vector>
+#include <cstddef>
+#include <iostream>
+
+
+/**
+ * @brief LodPyramid: Multi-resolution min/max envelopes of a 1D signal.
+ * Level 0 summarizes buckets of baseBucket samples, every further level merges factor buckets of the level below.
+ * For a long signal the buckets of level 0 are widened by factor until it has at most MAX_BASE_BUCKETS (about 1M) buckets,
+ * so a pyramid stays in the tens of MB in memory and on disk. Zooms finer than level 0 read the raw data.
+ * The pyramid is fed block by block in sample order so it can be built while streaming the data from disk.
+ */
+class LodPyramid
+{
+public:
+    LodPyramid(unsigned int baseBucket = 16, unsigned int factor = 4);
+
+    /**
+     * @brief reset: clears all levels and prepares the pyramid for a signal of the given length.
+     * @param count: number of samples that will be fed with append().
+     */
+    void reset(size_t count);
+
+    /**
+     * @brief append: feeds the next block of samples. The pyramid finishes itself when count samples were fed.
+     * @param data: pointer to n consecutive samples.
+     * @param n: number of samples in the block.
+     */
+    void append(const double *data, size_t n);
+
+    void finish();
+
+    bool isComplete() const;
+    size_t sampleCount() const;
+    size_t samplesFed() const;
+
+    int levelCount() const;
+    size_t bucketSize(int level) const;
+    size_t bucketCount(int level) const;
+
+    /**
+     * @brief levelFor: finds the coarsest level whose buckets are not wider than one pixel.
+     * Only depends on the layout of the pyramid, so it can be used before the pyramid is built.
+     * @param samplesPerPixel: number of raw samples that fall on one pixel of the plot.
+     * @param count: number of samples of the signal.
+     * @return the level index or -1 if the raw data should be used.
+     */
+    static int levelFor(double samplesPerPixel, size_t count, unsigned int baseBucket = 16, unsigned int factor = 4);
+
+    /**
+     * @brief envelope: returns the min/max envelope of the samples [start, start+extent) at the given level.
+     * Each bucket contributes two points in the order in which min and max occur in the raw data.
+     * @param index: the (fractional) sample indices of the returned points.
+     * @param values: the envelope values, NaN for buckets without valid samples.
+     */
+    void envelope(int level, size_t start, size_t extent, std::vector<double> &index, std::vector<double> &values) const;
+
+    /**
+     * @brief save: writes a complete pyramid in a compact binary format.
+     * @return false if the pyramid is incomplete or the stream failed.
+     */
+    bool save(std::ostream &out) const;
+
+    /**
+     * @brief storedSize: the number of bytes save() writes.
+     */
+    size_t storedSize() const;
+
+    /**
+     * @brief load: reads a pyramid written by save(). Leaves the pyramid reset to an empty signal on failure.
+     * @return true if a complete pyramid was read.
+     */
+    bool load(std::istream &in);
+
+private:
+    struct Level {
+        size_t bucket;
+        std::vector<double> min;
+        std::vector<double> max;
+        std::vector<char> minFirst;
+    };
+
+    unsigned int baseBucket;
+    unsigned int factor;
+    size_t count;
+    size_t fed;
+    bool complete;
+    std::vector<Level> levels;
+
+    double curMin, curMax;
+    size_t curMinPos, curMaxPos, curFill;
+
+    void flushBucket();
+    void buildLevel();
+};
+
+#endif // LODPYRAMID_H
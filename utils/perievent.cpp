@@ -0,0 +1,218 @@
+#include "perievent.h"
+#include "dataconvert.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <iostream>
+
+// the jobs merge their partial averages at most this often.
+static const qint64 UPDATE_MS = 100;
+
+
+/**
+ * @brief PeriEventJob: Averages a share of the runs of a PeriEventAverage, one run per step, into its own accumulator.
+ */
+class PeriEventJob : public LoadJob
+{
+public:
+    PeriEventJob(PeriEventAverage *average, const void *lane, LoadPriority priority, const std::vector<int> &runs) :
+        LoadJob(lane, priority), average(average), runs(runs), position(0) {
+        partial.resize(average->total.length());
+        timer.start();
+    }
+
+    bool step() override;
+
+private:
+    PeriEventAverage *average;
+    std::vector<int> runs;
+    size_t position;
+    WelfordAccumulator partial;
+    QElapsedTimer timer;
+    std::vector<double> values;
+    std::vector<char> nativeData;
+};
+
+
+bool PeriEventJob::step() {
+    const TaggedSlices &slices = average->slices;
+    const TaggedSlices::Run &run = slices.runs()[runs[position++]];
+    size_t inner = run.extent.nelms() / run.extent[0];
+    bool read = false;
+    for (int index : run.slices) {
+        TaggedSlices::SlicePtr slice = slices.slice(index);
+        if (slice) {
+            partial.add(slice->values.data(), slice->values.size());
+            continue;
+        }
+        if (!read) {
+            values.resize(run.extent.nelms());
+            // the windows of a failed run are left out, the lane has to be counted down in any case.
+            try {
+                nixview::util::read_as_double(slices.array(), values.data(), run.extent, run.offset, nativeData);
+            } catch (std::exception &e) {
+                std::cerr << "PeriEventJob::step(): reading " << slices.array().name() << " failed: " << e.what() << std::endl;
+                break;
+            }
+            read = true;
+        }
+        // the other dimensions of a run are those of its slices, so a slice is a contiguous band of the run.
+        nix::NDSize offset = slices.offset(index);
+        nix::NDSize extent = slices.extent(index);
+        partial.add(values.data() + (offset[0] - run.offset[0]) * inner, extent[0] * inner);
+    }
+
+    bool done = position >= runs.size();
+    if (done || timer.elapsed() >= UPDATE_MS) {
+        average->publish(partial);
+        timer.restart();
+    }
+    if (done) {
+        average->laneDone();
+        return false;
+    }
+    return true;
+}
+
+
+PeriEventAverage::PeriEventAverage(QObject *parent) :
+    QObject(parent), before(0), scale(1.0), length(0), lines(0), windows(0), pending(0), updatePending(0) {
+}
+
+
+PeriEventAverage::~PeriEventAverage() {
+    // the running jobs publish through this object.
+    cancel();
+}
+
+
+bool PeriEventAverage::setSource(const nix::MultiTag &tag, size_t reference, double before, double after) {
+    cancel();
+    length = 0;
+    lines = 0;
+    windows = 0;
+    this->before = std::isnan(before) ? 0 : before;
+    if (!slices.setSource(tag, reference, before, after)) {
+        return false;
+    }
+    scale = TaggedSlices::unitScale(tag, slices.array(), 0);
+    for (int i = 0; i < slices.count(); i++) {
+        if (slices.valid(i)) {
+            nix::NDSize extent = slices.extent(i);
+            length = std::max(length, static_cast<int>(extent[0]));
+            lines = static_cast<int>(extent.nelms() / extent[0]);
+            windows++;
+        }
+    }
+    return true;
+}
+
+
+void PeriEventAverage::start(LoadPriority priority) {
+    cancel();
+    {
+        QMutexLocker locker(&mutex);
+        total.resize(static_cast<size_t>(length) * lines);
+    }
+    const std::vector<TaggedSlices::Run> &runs = slices.runs();
+    if (runs.empty()) {
+        emit finished();
+        return;
+    }
+
+    LoadScheduler &scheduler = LoadScheduler::instance();
+    size_t laneCount = std::min(static_cast<size_t>(std::max(1, scheduler.workerCount())), runs.size());
+    lanes.assign(laneCount, 0);
+    pending.store(static_cast<int>(laneCount));
+    updatePending.store(0);
+    // interleaved, so every lane gets windows from all over the file and the first updates are representative.
+    for (size_t l = 0; l < laneCount; l++) {
+        std::vector<int> share;
+        for (size_t r = l; r < runs.size(); r += laneCount) {
+            share.push_back(static_cast<int>(r));
+        }
+        scheduler.submit(QSharedPointer<LoadJob>(new PeriEventJob(this, &lanes[l], priority, share)));
+    }
+}
+
+
+void PeriEventAverage::cancel() {
+    LoadScheduler &scheduler = LoadScheduler::instance();
+    for (size_t l = 0; l < lanes.size(); l++) {
+        scheduler.cancel(&lanes[l], true);
+    }
+    lanes.clear();
+}
+
+
+void PeriEventAverage::publish(WelfordAccumulator &partial) {
+    {
+        QMutexLocker locker(&mutex);
+        total.merge(partial);
+    }
+    partial.clear();
+    if (updatePending.testAndSetOrdered(0, 1)) {
+        emit updated();
+    }
+}
+
+
+void PeriEventAverage::laneDone() {
+    if (!pending.deref()) {
+        emit finished();
+    }
+}
+
+
+int PeriEventAverage::windowCount() const {
+    return windows;
+}
+
+
+const nix::DataArray& PeriEventAverage::array() const {
+    return slices.array();
+}
+
+
+int PeriEventAverage::windowLength() const {
+    return length;
+}
+
+
+int PeriEventAverage::lineCount() const {
+    return lines;
+}
+
+
+QVector<double> PeriEventAverage::keys() const {
+    QVector<double> keys(length);
+    nix::Dimension dim = slices.array().getDimension(1);
+    if (dim.dimensionType() != nix::DimensionType::Sample) {
+        for (int j = 0; j < length; j++) {
+            keys[j] = j;
+        }
+        return keys;
+    }
+    // the samples are spaced in the units of the dimension, before is given in the units of the tag.
+    double interval = dim.asSampledDimension().samplingInterval() / scale;
+    for (int j = 0; j < length; j++) {
+        keys[j] = j * interval - before;
+    }
+    return keys;
+}
+
+
+int PeriEventAverage::result(QVector<double> &mean, QVector<double> &sd) {
+    updatePending.store(0);
+    QMutexLocker locker(&mutex);
+    mean.resize(length * lines);
+    sd.resize(mean.size());
+    // the accumulator holds the windows row major, [samples x lines].
+    for (int j = 0; j < length; j++) {
+        for (int l = 0; l < lines; l++) {
+            size_t i = static_cast<size_t>(j) * lines + l;
+            mean[l * length + j] = total.mean(i);
+            sd[l * length + j] = total.sd(i);
+        }
+    }
+    return static_cast<int>(total.windows());
+}
@@ -0,0 +1,89 @@
+#ifndef PERIEVENT_H
+#define PERIEVENT_H
+
+#include <QObject>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QVector>
+#include <vector>
+#include <nix.hpp>
+#include "loadscheduler.h"
+#include "taggedslices.h"
+#include "welford.h"
+
+
+class PeriEventAverage : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief PeriEventAverage: Mean and standard deviation of a reference around the positions of a MultiTag.
+     * The windows are the slices of a TaggedSlices, aligned at their first sample. They are streamed through
+     * WelfordAccumulators on one LoadScheduler job per worker. Slices in the tagged-slice cache are used from there,
+     * the other runs are read and averaged without being stored, so a large average does not flush the cache.
+     * The jobs merge their partial results every UPDATE_MS, updated() is emitted once per merge that was not picked up yet.
+     */
+    explicit PeriEventAverage(QObject *parent = 0);
+    ~PeriEventAverage();
+
+    /**
+     * @brief setSource: cancels a running average and sets up the windows, see TaggedSlices::setSource().
+     * Without before and after the windows are the extents of the positions.
+     */
+    bool setSource(const nix::MultiTag &tag, size_t reference, double before = NAN, double after = NAN);
+
+    /**
+     * @brief start: starts averaging all valid windows.
+     */
+    void start(LoadPriority priority = LoadPriority::Visible);
+    void cancel();
+
+    /**
+     * @brief windowCount: the number of windows that are averaged, windowLength() samples times lineCount() values each.
+     */
+    int windowCount() const;
+    int windowLength() const;
+    const nix::DataArray& array() const;
+    int lineCount() const;
+
+    /**
+     * @brief keys: the position of every sample of a window relative to the tag position in the units of the tag
+     * (see TaggedSlices::unit()) if the first dimension is sampled, the sample index in the window otherwise.
+     */
+    QVector<double> keys() const;
+
+    /**
+     * @brief result: the mean and SD of every line, line l at [l * windowLength(), (l + 1) * windowLength()).
+     * @return the number of windows averaged so far.
+     */
+    int result(QVector<double> &mean, QVector<double> &sd);
+
+signals:
+    void updated();
+    void finished();
+
+private:
+    friend class PeriEventJob;
+
+    TaggedSlices slices;
+    double before;
+    // from the units of the tag to the units of the first dimension.
+    double scale;
+    int length;
+    int lines;
+    int windows;
+    // the jobs of one average, their addresses are the owners on the scheduler so they run in parallel.
+    std::vector<char> lanes;
+    QAtomicInt pending;
+    QAtomicInt updatePending;
+
+    // guards the merged result.
+    QMutex mutex;
+    WelfordAccumulator total;
+
+    void publish(WelfordAccumulator &partial);
+    void laneDone();
+};
+
+#endif // PERIEVENT_H
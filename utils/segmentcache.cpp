@@ -0,0 +1,150 @@
+#include "segmentcache.h"
+#include "common/Common.hpp"
+#include <QSettings>
+#include <algorithm>
+
+QAtomicInt SegmentCache::liveCaches(0);
+
+
+SegmentCache::SegmentCache() {
+    liveCaches.ref();
+    channels = 0;
+    usage = 0;
+    useCounter = 0;
+
+    QSettings settings;
+    settings.beginGroup(LOADER_GROUP);
+    qint64 megabytes = settings.value(LOADER_SEGMENT_CACHE_SIZE, 256).toLongLong();
+    settings.endGroup();
+    budget = static_cast<size_t>(std::max(megabytes, static_cast<qint64>(0))) * 1024 * 1024;
+}
+
+
+SegmentCache::~SegmentCache() {
+    liveCaches.deref();
+}
+
+
+void SegmentCache::reset(const std::string &key, size_t channelCount) {
+    if (key != this->key || channelCount != channels) {
+        clear();
+        this->key = key;
+        channels = channelCount;
+    }
+}
+
+
+void SegmentCache::clear() {
+    segments.clear();
+    usage = 0;
+}
+
+
+size_t SegmentCache::memoryUsage() const {
+    return usage;
+}
+
+
+size_t SegmentCache::share() const {
+    return budget / static_cast<size_t>(std::max(1, liveCaches.load()));
+}
+
+
+size_t SegmentCache::copy(size_t start, size_t extent, LoadBuffer &buffer, size_t bufferOffset) {
+    size_t copied = 0;
+    while (copied < extent) {
+        size_t position = start + copied;
+
+        // the only segment that can cover position is the last one starting at or before it.
+        QMap<size_t, Segment>::iterator it = segments.upperBound(position);
+        if (it == segments.begin()) {
+            break;
+        }
+        --it;
+        if (it.key() + it->length <= position) {
+            break;
+        }
+
+        size_t from = position - it.key();
+        size_t n = std::min(it->length - from, extent - copied);
+        size_t to = bufferOffset + copied;
+
+        if (!buffer.hasImplicitKeys()) {
+            std::copy(it->keys.begin() + from, it->keys.begin() + from + n, buffer.keys.begin() + to);
+        }
+        for (size_t c = 0; c < channels; c++) {
+            std::copy(it->values[c].begin() + from, it->values[c].begin() + from + n, buffer.values[c].begin() + to);
+        }
+        it->lastUse = ++useCounter;
+        copied += n;
+    }
+    return copied;
+}
+
+
+size_t SegmentCache::cachedUntil(size_t position) const {
+    QMap<size_t, Segment>::const_iterator it = segments.upperBound(position);
+    if (it == segments.constBegin()) {
+        return position;
+    }
+    --it;
+    while (it != segments.constEnd() && it.key() <= position && it.key() + it->length > position) {
+        position = it.key() + it->length;
+        ++it;
+    }
+    return position;
+}
+
+
+size_t SegmentCache::nextSegment(size_t position) const {
+    QMap<size_t, Segment>::const_iterator it = segments.lowerBound(position);
+    return it == segments.constEnd() ? SIZE_MAX : it.key();
+}
+
+
+void SegmentCache::insert(size_t start, size_t count, const LoadBuffer &buffer, size_t bufferOffset, size_t keepStart, size_t keepExtent) {
+    if (count == 0 || buffer.channelCount() != channels) {
+        return;
+    }
+    // implicit keys are not stored.
+    size_t bytes = count * (channels + (buffer.hasImplicitKeys() ? 0 : 1)) * sizeof(double);
+    if (bytes > share()) {
+        return;
+    }
+
+    // filled in place, inserting a finished segment would copy it.
+    Segment &segment = segments[start];
+    segment.length = count;
+    segment.lastUse = ++useCounter;
+    if (buffer.hasImplicitKeys()) {
+        segment.keys.clear();
+    } else {
+        segment.keys.assign(buffer.keys.begin() + bufferOffset, buffer.keys.begin() + bufferOffset + count);
+    }
+    segment.values.resize(channels);
+    for (size_t c = 0; c < channels; c++) {
+        segment.values[c].assign(buffer.values[c].begin() + bufferOffset, buffer.values[c].begin() + bufferOffset + count);
+    }
+    usage += bytes;
+    evict(keepStart, keepStart + keepExtent);
+}
+
+
+void SegmentCache::evict(size_t keepStart, size_t keepEnd) {
+    // a cache only drops its own segments, the others shrink to their share when they insert next.
+    size_t limit = share();
+    while (usage > limit) {
+        QMap<size_t, Segment>::iterator oldest = segments.end();
+        for (QMap<size_t, Segment>::iterator it = segments.begin(); it != segments.end(); ++it) {
+            bool kept = it.key() < keepEnd && it.key() + it->length > keepStart;
+            if (!kept && (oldest == segments.end() || it->lastUse < oldest->lastUse)) {
+                oldest = it;
+            }
+        }
+        if (oldest == segments.end()) {
+            return;
+        }
+        usage -= (oldest->length * channels + oldest->keys.size()) * sizeof(double);
+        segments.erase(oldest);
+    }
+}
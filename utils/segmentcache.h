@@ -0,0 +1,85 @@
+#ifndef SEGMENTCACHE_H
+#define SEGMENTCACHE_H
+
+#include <QMap>
+#include <QAtomicInt>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "loadbuffer.h"
+
+
+/**
+ * @brief SegmentCache: The already loaded [start, start+length) ranges of one plotted array, so panning back over
+ * data that was shown before is served from memory instead of HDF5.
+ * Segments are kept non-overlapping and ordered by their start, which makes the map an interval index:
+ * the segment covering a position is the last one starting at or before it.
+ * The budget (settings: LOADER_GROUP/LOADER_SEGMENT_CACHE_SIZE in MB) is shared by all live caches, when a cache grows
+ * beyond its share of it the least recently used segments are dropped.
+ */
+class SegmentCache
+{
+public:
+    SegmentCache();
+    ~SegmentCache();
+
+    /**
+     * @brief reset: clears the cache if it held data of a different array or channel selection.
+     * @param key: identifies the array and the loaded channels.
+     */
+    void reset(const std::string &key, size_t channelCount);
+    void clear();
+
+    /**
+     * @brief copy: copies the cached data beginning at start into the buffer and marks it as recently used.
+     * Consecutive segments are copied until a gap or extent samples are reached.
+     * @return the number of samples copied, 0 if start is not cached.
+     */
+    size_t copy(size_t start, size_t extent, LoadBuffer &buffer, size_t bufferOffset);
+
+    /**
+     * @brief cachedUntil: end of the consecutive segments covering position.
+     * @return position if it is not cached.
+     */
+    size_t cachedUntil(size_t position) const;
+
+    /**
+     * @brief nextSegment: start of the first segment behind position, e.g. the end of the gap at position.
+     * @return the start or SIZE_MAX if there is none.
+     */
+    size_t nextSegment(size_t position) const;
+
+    /**
+     * @brief insert: stores count samples of the buffer (all channels and the keys unless they are implicit) as the segment beginning at start.
+     * @param keepStart, keepExtent: the range of the running request, it is never evicted.
+     */
+    void insert(size_t start, size_t count, const LoadBuffer &buffer, size_t bufferOffset, size_t keepStart, size_t keepExtent);
+
+    size_t memoryUsage() const;
+
+    /**
+     * @brief share: the part of the budget this cache may use, the budget divided by the number of live caches.
+     */
+    size_t share() const;
+
+private:
+    struct Segment {
+        size_t length;
+        unsigned long long lastUse;
+        std::vector<double> keys;
+        std::vector<std::vector<double>> values;
+    };
+
+    QMap<size_t, Segment> segments;
+    std::string key;
+    size_t channels;
+    size_t usage;
+    size_t budget;
+    unsigned long long useCounter;
+
+    static QAtomicInt liveCaches;
+
+    void evict(size_t keepStart, size_t keepEnd);
+};
+
+#endif // SEGMENTCACHE_H
@@ -0,0 +1,114 @@
+#include "storagelayout.h"
+#include "h5lookup.h"
+
+QMutex StorageLayout::mutex;
+std::string StorageLayout::filePath;
+QHash<QString, StorageLayout> StorageLayout::layouts;
+
+
+StorageLayout::StorageLayout() {
+    chunked = false;
+    filtered = false;
+}
+
+
+void StorageLayout::setFile(const std::string &path) {
+    QMutexLocker locker(&mutex);
+    filePath = path;
+    layouts.clear();
+}
+
+
+StorageLayout StorageLayout::of(const nix::DataArray &array) {
+    QString id = QString::fromStdString(array.id());
+    {
+        QMutexLocker locker(&mutex);
+        if (layouts.contains(id)) {
+            return layouts.value(id);
+        }
+    }
+
+    StorageLayout layout = read(array);
+
+    QMutexLocker locker(&mutex);
+    layouts.insert(id, layout);
+    return layout;
+}
+
+
+StorageLayout StorageLayout::read(const nix::DataArray &array) {
+    StorageLayout layout;
+    std::string path;
+    {
+        QMutexLocker locker(&mutex);
+        path = filePath;
+    }
+    if (path.empty()) {
+        return layout;
+    }
+
+    nixview::util::H5ErrorsOff quiet;
+
+    hid_t file = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file >= 0) {
+        hid_t dataset = -1;
+        hid_t group = nixview::util::open_array_group(file, array);
+        if (group >= 0) {
+            dataset = H5Dopen2(group, "data", H5P_DEFAULT);
+            H5Gclose(group);
+        }
+        if (dataset >= 0) {
+            hid_t plist = H5Dget_create_plist(dataset);
+            if (H5Pget_layout(plist) == H5D_CHUNKED) {
+                hid_t space = H5Dget_space(dataset);
+                int rank = H5Sget_simple_extent_ndims(space);
+                H5Sclose(space);
+
+                std::vector<hsize_t> dims(rank > 0 ? rank : 0);
+                if (rank > 0 && H5Pget_chunk(plist, rank, dims.data()) == rank) {
+                    layout.chunked = true;
+                    layout.chunk.assign(dims.begin(), dims.end());
+                    layout.filtered = H5Pget_nfilters(plist) > 0;
+                }
+            }
+            H5Pclose(plist);
+            H5Dclose(dataset);
+        } else {
+            std::cerr << "StorageLayout::read(): no dataset found for DataArray " << array.name() << std::endl;
+        }
+        H5Fclose(file);
+    }
+    return layout;
+}
+
+
+bool StorageLayout::isChunked() const {
+    return chunked;
+}
+
+
+bool StorageLayout::isFiltered() const {
+    return filtered;
+}
+
+
+size_t StorageLayout::chunkExtent(size_t dim) const {
+    if (!chunked || dim >= chunk.size()) {
+        return 1;
+    }
+    return chunk[dim];
+}
+
+
+size_t StorageLayout::alignedEnd(size_t dim, size_t start, size_t length) const {
+    size_t extent = chunkExtent(dim);
+    size_t end = start + length;
+    if (extent <= 1) {
+        return end;
+    }
+    size_t aligned = end / extent * extent;
+    if (aligned <= start) {
+        aligned = (start / extent + 1) * extent;
+    }
+    return aligned;
+}
@@ -0,0 +1,59 @@
+#ifndef STORAGELAYOUT_H
+#define STORAGELAYOUT_H
+
+#include <QMutex>
+#include <QHash>
+#include <QString>
+#include <vector>
+#include <nix.hpp>
+
+
+/**
+ * @brief StorageLayout: How the data of a DataArray is stored in the HDF5 file: contiguous or in chunks,
+ * and whether the chunks pass through filters (e.g. compression).
+ * nix does not expose this, so the dataset is looked up in the file with the HDF5 C API.
+ * Layouts are cached by DataArray id until the next setFile().
+ */
+class StorageLayout
+{
+public:
+    StorageLayout();
+
+    /**
+     * @brief setFile: sets the path of the currently opened nix file and clears the cached layouts.
+     */
+    static void setFile(const std::string &path);
+
+    /**
+     * @brief of: the layout of the array, a contiguous layout if the dataset could not be found.
+     */
+    static StorageLayout of(const nix::DataArray &array);
+
+    bool isChunked() const;
+    bool isFiltered() const;
+
+    /**
+     * @brief chunkExtent: the extent of a storage chunk in the given dimension (starting with 0), 1 if not chunked.
+     */
+    size_t chunkExtent(size_t dim) const;
+
+    /**
+     * @brief alignedEnd: the end of a read that starts at start and reads about length samples along dim,
+     * moved back to a chunk boundary so the next read does not decompress the same chunk again.
+     * A read shorter than one chunk ends at the next boundary.
+     */
+    size_t alignedEnd(size_t dim, size_t start, size_t length) const;
+
+private:
+    bool chunked;
+    bool filtered;
+    std::vector<size_t> chunk;
+
+    static QMutex mutex;
+    static std::string filePath;
+    static QHash<QString, StorageLayout> layouts;
+
+    static StorageLayout read(const nix::DataArray &array);
+};
+
+#endif // STORAGELAYOUT_H
@@ -0,0 +1,432 @@
+#include "taggedslices.h"
+#include "blockcache.h"
+#include "dataconvert.h"
+#include "tickindex.h"
+#include "common/Common.hpp"
+#include <QSettings>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// a run grows up to this many values, so one step of a job reads a bounded amount.
+static const size_t MAX_RUN_VALUES = 1 << 21;
+
+QMutex TaggedSlices::mutex;
+std::string TaggedSlices::filePath;
+QHash<QString, TaggedSlices::Entry> TaggedSlices::cache;
+QMap<unsigned long long, QString> TaggedSlices::lru;
+size_t TaggedSlices::usage = 0;
+size_t TaggedSlices::budget = 0;
+unsigned long long TaggedSlices::useCounter = 0;
+
+
+/**
+ * @brief TaggedSliceJob: Reads a share of the runs of a fetch, one run per step, and stores the slices of each run
+ * that are not cached yet.
+ */
+class TaggedSliceJob : public LoadJob
+{
+public:
+    TaggedSliceJob(TaggedSlices *slices, const void *lane, LoadPriority priority, const nix::DataArray &array,
+                   const std::vector<TaggedSlices::Run> &runs) :
+        LoadJob(lane, priority), slices(slices), array(array), runs(runs), position(0) {
+    }
+
+    bool step() override;
+
+private:
+    TaggedSlices *slices;
+    nix::DataArray array;
+    std::vector<TaggedSlices::Run> runs;
+    size_t position;
+    std::vector<double> values;
+    std::vector<char> nativeData;
+};
+
+
+bool TaggedSliceJob::step() {
+    const TaggedSlices::Run &run = runs[position++];
+    values.resize(run.extent.nelms());
+    // a failed run is skipped, the lane has to be counted down in any case or finished() is never emitted.
+    try {
+        nixview::util::read_as_double(array, values.data(), run.extent, run.offset, nativeData);
+        for (int index : run.slices) {
+            if (slices->slice(index).isNull()) {
+                slices->store(index, run, values.data());
+                emit slices->sliceReady(index);
+            }
+        }
+    } catch (std::exception &e) {
+        std::cerr << "TaggedSliceJob::step(): reading " << array.name() << " failed: " << e.what() << std::endl;
+    }
+    if (position < runs.size()) {
+        return true;
+    }
+    slices->laneDone();
+    return false;
+}
+
+
+/**
+ * @brief DimensionMap: maps positions along a dimension of the reference to indices.
+ */
+struct DimensionMap {
+    nix::DimensionType type;
+    double offset;
+    double interval;
+    TickIndexPtr ticks;
+
+    double index(double position) const {
+        if (type == nix::DimensionType::Sample) {
+            return std::floor((position - offset) / interval + 0.5);
+        } else if (type == nix::DimensionType::Range) {
+            return static_cast<double>(ticks->lowerBound(position));
+        }
+        return std::floor(position + 0.5);
+    }
+};
+
+
+static boost::optional<std::string> dimension_unit(const nix::DataArray &array, size_t d) {
+    nix::Dimension dim = array.getDimension(d + 1);
+    if (dim.dimensionType() == nix::DimensionType::Sample) {
+        return dim.asSampledDimension().unit();
+    } else if (dim.dimensionType() == nix::DimensionType::Range) {
+        return dim.asRangeDimension().unit();
+    }
+    return boost::none;
+}
+
+
+double TaggedSlices::unitScale(const nix::MultiTag &tag, const nix::DataArray &array, size_t d) {
+    std::vector<std::string> units = tag.units();
+    boost::optional<std::string> unit = dimension_unit(array, d);
+    if (d < units.size() && unit && !units[d].empty() && nix::util::isScalable(units[d], *unit)) {
+        return nix::util::getSIScaling(units[d], *unit);
+    }
+    return 1.0;
+}
+
+
+std::string TaggedSlices::unit(const nix::MultiTag &tag, const nix::DataArray &array, size_t d) {
+    std::vector<std::string> units = tag.units();
+    boost::optional<std::string> unit = dimension_unit(array, d);
+    if (d < units.size() && !units[d].empty() && (!unit || nix::util::isScalable(units[d], *unit))) {
+        return units[d];
+    }
+    return unit ? *unit : std::string();
+}
+
+
+TaggedSlices::TaggedSlices(QObject *parent) :
+    QObject(parent), pending(0) {
+}
+
+
+TaggedSlices::~TaggedSlices() {
+    // the running jobs store through this object.
+    cancel();
+}
+
+
+void TaggedSlices::setFile(const std::string &path) {
+    QSettings settings;
+    settings.beginGroup(LOADER_GROUP);
+    qint64 megabytes = settings.value(LOADER_TAGGED_CACHE_SIZE, 256).toLongLong();
+    settings.endGroup();
+
+    QMutexLocker locker(&mutex);
+    filePath = path;
+    budget = static_cast<size_t>(std::max(megabytes, static_cast<qint64>(0))) * 1024 * 1024;
+    cache.clear();
+    lru.clear();
+    usage = 0;
+}
+
+
+bool TaggedSlices::setSource(const nix::MultiTag &tag, size_t reference, double before, double after) {
+    cancel();
+    offsets.clear();
+    extents.clear();
+    inside.clear();
+    runList.clear();
+    runIndex.clear();
+    if (reference >= tag.referenceCount()) {
+        std::cerr << "TaggedSlices::setSource(): the tag has no reference " << reference << std::endl;
+        return false;
+    }
+    this->reference = tag.getReference(reference);
+    {
+        QMutexLocker locker(&mutex);
+        keyPrefix = QString::fromStdString(filePath + "/" + tag.id() + "/" + nix::util::numToStr(reference) + "/");
+    }
+    bool windowed = !std::isnan(before) && !std::isnan(after);
+    if (windowed) {
+        keyPrefix += QString("%1:%2/").arg(before, 0, 'g', 17).arg(after, 0, 'g', 17);
+    }
+
+    nix::NDSize shape = this->reference.dataExtent();
+    size_t rank = shape.size();
+    nix::DataArray positions = tag.positions();
+    nix::NDSize positionShape = positions.dataExtent();
+    size_t n = positionShape.size() > 0 ? positionShape[0] : 0;
+    size_t k = positionShape.size() > 1 ? positionShape[1] : 1;
+    if (positionShape.size() == 0 || positionShape.size() > 2 || k > rank) {
+        std::cerr << "TaggedSlices::setSource(): positions of " << tag.name() << " do not match the reference." << std::endl;
+        return false;
+    }
+    std::vector<double> pos(n * k), ext;
+    BlockCache::read(positions, pos.data(), positionShape, nix::NDSize(positionShape.size(), 0));
+    if (tag.extents() != nix::none && tag.extents().dataExtent() == positionShape) {
+        ext.resize(n * k);
+        BlockCache::read(tag.extents(), ext.data(), positionShape, nix::NDSize(positionShape.size(), 0));
+    }
+
+    // the positions are given in the units of the tag, the dimensions may use others.
+    std::vector<DimensionMap> maps(k);
+    std::vector<double> scale(k, 1.0);
+    for (size_t d = 0; d < k; d++) {
+        nix::Dimension dim = this->reference.getDimension(d + 1);
+        DimensionMap &map = maps[d];
+        map.type = dim.dimensionType();
+        map.offset = 0;
+        map.interval = 1;
+        if (map.type == nix::DimensionType::Sample) {
+            nix::SampledDimension sd = dim.asSampledDimension();
+            map.interval = sd.samplingInterval();
+            map.offset = sd.offset() ? *sd.offset() : 0;
+        } else if (map.type == nix::DimensionType::Range) {
+            map.ticks = TickIndex::of(this->reference, d + 1);
+        }
+        scale[d] = unitScale(tag, this->reference, d);
+    }
+
+    offsets.assign(n, nix::NDSize(rank, 0));
+    extents.assign(n, nix::NDSize(rank, 0));
+    inside.assign(n, 0);
+    runIndex.assign(n, -1);
+    for (size_t i = 0; i < n; i++) {
+        bool valid = true;
+        for (size_t d = 0; d < k && valid; d++) {
+            double p = pos[i * k + d] * scale[d];
+            double e = ext.empty() ? 0 : ext[i * k + d] * scale[d];
+            double first, last;
+            if (windowed && d == 0) {
+                first = maps[d].index(p - before * scale[d]);
+                last = maps[d].index(p + after * scale[d]);
+                // a cut window would be averaged out of place.
+                valid = first >= 0 && last <= shape[d] && last > first;
+            } else {
+                first = maps[d].index(std::min(p, p + e));
+                last = maps[d].index(std::max(p, p + e));
+            }
+            if (!valid || std::isnan(first) || std::isnan(last) || first >= shape[d] || last < 0) {
+                valid = false;
+                break;
+            }
+            first = std::max(first, 0.0);
+            last = std::min(last, static_cast<double>(shape[d]));
+            offsets[i][d] = static_cast<nix::ndsize_t>(first);
+            extents[i][d] = std::max<nix::ndsize_t>(1, static_cast<nix::ndsize_t>(last - first));
+            extents[i][d] = std::min(extents[i][d], shape[d] - offsets[i][d]);
+        }
+        for (size_t d = k; d < rank; d++) {
+            extents[i][d] = shape[d];
+        }
+        inside[i] = valid;
+    }
+
+    // grouped by the hyperslab in the other dimensions and ordered by the start in the first, so overlapping or
+    // touching slices follow each other.
+    std::vector<int> order;
+    order.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        if (inside[i]) {
+            order.push_back(static_cast<int>(i));
+        }
+    }
+    std::sort(order.begin(), order.end(), [this, rank](int a, int b) {
+        for (size_t d = 1; d < rank; d++) {
+            if (offsets[a][d] != offsets[b][d]) {
+                return offsets[a][d] < offsets[b][d];
+            }
+            if (extents[a][d] != extents[b][d]) {
+                return extents[a][d] < extents[b][d];
+            }
+        }
+        return offsets[a][0] < offsets[b][0];
+    });
+    for (int i : order) {
+        if (!runList.empty()) {
+            Run &run = runList.back();
+            bool same = true;
+            for (size_t d = 1; d < rank && same; d++) {
+                same = run.offset[d] == offsets[i][d] && run.extent[d] == extents[i][d];
+            }
+            nix::ndsize_t runEnd = run.offset[0] + run.extent[0];
+            nix::ndsize_t end = std::max(runEnd, offsets[i][0] + extents[i][0]);
+            if (same && offsets[i][0] <= runEnd && (end - run.offset[0]) * (run.extent.nelms() / run.extent[0]) <= MAX_RUN_VALUES) {
+                run.extent[0] = end - run.offset[0];
+                run.slices.push_back(i);
+                runIndex[i] = static_cast<int>(runList.size()) - 1;
+                continue;
+            }
+        }
+        Run run;
+        run.offset = offsets[i];
+        run.extent = extents[i];
+        run.slices.push_back(i);
+        runList.push_back(run);
+        runIndex[i] = static_cast<int>(runList.size()) - 1;
+    }
+    return true;
+}
+
+
+int TaggedSlices::count() const {
+    return static_cast<int>(offsets.size());
+}
+
+
+const nix::DataArray& TaggedSlices::array() const {
+    return reference;
+}
+
+
+bool TaggedSlices::valid(int index) const {
+    return index >= 0 && index < count() && inside[index];
+}
+
+
+nix::NDSize TaggedSlices::offset(int index) const {
+    return offsets[index];
+}
+
+
+nix::NDSize TaggedSlices::extent(int index) const {
+    return extents[index];
+}
+
+
+const std::vector<TaggedSlices::Run>& TaggedSlices::runs() const {
+    return runList;
+}
+
+
+int TaggedSlices::runOf(int index) const {
+    return runIndex[index];
+}
+
+
+void TaggedSlices::fetch(int first, int last, LoadPriority priority) {
+    cancel();
+    first = std::max(first, 0);
+    last = std::min(last, count());
+    std::vector<char> wanted(runList.size(), 0);
+    std::vector<int> reads;
+    for (int i = first; i < last; i++) {
+        int run = runIndex[i];
+        if (run >= 0 && !wanted[run] && slice(i).isNull()) {
+            wanted[run] = 1;
+            reads.push_back(run);
+        }
+    }
+    if (reads.empty()) {
+        emit finished();
+        return;
+    }
+    std::sort(reads.begin(), reads.end());
+
+    LoadScheduler &scheduler = LoadScheduler::instance();
+    size_t laneCount = std::min(static_cast<size_t>(std::max(1, scheduler.workerCount())), reads.size());
+    lanes.assign(laneCount, 0);
+    pending.store(static_cast<int>(laneCount));
+    for (size_t l = 0; l < laneCount; l++) {
+        std::vector<Run> share;
+        for (size_t r = l * reads.size() / laneCount; r < (l + 1) * reads.size() / laneCount; r++) {
+            share.push_back(runList[reads[r]]);
+        }
+        scheduler.submit(QSharedPointer<LoadJob>(new TaggedSliceJob(this, &lanes[l], priority, reference, share)));
+    }
+}
+
+
+void TaggedSlices::cancel() {
+    LoadScheduler &scheduler = LoadScheduler::instance();
+    for (size_t l = 0; l < lanes.size(); l++) {
+        scheduler.cancel(&lanes[l], true);
+    }
+    lanes.clear();
+}
+
+
+void TaggedSlices::laneDone() {
+    if (!pending.deref()) {
+        emit finished();
+    }
+}
+
+
+QString TaggedSlices::key(int index) const {
+    return keyPrefix + QString::number(index);
+}
+
+
+TaggedSlices::SlicePtr TaggedSlices::slice(int index) const {
+    QString k = key(index);
+    QMutexLocker locker(&mutex);
+    QHash<QString, Entry>::iterator it = cache.find(k);
+    if (it == cache.end()) {
+        return SlicePtr();
+    }
+    touch(it.key(), *it);
+    return it->slice;
+}
+
+
+TaggedSlices::SlicePtr TaggedSlices::store(int index, const Run &run, const double *values) {
+    QSharedPointer<Slice> s(new Slice);
+    s->offset = offsets[index];
+    s->extent = extents[index];
+    s->values.resize(s->extent.nelms());
+    nixview::util::copy_box(values, run.offset, run.extent, s->values.data(), s->offset, s->extent);
+
+    QString k = key(index);
+    QMutexLocker locker(&mutex);
+    QHash<QString, Entry>::iterator it = cache.find(k);
+    if (it != cache.end()) {
+        touch(k, *it);
+        return it->slice;
+    }
+    Entry entry;
+    entry.slice = s;
+    entry.lastUse = ++useCounter;
+    cache.insert(k, entry);
+    lru.insert(entry.lastUse, k);
+    usage += s->values.size() * sizeof(double);
+    evict(k);
+    return s;
+}
+
+
+void TaggedSlices::touch(const QString &key, Entry &entry) {
+    lru.remove(entry.lastUse);
+    entry.lastUse = ++useCounter;
+    lru.insert(entry.lastUse, key);
+}
+
+
+void TaggedSlices::evict(const QString &keep) {
+    // the use order starts with the least recently used entry.
+    QMap<unsigned long long, QString>::iterator oldest = lru.begin();
+    while (usage > budget && oldest != lru.end()) {
+        if (oldest.value() == keep) {
+            ++oldest;
+            continue;
+        }
+        QHash<QString, Entry>::iterator it = cache.find(oldest.value());
+        usage -= it->slice->values.size() * sizeof(double);
+        cache.erase(it);
+        oldest = lru.erase(oldest);
+    }
+}
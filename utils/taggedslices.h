@@ -0,0 +1,146 @@
+#ifndef TAGGEDSLICES_H
+#define TAGGEDSLICES_H
+
+#include <QObject>
+#include <QMutex>
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <vector>
+#include <cmath>
+#include <nix.hpp>
+#include "loadscheduler.h"
+
+
+class TaggedSlices : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * @brief Slice: the data a position of a MultiTag tags in a reference, row major over extent.
+     */
+    struct Slice {
+        nix::NDSize offset;
+        nix::NDSize extent;
+        std::vector<double> values;
+    };
+    typedef QSharedPointer<const Slice> SlicePtr;
+
+    /**
+     * @brief Run: one read covering the slices that overlap or touch along the first dimension.
+     */
+    struct Run {
+        nix::NDSize offset;
+        nix::NDSize extent;
+        std::vector<int> slices;
+    };
+
+    /**
+     * @brief TaggedSlices: The tagged data of all positions of a MultiTag in one of its references.
+     * The hyperslabs of all positions are computed at once and merged into runs, so neighbouring trials are read together.
+     * fetch() reads the runs on parallel jobs of the shared LoadScheduler, one per worker.
+     * Slices are cached process wide per (file, tag, reference, index) with a budget
+     * (settings: LOADER_GROUP/LOADER_TAGGED_CACHE_SIZE in MB), stepping back to a position does not read it again.
+     */
+    explicit TaggedSlices(QObject *parent = 0);
+    ~TaggedSlices();
+
+    /**
+     * @brief setFile: sets the path of the currently opened nix file and drops the cached slices.
+     */
+    static void setFile(const std::string &path);
+
+    /**
+     * @brief setSource: cancels the running fetches and computes the hyperslabs of the tag's positions in the reference.
+     * Positions are scaled to the units of the dimensions where the units allow it.
+     * @param before, after: if not NaN, a position p tags [p - before, p + after] in the first dimension instead of its extent,
+     *          in the units of the tag like the positions,
+     *          and positions whose window does not lie completely inside the reference are not valid.
+     * @return false if the tag has no such reference or its positions do not match the reference's rank.
+     */
+    bool setSource(const nix::MultiTag &tag, size_t reference, double before = NAN, double after = NAN);
+
+    /**
+     * @brief unitScale: the factor from the tag's unit of dimension d to the unit of dimension d of the array,
+     * 1 if either has no unit or they do not scale.
+     */
+    static double unitScale(const nix::MultiTag &tag, const nix::DataArray &array, size_t d);
+
+    /**
+     * @brief unit: the unit positions along dimension d are given in, the tag's if it has one
+     * that scales to the dimension's, the dimension's otherwise.
+     */
+    static std::string unit(const nix::MultiTag &tag, const nix::DataArray &array, size_t d);
+
+    int count() const;
+    const nix::DataArray& array() const;
+
+    /**
+     * @brief valid: whether the position lies inside the reference, slices outside of it are never read.
+     */
+    bool valid(int index) const;
+    nix::NDSize offset(int index) const;
+    nix::NDSize extent(int index) const;
+
+    const std::vector<Run>& runs() const;
+    int runOf(int index) const;
+
+    /**
+     * @brief fetch: reads the runs holding the slices [first, last) that are not cached yet, emits sliceReady() for every
+     * slice read and finished() when all are done.
+     */
+    void fetch(int first, int last, LoadPriority priority = LoadPriority::Visible);
+    void cancel();
+
+    /**
+     * @brief slice: the cached slice, null if it is not loaded.
+     */
+    SlicePtr slice(int index) const;
+
+    /**
+     * @brief store: cuts the slice out of the values read for its run and caches it.
+     */
+    SlicePtr store(int index, const Run &run, const double *values);
+
+signals:
+    void sliceReady(int index);
+    void finished();
+
+private:
+    friend class TaggedSliceJob;
+
+    nix::DataArray reference;
+    QString keyPrefix;
+    std::vector<nix::NDSize> offsets;
+    std::vector<nix::NDSize> extents;
+    std::vector<char> inside;
+    std::vector<Run> runList;
+    std::vector<int> runIndex;
+    // the jobs of one fetch, their addresses are the owners on the scheduler so they run in parallel.
+    std::vector<char> lanes;
+    QAtomicInt pending;
+
+    struct Entry {
+        SlicePtr slice;
+        unsigned long long lastUse;
+    };
+
+    static QMutex mutex;
+    static std::string filePath;
+    static QHash<QString, Entry> cache;
+    // the keys of the cache by their last use, the least recently used first.
+    static QMap<unsigned long long, QString> lru;
+    static size_t usage;
+    static size_t budget;
+    static unsigned long long useCounter;
+
+    static void touch(const QString &key, Entry &entry);
+    static void evict(const QString &keep);
+    QString key(int index) const;
+    void laneDone();
+};
+
+#endif // TAGGEDSLICES_H
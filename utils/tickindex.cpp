@@ -0,0 +1,274 @@
+#include "tickindex.h"
+#include "h5lookup.h"
+#include "dataconvert.h"
+#include <algorithm>
+#include <limits>
+
+// tick sets up to this size are kept completely (32 MB).
+static const size_t TICK_INDEX_FULL = 1 << 22;
+// of larger sets every TICK_BLOCK-th tick is kept, the blocks in between are read when needed.
+static const size_t TICK_BLOCK = 4096;
+static const int TICK_BLOCK_CACHE = 64;
+// the ticks are read in parts of this size while the index is built.
+static const size_t TICK_READ_CHUNK = 1 << 20;
+
+QMutex TickIndex::mutex;
+std::string TickIndex::filePath;
+QHash<QString, TickIndexPtr> TickIndex::indices;
+
+
+TickIndex::TickIndex() {
+    dimIndex = 1;
+    alias = false;
+    count = 0;
+    stride = 0;
+}
+
+
+void TickIndex::setFile(const std::string &path) {
+    QMutexLocker locker(&mutex);
+    filePath = path;
+    indices.clear();
+}
+
+
+TickIndexPtr TickIndex::of(const nix::DataArray &array, size_t dimIndex) {
+    QString key = QString::fromStdString(array.id() + "/" + nix::util::numToStr(dimIndex));
+    {
+        QMutexLocker locker(&mutex);
+        if (indices.contains(key)) {
+            return indices.value(key);
+        }
+    }
+
+    TickIndexPtr index = build(array, dimIndex);
+
+    QMutexLocker locker(&mutex);
+    indices.insert(key, index);
+    return index;
+}
+
+
+TickIndexPtr TickIndex::build(const nix::DataArray &array, size_t dimIndex) {
+    TickIndexPtr index(new TickIndex());
+    index->array = array;
+    index->dimIndex = dimIndex;
+    {
+        QMutexLocker locker(&mutex);
+        index->path = filePath;
+    }
+
+    nix::RangeDimension rd = array.getDimension(dimIndex).asRangeDimension();
+    index->alias = rd.alias();
+
+    // the number of ticks without reading them: the data extent for an alias dimension, else the extent of the ticks dataset.
+    bool readable = false;
+    if (index->alias) {
+        index->count = array.dataExtent()[0];
+        readable = true;
+    } else if (!index->path.empty()) {
+        nixview::util::H5ErrorsOff quiet;
+        hid_t file = H5Fopen(index->path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+        if (file >= 0) {
+            hid_t group = nixview::util::open_array_group(file, array);
+            if (group >= 0) {
+                std::string name = "dimensions/" + nix::util::numToStr(dimIndex) + "/ticks";
+                hid_t dataset = H5Oexists_by_name(group, name.c_str(), H5P_DEFAULT) > 0 ?
+                            H5Dopen2(group, name.c_str(), H5P_DEFAULT) : -1;
+                if (dataset >= 0) {
+                    hid_t space = H5Dget_space(dataset);
+                    hssize_t points = H5Sget_simple_extent_npoints(space);
+                    if (points >= 0) {
+                        index->count = static_cast<size_t>(points);
+                        readable = true;
+                    }
+                    H5Sclose(space);
+                    H5Dclose(dataset);
+                }
+                H5Gclose(group);
+            }
+            H5Fclose(file);
+        }
+    }
+
+    if (!readable) {
+        // nix can only read all ticks at once, without block reads they are kept completely.
+        std::cerr << "TickIndex::build(): ticks of DataArray " << array.name() << " cannot be read in parts." << std::endl;
+        index->sparse = rd.ticks();
+        index->count = index->sparse.size();
+        return index;
+    }
+
+    index->stride = index->count > TICK_INDEX_FULL ? TICK_BLOCK : 0;
+    index->sparse.reserve(index->stride ? (index->count + TICK_BLOCK - 1) / TICK_BLOCK : index->count);
+
+    std::vector<double> chunk;
+    for (size_t offset = 0; offset < index->count; offset += TICK_READ_CHUNK) {
+        size_t n = std::min(TICK_READ_CHUNK, index->count - offset);
+        chunk.resize(n);
+        if (!index->read(offset, n, chunk.data())) {
+            std::cerr << "TickIndex::build(): reading the ticks of DataArray " << array.name() << " failed." << std::endl;
+            index->sparse = rd.ticks();
+            index->count = index->sparse.size();
+            index->stride = 0;
+            return index;
+        }
+        if (index->stride == 0) {
+            index->sparse.insert(index->sparse.end(), chunk.begin(), chunk.end());
+        } else {
+            // TICK_READ_CHUNK is a multiple of TICK_BLOCK, the blocks start at the beginning of each chunk.
+            for (size_t i = 0; i < n; i += TICK_BLOCK) {
+                index->sparse.push_back(chunk[i]);
+            }
+        }
+    }
+    return index;
+}
+
+
+bool TickIndex::read(size_t offset, size_t n, double *dst) const {
+    if (alias) {
+        nix::NDSize start(1), extent(1);
+        start[0] = offset;
+        extent[0] = n;
+        std::vector<char> scratch;
+        nixview::util::read_as_double(array, dst, extent, start, scratch);
+        return true;
+    }
+
+    nixview::util::H5ErrorsOff quiet;
+    bool success = false;
+    hid_t file = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file < 0) {
+        return false;
+    }
+    hid_t group = nixview::util::open_array_group(file, array);
+    if (group >= 0) {
+        std::string name = "dimensions/" + nix::util::numToStr(dimIndex) + "/ticks";
+        hid_t dataset = H5Dopen2(group, name.c_str(), H5P_DEFAULT);
+        if (dataset >= 0) {
+            hsize_t start = offset;
+            hsize_t extent = n;
+            hid_t space = H5Dget_space(dataset);
+            hid_t memspace = H5Screate_simple(1, &extent, nullptr);
+            H5Sselect_hyperslab(space, H5S_SELECT_SET, &start, nullptr, &extent, nullptr);
+            success = H5Dread(dataset, H5T_NATIVE_DOUBLE, memspace, space, H5P_DEFAULT, dst) >= 0;
+            H5Sclose(memspace);
+            H5Sclose(space);
+            H5Dclose(dataset);
+        }
+        H5Gclose(group);
+    }
+    H5Fclose(file);
+    return success;
+}
+
+
+TickIndex::BlockPtr TickIndex::block(size_t number) const {
+    QMutexLocker locker(&blockMutex);
+    if (blocks.contains(number)) {
+        blockUse.removeOne(number);
+        blockUse.append(number);
+        return blocks.value(number);
+    }
+
+    size_t offset = number * stride;
+    QSharedPointer<std::vector<double>> ticks(new std::vector<double>(std::min(stride, count - offset)));
+    if (!read(offset, ticks->size(), ticks->data())) {
+        std::cerr << "TickIndex::block(): reading ticks " << offset << " to " << offset + ticks->size()
+                  << " of DataArray " << array.name() << " failed." << std::endl;
+        return BlockPtr();
+    }
+    blocks.insert(number, ticks);
+    blockUse.append(number);
+    if (blockUse.size() > TICK_BLOCK_CACHE) {
+        blocks.remove(blockUse.takeFirst());
+    }
+    return ticks;
+}
+
+
+size_t TickIndex::size() const {
+    return count;
+}
+
+
+double TickIndex::first() const {
+    return count > 0 ? sparse.front() : 0;
+}
+
+
+double TickIndex::last() const {
+    return count > 0 ? tick(count - 1) : 0;
+}
+
+
+double TickIndex::tick(size_t index) const {
+    if (stride == 0) {
+        return sparse[index];
+    }
+    if (index % stride == 0) {
+        return sparse[index / stride];
+    }
+    BlockPtr ticks = block(index / stride);
+    return ticks ? (*ticks)[index % stride] : std::numeric_limits<double>::quiet_NaN();
+}
+
+
+size_t TickIndex::bound(double value, bool upper) const {
+    std::vector<double>::const_iterator it = upper ? std::upper_bound(sparse.begin(), sparse.end(), value) :
+                                                     std::lower_bound(sparse.begin(), sparse.end(), value);
+    size_t position = it - sparse.begin();
+    if (stride == 0) {
+        return position;
+    }
+    if (position == 0) {
+        return 0;
+    }
+    // the bound lies in the block before the first kept tick that satisfies it.
+    size_t number = position - 1;
+    BlockPtr ticks = block(number);
+    if (!ticks) {
+        // without the block the first kept tick that satisfies the bound is the closest known one.
+        return std::min(position * stride, count);
+    }
+    std::vector<double>::const_iterator inBlock = upper ? std::upper_bound(ticks->begin(), ticks->end(), value) :
+                                                          std::lower_bound(ticks->begin(), ticks->end(), value);
+    return number * stride + (inBlock - ticks->begin());
+}
+
+
+size_t TickIndex::lowerBound(double value) const {
+    return bound(value, false);
+}
+
+
+size_t TickIndex::upperBound(double value) const {
+    return bound(value, true);
+}
+
+
+void TickIndex::ticks(size_t offset, size_t n, double *dst) const {
+    if (stride == 0) {
+        std::copy(sparse.begin() + offset, sparse.begin() + offset + n, dst);
+        return;
+    }
+    if (n > stride) {
+        // a long range is read at once instead of block by block.
+        if (read(offset, n, dst)) {
+            return;
+        }
+    }
+    for (size_t i = 0; i < n; ) {
+        size_t number = (offset + i) / stride;
+        size_t from = (offset + i) % stride;
+        BlockPtr ticks = block(number);
+        size_t m = std::min(std::min(stride, count - number * stride) - from, n - i);
+        if (ticks) {
+            std::copy(ticks->begin() + from, ticks->begin() + from + m, dst + i);
+        } else {
+            std::fill(dst + i, dst + i + m, std::numeric_limits<double>::quiet_NaN());
+        }
+        i += m;
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef TICKINDEX_H
+#define TICKINDEX_H
+
+#include <QMutex>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QSharedPointer>
+#include <vector>
+#include <nix.hpp>
+
+class TickIndex;
+typedef QSharedPointer<TickIndex> TickIndexPtr;
+
+
+/**
+ * @brief TickIndex: The ticks of a RangeDimension in memory, so mapping a range to indices is a binary search
+ * instead of reading the whole ticks dataset like nix::RangeDimension::ticks(), axis() and operator[] do.
+ * Tick sets up to TICK_INDEX_FULL ticks are kept completely. Of larger sets only every TICK_BLOCK-th tick is kept,
+ * the blocks between them are read on demand as HDF5 hyperslabs and the last used ones are cached.
+ * Indices are built once per (DataArray id, dimension) and shared until the next setFile().
+ */
+class TickIndex
+{
+public:
+    /**
+     * @brief setFile: sets the path of the currently opened nix file and drops the built indices.
+     */
+    static void setFile(const std::string &path);
+
+    /**
+     * @brief of: the index of a RangeDimension of the array, built on first use.
+     * @param dimIndex: the index of the dimension (starting with 1).
+     */
+    static TickIndexPtr of(const nix::DataArray &array, size_t dimIndex);
+
+    size_t size() const;
+    double first() const;
+    double last() const;
+    /**
+     * @brief tick: the tick at index, NaN if its block cannot be read.
+     */
+    double tick(size_t index) const;
+
+    /**
+     * @brief lowerBound: index of the first tick >= value, size() if there is none.
+     */
+    size_t lowerBound(double value) const;
+
+    /**
+     * @brief upperBound: index of the first tick > value, size() if there is none.
+     */
+    size_t upperBound(double value) const;
+
+    /**
+     * @brief ticks: copies count ticks beginning at offset to dst, NaN for ticks that cannot be read.
+     */
+    void ticks(size_t offset, size_t count, double *dst) const;
+
+private:
+    TickIndex();
+
+    nix::DataArray array;
+    size_t dimIndex;
+    bool alias;
+    std::string path;
+    size_t count;
+    // 0 if all ticks are kept in sparse.
+    size_t stride;
+    std::vector<double> sparse;
+
+    // the ticks of one block, shared with the callers so a cache hit copies nothing.
+    typedef QSharedPointer<const std::vector<double>> BlockPtr;
+
+    mutable QMutex blockMutex;
+    mutable QHash<size_t, BlockPtr> blocks;
+    mutable QList<size_t> blockUse;
+
+    static QMutex mutex;
+    static std::string filePath;
+    static QHash<QString, TickIndexPtr> indices;
+
+    static TickIndexPtr build(const nix::DataArray &array, size_t dimIndex);
+    bool read(size_t offset, size_t count, double *dst) const;
+
+    /**
+     * @brief block: the ticks [number * stride, (number + 1) * stride), read on first use.
+     * @return null if they cannot be read.
+     */
+    BlockPtr block(size_t number) const;
+
+    /**
+     * @brief bound: lowerBound() if upper is false, upperBound() otherwise.
+     */
+    size_t bound(double value, bool upper) const;
+};
+
+#endif // TICKINDEX_H
@@ -0,0 +1,92 @@
+#include "valuestats.h"
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NIXVIEW_SSE2
+#endif
+
+
+ValueStats::ValueStats() :
+    min(std::numeric_limits<double>::infinity()), max(-std::numeric_limits<double>::infinity()),
+    sum(0), count(0), nanCount(0) {
+}
+
+
+void ValueStats::merge(const ValueStats &other) {
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    sum += other.sum;
+    count += other.count;
+    nanCount += other.nanCount;
+}
+
+
+bool ValueStats::hasValues() const {
+    return count > nanCount;
+}
+
+
+double ValueStats::mean() const {
+    return hasValues() ? sum / (count - nanCount) : std::numeric_limits<double>::quiet_NaN();
+}
+
+
+namespace nixview {
+namespace util {
+
+ValueStats value_stats(const double *values, size_t count) {
+    ValueStats stats;
+    stats.count = count;
+    size_t i = 0;
+
+#ifdef NIXVIEW_SSE2
+    if (count >= 4) {
+        // two independent accumulators per quantity. minpd/maxpd return their second operand if one is NaN,
+        // so NaNs never replace the running extremes, the ordered mask keeps them out of the sum.
+        __m128d min0 = _mm_set1_pd(stats.min), min1 = min0;
+        __m128d max0 = _mm_set1_pd(stats.max), max1 = max0;
+        __m128d sum0 = _mm_setzero_pd(), sum1 = sum0;
+        size_t nans = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128d a = _mm_loadu_pd(values + i);
+            __m128d b = _mm_loadu_pd(values + i + 2);
+            min0 = _mm_min_pd(a, min0);
+            min1 = _mm_min_pd(b, min1);
+            max0 = _mm_max_pd(a, max0);
+            max1 = _mm_max_pd(b, max1);
+            __m128d orderedA = _mm_cmpord_pd(a, a);
+            __m128d orderedB = _mm_cmpord_pd(b, b);
+            sum0 = _mm_add_pd(sum0, _mm_and_pd(a, orderedA));
+            sum1 = _mm_add_pd(sum1, _mm_and_pd(b, orderedB));
+            int mask = (~_mm_movemask_pd(orderedA) & 3) | ((~_mm_movemask_pd(orderedB) & 3) << 2);
+            nans += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_min_pd(min0, min1));
+        stats.min = std::min(lanes[0], lanes[1]);
+        _mm_storeu_pd(lanes, _mm_max_pd(max0, max1));
+        stats.max = std::max(lanes[0], lanes[1]);
+        _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+        stats.sum = lanes[0] + lanes[1];
+        stats.nanCount = nans;
+    }
+#endif
+
+    for (; i < count; ++i) {
+        double value = values[i];
+        if (std::isnan(value)) {
+            stats.nanCount++;
+            continue;
+        }
+        stats.min = std::min(stats.min, value);
+        stats.max = std::max(stats.max, value);
+        stats.sum += value;
+    }
+    return stats;
+}
+
+} //namespace util
+} //namespace nixview
@@ -0,0 +1,53 @@
+#ifndef VALUESTATS_H
+#define VALUESTATS_H
+
+#include <QVector>
+#include <QMetaType>
+#include <cstddef>
+
+
+/**
+ * @brief ValueStats: Summary of a block of values. NaNs are counted but excluded from min, max and sum.
+ * The loader computes it for every chunk it delivers, receivers merge the summaries instead of scanning the data again.
+ * Without any value that is not NaN, min is +inf and max is -inf.
+ */
+struct ValueStats
+{
+    ValueStats();
+
+    double min;
+    double max;
+    double sum;
+    size_t count;
+    size_t nanCount;
+
+    void merge(const ValueStats &other);
+
+    /**
+     * @brief hasValues: whether at least one of the values is not NaN.
+     */
+    bool hasValues() const;
+
+    /**
+     * @brief mean: the mean of the values that are not NaN, NaN if there are none.
+     */
+    double mean() const;
+};
+
+// the summaries of one delivered chunk, one per channel of the LoadBuffer.
+typedef QVector<ValueStats> ChunkStats;
+Q_DECLARE_METATYPE(ChunkStats)
+
+
+namespace nixview {
+namespace util {
+
+/**
+ * @brief value_stats: computes min, max, sum and the number of NaNs in a single pass, with an SSE2 kernel where available.
+ */
+ValueStats value_stats(const double *values, size_t count);
+
+} //namespace util
+} //namespace nixview
+
+#endif // VALUESTATS_H
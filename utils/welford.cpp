@@ -0,0 +1,114 @@
+#include "welford.h"
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NIXVIEW_SSE2
+#endif
+
+
+WelfordAccumulator::WelfordAccumulator() : added(0) {
+}
+
+
+void WelfordAccumulator::resize(size_t length) {
+    counts.assign(length, 0);
+    means.assign(length, 0);
+    m2s.assign(length, 0);
+    added = 0;
+}
+
+
+void WelfordAccumulator::clear() {
+    std::fill(counts.begin(), counts.end(), 0);
+    std::fill(means.begin(), means.end(), 0);
+    std::fill(m2s.begin(), m2s.end(), 0);
+    added = 0;
+}
+
+
+size_t WelfordAccumulator::length() const {
+    return counts.size();
+}
+
+
+size_t WelfordAccumulator::windows() const {
+    return added;
+}
+
+
+void WelfordAccumulator::add(const double *window, size_t count) {
+    count = std::min(count, counts.size());
+    double *n = counts.data();
+    double *mean = means.data();
+    double *m2 = m2s.data();
+    size_t i = 0;
+
+#ifdef NIXVIEW_SSE2
+    // the ordered mask zeroes the updates of NaNs: their delta is NaN, and a NaN masked by zero bits is 0.0.
+    const __m128d one = _mm_set1_pd(1.0);
+    for (; i + 2 <= count; i += 2) {
+        __m128d x = _mm_loadu_pd(window + i);
+        __m128d valid = _mm_cmpord_pd(x, x);
+        __m128d n1 = _mm_add_pd(_mm_loadu_pd(n + i), _mm_and_pd(valid, one));
+        __m128d m = _mm_loadu_pd(mean + i);
+        __m128d delta = _mm_sub_pd(x, m);
+        __m128d m1 = _mm_add_pd(m, _mm_and_pd(valid, _mm_div_pd(delta, n1)));
+        __m128d update = _mm_and_pd(valid, _mm_mul_pd(delta, _mm_sub_pd(x, m1)));
+        _mm_storeu_pd(n + i, n1);
+        _mm_storeu_pd(mean + i, m1);
+        _mm_storeu_pd(m2 + i, _mm_add_pd(_mm_loadu_pd(m2 + i), update));
+    }
+#endif
+
+    for (; i < count; ++i) {
+        double x = window[i];
+        if (std::isnan(x)) {
+            continue;
+        }
+        n[i] += 1;
+        double delta = x - mean[i];
+        mean[i] += delta / n[i];
+        m2[i] += delta * (x - mean[i]);
+    }
+    added++;
+}
+
+
+void WelfordAccumulator::merge(const WelfordAccumulator &other) {
+    if (other.counts.size() > counts.size()) {
+        counts.resize(other.counts.size(), 0);
+        means.resize(other.counts.size(), 0);
+        m2s.resize(other.counts.size(), 0);
+    }
+    for (size_t i = 0; i < other.counts.size(); ++i) {
+        double nb = other.counts[i];
+        if (nb == 0) {
+            continue;
+        }
+        double na = counts[i];
+        double n = na + nb;
+        double delta = other.means[i] - means[i];
+        means[i] += delta * nb / n;
+        m2s[i] += other.m2s[i] + delta * delta * na * nb / n;
+        counts[i] = n;
+    }
+    added += other.added;
+}
+
+
+double WelfordAccumulator::count(size_t i) const {
+    return counts[i];
+}
+
+
+double WelfordAccumulator::mean(size_t i) const {
+    return counts[i] > 0 ? means[i] : std::numeric_limits<double>::quiet_NaN();
+}
+
+
+double WelfordAccumulator::sd(size_t i) const {
+    return counts[i] > 1 ? std::sqrt(m2s[i] / (counts[i] - 1)) : std::numeric_limits<double>::quiet_NaN();
+}
@@ -0,0 +1,54 @@
+#ifndef WELFORD_H
+#define WELFORD_H
+
+#include <vector>
+#include <cstddef>
+
+
+/**
+ * @brief WelfordAccumulator: Mean and variance at every position of a window, over windows added one after another
+ * (Welford's algorithm), so the windows are streamed and never kept. Every position counts its own values:
+ * NaNs and positions beyond the end of a shorter window are left out.
+ * Accumulators of parallel workers are combined with merge() (Chan et al.).
+ */
+class WelfordAccumulator
+{
+public:
+    WelfordAccumulator();
+
+    /**
+     * @brief resize: clears the accumulator and sets the number of positions of a window.
+     */
+    void resize(size_t length);
+    void clear();
+
+    size_t length() const;
+
+    /**
+     * @brief add: adds a window of count values, count <= length(). Uses an SSE2 kernel where available.
+     */
+    void add(const double *window, size_t count);
+
+    void merge(const WelfordAccumulator &other);
+
+    /**
+     * @brief windows: the number of windows added or merged.
+     */
+    size_t windows() const;
+
+    double count(size_t i) const;
+    double mean(size_t i) const;
+
+    /**
+     * @brief sd: the sample standard deviation at position i, NaN with less than two values.
+     */
+    double sd(size_t i) const;
+
+private:
+    size_t added;
+    std::vector<double> counts;
+    std::vector<double> means;
+    std::vector<double> m2s;
+};
+
+#endif // WELFORD_H
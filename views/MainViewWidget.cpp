@@ -3,6 +3,11 @@
 #include "ui_MainViewWidget.h"
 #include "common/Common.hpp"
 #include "model/nixtreemodel.h"
+#include "utils/blockcache.h"
+#include "utils/lodcache.h"
+#include "utils/storagelayout.h"
+#include "utils/taggedslices.h"
+#include "utils/tickindex.h"
 
 NixTreeModel *MainViewWidget::CURRENT_MODEL = nullptr;
 
@@ -57,6 +62,11 @@ bool MainViewWidget::set_nix_file(const std::string &nix_file_path) {
 
     try {
         nix_file = nix::File::open(nix_file_path, nix::FileMode::ReadOnly);
+        BlockCache::setFile(nix_file_path);
+        LodCache::setFile(nix_file_path);
+        StorageLayout::setFile(nix_file_path);
+        TickIndex::setFile(nix_file_path);
+        TaggedSlices::setFile(nix_file_path);
         nix_model->set_entity(nix_file);
         tv->getTreeView()->setModel(nix_proxy_model);
         tv->getTreeView()->setSortingEnabled(true);
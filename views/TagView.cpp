@@ -5,11 +5,22 @@
 #include "plotter/plotter.h"
 #include "plotter/lineplotter.h"
 #include "plotter/plotwidget.h"
+#include "plotter/colormap.hpp"
+#include "plotter/perieventplotter.h"
+#include "plotter/replotscheduler.h"
+#include "utils/tickindex.h"
+
+// the positions before and after the selected one that are read with it, so stepping through them does not wait.
+static const int POSITION_PREFETCH = 32;
+// at most this many lines of a slice with more than one dimension are drawn.
+static const int SLICE_MAX_LINES = 16;
 
 TagView::TagView(QWidget *parent) :
     QScrollArea(parent),
-    ui(new Ui::TagView) {
+    ui(new Ui::TagView), position(0), periEvent(nullptr) {
     ui->setupUi(this);
+    connect(&slices, SIGNAL(sliceReady(int)), this, SLOT(slice_loaded(int)));
+    show_positions(false);
 }
 
 TagView::~TagView() {
@@ -23,6 +34,7 @@ void TagView::setEntity(QVariant var) {
     }
     ui->tagLabel->setText(QString::fromStdString(tag.name() + " - " + tag.type()));
     ui->tagLabel->setToolTip(tag.description().c_str());
+    show_positions(var.canConvert<nix::MultiTag>());
     fill_references();
     fill_features();
 }
@@ -30,6 +42,8 @@ void TagView::setEntity(QVariant var) {
 
 void TagView::clear() {
     ui->tagLabel->setText("");
+    slices.cancel();
+    show_positions(false);
     clear_references();
     clear_features();
 }
@@ -87,6 +101,18 @@ void TagView::fill_features() {
 
 
 void TagView::reference_selected(int i) {
+    QVariant entity = this->tag.getEntity();
+    if (i >= 0 && entity.canConvert<nix::MultiTag>()) {
+        if (slices.setSource(entity.value<nix::MultiTag>(), i)) {
+            ui->positionSpin->blockSignals(true);
+            ui->positionSpin->setRange(0, std::max(0, slices.count() - 1));
+            ui->positionSpin->blockSignals(false);
+            position_selected(ui->positionSpin->value());
+        }
+        if (ui->averageButton->isChecked()) {
+            average_toggled(true);
+        }
+    }
     if (reference_map.size() == 0) {
         QWidget *w = ui->referenceStack->widget(0);
         ui->referenceStack->removeWidget(w);
@@ -136,6 +162,102 @@ void TagView::feature_selected(int i) {
 }
 
 
+void TagView::show_positions(bool show) {
+    ui->positionLabel->setVisible(show);
+    ui->positionSpin->setVisible(show);
+    ui->slicePlot->setVisible(show);
+    ui->averageButton->setVisible(show);
+    if (!show) {
+        ui->averageButton->setChecked(false);
+    }
+}
+
+
+void TagView::average_toggled(bool on) {
+    QVariant entity = this->tag.getEntity();
+    int reference = ui->referencesCombo->currentIndex();
+    if (!on || reference < 0 || !entity.canConvert<nix::MultiTag>()) {
+        if (periEvent) {
+            periEvent->cancel();
+            periEvent->hide();
+        }
+        return;
+    }
+    if (!periEvent) {
+        periEvent = new PeriEventPlotter();
+        ui->referencePlotWidget->layout()->addWidget(periEvent);
+    }
+    periEvent->show();
+    periEvent->setSource(entity.value<nix::MultiTag>(), reference);
+}
+
+
+void TagView::position_selected(int i) {
+    position = i;
+    // the cached ones are skipped, the others are read in runs on parallel workers.
+    slices.fetch(i - POSITION_PREFETCH, i + POSITION_PREFETCH + 1);
+    draw_slice();
+}
+
+
+void TagView::slice_loaded(int index) {
+    if (index == position) {
+        draw_slice();
+    }
+}
+
+
+void TagView::draw_slice() {
+    QCustomPlot *plot = ui->slicePlot;
+    plot->clearGraphs();
+    TaggedSlices::SlicePtr slice = slices.slice(position);
+    if (slice.isNull() || slice->values.empty()) {
+        ReplotScheduler::instance().request(plot);
+        return;
+    }
+
+    // the first dimension is the x-axis, every index of the others a line.
+    const nix::DataArray &array = slices.array();
+    int length = static_cast<int>(slice->extent[0]);
+    size_t begin = slice->offset[0];
+    QVector<double> keys(length);
+    nix::Dimension dim = array.getDimension(1);
+    if (dim.dimensionType() == nix::DimensionType::Sample) {
+        nix::SampledDimension sd = dim.asSampledDimension();
+        double offset = sd.offset() ? *sd.offset() : 0;
+        for (int j = 0; j < length; j++) {
+            keys[j] = offset + (begin + j) * sd.samplingInterval();
+        }
+    } else if (dim.dimensionType() == nix::DimensionType::Range) {
+        TickIndex::of(array, 1)->ticks(begin, length, keys.data());
+    } else {
+        for (int j = 0; j < length; j++) {
+            keys[j] = begin + j;
+        }
+    }
+
+    ColorMap cmap;
+    size_t lines = slice->values.size() / length;
+    QVector<double> values(length);
+    for (size_t l = 0; l < std::min(lines, static_cast<size_t>(SLICE_MAX_LINES)); l++) {
+        for (int j = 0; j < length; j++) {
+            values[j] = slice->values[j * lines + l];
+        }
+        QCPGraph *graph = plot->addGraph();
+        graph->setPen(QPen(cmap.next()));
+        graph->setData(keys, values, true);
+    }
+
+    QString ylabel;
+    QVector<QString> labels;
+    Plotter::data_array_ax_labels(array, ylabel, labels);
+    plot->yAxis->setLabel(ylabel);
+    plot->xAxis->setLabel(labels.isEmpty() ? QString() : labels[0]);
+    plot->rescaleAxes();
+    ReplotScheduler::instance().request(plot);
+}
+
+
 void TagView::show_tag_info() {
     QMessageBox msgBox;
     msgBox.setWindowFlags(Qt::FramelessWindowHint);
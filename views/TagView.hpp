@@ -9,12 +9,14 @@
 #include "model/NixModelItem.hpp"
 #include "utils/entitydescriptor.h"
 #include "utils/tagcontainer.h"
+#include "utils/taggedslices.h"
 
 namespace Ui {
 class TagView;
 }
 
 class PlotWidget;
+class PeriEventPlotter;
 
 class TagView : public QScrollArea
 {
@@ -31,11 +33,24 @@ public slots:
     void reference_selected(int i);
     void feature_selected(int i);
     void show_tag_info();
+    void position_selected(int i);
+    void average_toggled(bool on);
+
+private slots:
+    void slice_loaded(int index);
 
 private:
     Ui::TagView *ui;
     QMap<int, int> feature_map, reference_map;
     TagContainer tag;
+    // the data tagged by the positions of a MultiTag in the selected reference.
+    TaggedSlices slices;
+    int position;
+    // the event-triggered average of the selected reference, only created when it is first shown.
+    PeriEventPlotter *periEvent;
+
+    void show_positions(bool show);
+    void draw_slice();
 
     void fill_references();
     void fill_features();